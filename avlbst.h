@@ -6,6 +6,11 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <stdexcept>
+#include <typeinfo>
+#include <vector>
+#include <thread>
+#include <system_error>
 #include "bst.h"
 
 struct KeyError { };
@@ -21,22 +26,36 @@ class AVLNode : public Node<Key, Value>
 public:
     // Constructor/destructor.
     AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(Key&& key, Value&& value, AVLNode<Key, Value>* parent);
+    ~AVLNode();
 
-    // Getter/setter for the node's height.
+    // Getter/setter for the node's balance.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
+    // Getter/setter for the cached height of the subtree rooted at this node
+    // (a leaf has height 1). Kept up to date by AVLTree so height queries are O(1).
+    int8_t getHeight () const;
+    void setHeight (int8_t height);
+
+    // Getter/setter for the number of nodes in the subtree rooted at this node
+    // (a leaf has size 1). Kept up to date by AVLTree for order statistics.
+    std::size_t getSize () const;
+    void setSize (std::size_t size);
+
     // Getters for parent, left, and right. These need to be redefined since they
-    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
-    // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    // return pointers to AVLNodes - not plain Nodes. They hide (rather than
+    // override) the Node getters, so code holding an AVLNode* binds to them
+    // statically. See the Node class in bst.h for more information.
+    AVLNode<Key, Value>* getParent() const;
+    AVLNode<Key, Value>* getLeft() const;
+    AVLNode<Key, Value>* getRight() const;
 
 protected:
     int8_t balance_;    // effectively a signed char
+    int8_t height_;     // an AVL tree of height 127 would need more than 2^87 nodes
+    std::size_t size_;
 };
 
 /*
@@ -50,7 +69,17 @@ protected:
 */
 template<class Key, class Value>
 AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+    Node<Key, Value>(key, value, parent), balance_(0), height_(1), size_(1)
+{
+
+}
+
+/**
+* An explicit constructor that moves the key and value into the node
+*/
+template<class Key, class Value>
+AVLNode<Key, Value>::AVLNode(Key&& key, Value&& value, AVLNode<Key, Value> *parent) :
+    Node<Key, Value>(std::move(key), std::move(value), parent), balance_(0), height_(1), size_(1)
 {
 
 }
@@ -92,8 +121,44 @@ void AVLNode<Key, Value>::updateBalance(int8_t diff)
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
-* that our node is a AVLNode.
+* A getter for the cached subtree height of a AVLNode.
+*/
+template<class Key, class Value>
+int8_t AVLNode<Key, Value>::getHeight() const
+{
+    return height_;
+}
+
+/**
+* A setter for the cached subtree height of a AVLNode.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setHeight(int8_t height)
+{
+    height_ = height;
+}
+
+/**
+* A getter for the cached subtree size of a AVLNode.
+*/
+template<class Key, class Value>
+std::size_t AVLNode<Key, Value>::getSize() const
+{
+    return size_;
+}
+
+/**
+* A setter for the cached subtree size of a AVLNode.
+*/
+template<class Key, class Value>
+void AVLNode<Key, Value>::setSize(std::size_t size)
+{
+    size_ = size;
+}
+
+/**
+* A redefined getter for the parent since a static_cast is necessary to make sure
+* that our node is a AVLNode. The cast is free: AVLNode has Node as its only base.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
@@ -102,7 +167,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Redefined for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
@@ -111,7 +176,7 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
 }
 
 /**
-* Overridden for the same reasons as above.
+* Redefined for the same reasons as above.
 */
 template<class Key, class Value>
 AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
@@ -126,15 +191,62 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
   -----------------------------------------------
 */
 
+/**
+* Passed to the AVLTree constructor to make the new tree share its node pool
+* with an existing tree. See AVLTree(share_pool_t, AVLTree&).
+*/
+struct share_pool_t { };
+const share_pool_t share_pool = share_pool_t();
 
-template <class Key, class Value>
-class AVLTree : public BinarySearchTree<Key, Value>
+template <class Key, class Value, class Compare = std::less<Key> >
+class AVLTree : public BinarySearchTree<Key, Value, Compare>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    AVLTree();
+    explicit AVLTree(const Compare& comp);
+    AVLTree(share_pool_t, AVLTree<Key, Value, Compare>& sibling);
+    template<typename InputIt>
+    AVLTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
+    virtual ~AVLTree();
     virtual void remove(const Key& key);  // TODO
+
+    // Order statistics, all O(log n)
+    typename BinarySearchTree<Key, Value, Compare>::iterator select(std::size_t k) const;
+    std::size_t rank(const Key& key) const;
+    std::size_t count_range(const Key& lo, const Key& hi) const;
+
+    // Cutting and concatenating trees by relinking nodes, in O(log n) when
+    // the trees share a pool (see split())
+    void split(const Key& key, AVLTree<Key, Value, Compare>& right);
+    void join(AVLTree<Key, Value, Compare>& right);
+    void join(const Key& key, const Value& value, AVLTree<Key, Value, Compare>& right);
+
+    // Set algebra built on split and join, run over up to threads threads
+    // (0 for one per core)
+    void union_with(AVLTree<Key, Value, Compare>& other, unsigned threads = 0);
+    void intersect_with(const AVLTree<Key, Value, Compare>& other, unsigned threads = 0);
+    void difference_with(const AVLTree<Key, Value, Compare>& other, unsigned threads = 0);
 protected:
+    // A detached subtree built by the set operations, with its first and last
+    // nodes so that linkNeighbours() can be called where pieces meet
+    struct Piece
+    {
+        AVLNode<Key, Value>* root;
+        Node<Key, Value>* first;
+        Node<Key, Value>* last;
+    };
+    // Subproblems smaller than this are not worth handing to another thread
+    enum { PARALLEL_GRAIN = 1 << 14 };
+
     virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* createNode(Key&& key, Value&& value, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual void afterInsert(Node<Key, Value>* node);
+    virtual void initBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    // Called by split() and join() for two nodes that have become neighbours
+    // in key order; either is NULL at an end of the tree
+    virtual void linkNeighbours(Node<Key, Value>* before, Node<Key, Value>* after);
 
     // Add helper functions here
 
@@ -142,12 +254,1021 @@ protected:
     void removeFix(AVLNode<Key, Value>* current, int diff); 
     void rotateRight(AVLNode<Key, Value>* node); 
     void rotateLeft(AVLNode<Key, Value>* node); 
-    int height(AVLNode<Key, Value>* node); 
+    int height(AVLNode<Key, Value>* node) const; 
+    void updateHeight(AVLNode<Key, Value>* node); 
+    static std::size_t subtreeSize(AVLNode<Key, Value>* node); 
+    void updateSize(AVLNode<Key, Value>* node); 
     AVLNode<Key, Value>* predecessor(AVLNode<Key, Value>* current); 
+    void refresh(AVLNode<Key, Value>* node); 
+    AVLNode<Key, Value>* rebalanceAt(AVLNode<Key, Value>* node); 
+    AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, AVLNode<Key, Value>* middle, AVLNode<Key, Value>* right); 
+    AVLNode<Key, Value>* joinNodes(AVLNode<Key, Value>* left, AVLNode<Key, Value>* right); 
+    AVLNode<Key, Value>* detachMax(AVLNode<Key, Value>* node, AVLNode<Key, Value>*& max); 
+    void splitNodes(AVLNode<Key, Value>* node, const Key& key, AVLNode<Key, Value>*& less, AVLNode<Key, Value>*& notLess); 
+    void adoptRoot(AVLNode<Key, Value>* root); 
+    static void collectNodes(AVLNode<Key, Value>* node, std::vector<AVLNode<Key, Value>*>& nodes); 
+    AVLNode<Key, Value>* moveNodes(AVLNode<Key, Value>* subtree, AVLTree<Key, Value, Compare>& target); 
+    bool swapsPools(AVLNode<Key, Value>* mine, AVLNode<Key, Value>* theirs, const AVLTree<Key, Value, Compare>& other) const; 
+    void gatherNodes(AVLNode<Key, Value>*& mine, AVLNode<Key, Value>*& theirs, AVLTree<Key, Value, Compare>& other); 
+    void checkCompatible(const AVLTree<Key, Value, Compare>& other) const; 
+    void splitAround(AVLNode<Key, Value>* node, const Key& key, AVLNode<Key, Value>*& less, AVLNode<Key, Value>*& match, AVLNode<Key, Value>*& greater); 
+    Piece makePiece(AVLNode<Key, Value>* root); 
+    Piece joinPieces(const Piece& left, AVLNode<Key, Value>* middle, const Piece& right); 
+    Piece joinPieces(const Piece& left, const Piece& right); 
+    Piece unionNodes(AVLNode<Key, Value>* mine, AVLNode<Key, Value>* theirs, unsigned threads, std::vector<AVLNode<Key, Value>*>& dropped); 
+    Piece filterNodes(AVLNode<Key, Value>* mine, const Node<Key, Value>* theirs, bool keepShared, unsigned threads, std::vector<AVLNode<Key, Value>*>& dropped); 
+    void filterWith(const AVLTree<Key, Value, Compare>& other, bool keepShared, unsigned threads); 
+    void finishSetOperation(const Piece& result, std::vector<AVLNode<Key, Value>*>& dropped); 
+    template<typename LeftTask, typename RightTask>
+    static void forkJoin(bool parallel, LeftTask left, RightTask right); 
+    static unsigned threadBudget(unsigned threads); 
 };
 
-template<class Key, class Value>
-AVLNode<Key, Value>* AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* current){
+/**
+* Default constructor for an empty AVLTree.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::AVLTree() : BinarySearchTree<Key, Value, Compare>()
+{
+
+}
+
+/**
+* Constructor for an empty AVLTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::AVLTree(const Compare& comp) : BinarySearchTree<Key, Value, Compare>(comp)
+{
+
+}
+
+/**
+* Constructor for an empty AVLTree, ordered like sibling, that allocates its
+* nodes from the same pool as sibling. split(), join() and union_with()
+* between trees that share a pool move nodes in O(log n) (O(m log(n/m + 1))
+* for union_with()); between other trees they also move the items of the
+* smaller side into the other pool. Sharing lasts until both trees are
+* destroyed. While it does, clear() has to visit every node instead of
+* dropping the pool's slabs, and neither tree may be modified while another
+* thread uses the other.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::AVLTree(share_pool_t, AVLTree<Key, Value, Compare>& sibling) :
+    BinarySearchTree<Key, Value, Compare>(sibling.comp_)
+{
+    this->pool_.share(sibling.pool_);
+}
+
+/**
+* Constructs a balanced AVLTree from the key/value pairs in [first, last) in
+* linear time. The work is done here rather than by the BinarySearchTree
+* constructor so that AVLNodes are created. See BinarySearchTree::assign().
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+AVLTree<Key, Value, Compare>::AVLTree(InputIt first, InputIt last, bool sorted, const Compare& comp) : BinarySearchTree<Key, Value, Compare>(comp)
+{
+    this->assign(first, last, sorted);
+}
+
+/**
+* Clears the tree here rather than in ~BinarySearchTree so that the nodes are
+* destroyed through AVLTree::destroyNode.
+*/
+template<class Key, class Value, class Compare>
+AVLTree<Key, Value, Compare>::~AVLTree()
+{
+    this->clear();
+}
+
+/**
+* Allocates an AVLNode from the tree's pool.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return this->pool_.template create<AVLNode<Key, Value> >(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Allocates an AVLNode from the tree's pool, moving the key and value into it.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* AVLTree<Key, Value, Compare>::createNode(Key&& key, Value&& value, Node<Key, Value>* parent)
+{
+    return this->pool_.template create<AVLNode<Key, Value> >(std::move(key), std::move(value), static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Destroys an AVLNode and returns its memory to the pool.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    this->pool_.destroy(static_cast<AVLNode<Key, Value>*>(node));
+}
+
+/**
+* Sets the balance and height of a node made by a bulk load from the heights
+* of its two subtrees.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::initBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+    AVLNode<Key, Value>* avlNode = static_cast<AVLNode<Key, Value>*>(node);
+    avlNode->setBalance((int8_t)(rightHeight - leftHeight));
+    avlNode->setHeight((int8_t)(1 + std::max(leftHeight, rightHeight)));
+    updateSize(avlNode);
+}
+
+/**
+* Returns an iterator to the item with the k-th smallest key (counting from
+* 0), or end() if the tree has k items or fewer. Each step down skips the
+* whole left subtree by its size.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+AVLTree<Key, Value, Compare>::select(std::size_t k) const
+{
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (current != nullptr) {
+        std::size_t leftSize = subtreeSize(current->getLeft());
+        if (k == leftSize) {
+            break;
+        }
+        if (k < leftSize) {
+            current = current->getLeft();
+        }
+        else {
+            //skip the left subtree and this node
+            k -= leftSize + 1;
+            current = current->getRight();
+        }
+    }
+    return this->makeIterator(current);
+}
+
+/**
+* Returns the number of keys in the tree that are less than key, which is the
+* position key has (or would have) in sorted order. key need not be present.
+*/
+template<class Key, class Value, class Compare>
+std::size_t AVLTree<Key, Value, Compare>::rank(const Key& key) const
+{
+    std::size_t less = 0;
+    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
+    while (current != nullptr) {
+        if (this->comp_(current->getKey(), key)) {
+            //this node and its whole left subtree come before key
+            less += subtreeSize(current->getLeft()) + 1;
+            current = current->getRight();
+        }
+        else {
+            current = current->getLeft();
+        }
+    }
+    return less;
+}
+
+/**
+* Returns the number of keys k with lo <= k < hi.
+*/
+template<class Key, class Value, class Compare>
+std::size_t AVLTree<Key, Value, Compare>::count_range(const Key& lo, const Key& hi) const
+{
+    if (!this->comp_(lo, hi)) {
+        return 0;
+    }
+    return rank(hi) - rank(lo);
+}
+
+/**
+* Moves every item with a key not less than key into right, replacing what
+* right held, and keeps the rest. Both trees end up balanced. The tree is cut
+* along the search path for key and the pieces on each side are joined back
+* up with rotations, reusing the same nodes, in O(log n). A right that starts
+* out empty, and shares no pool yet, is made to share this tree's pool (see
+* AVLTree(share_pool_t, AVLTree&)) so that no item is copied. Otherwise, if
+* right does not share this tree's pool, the items of the smaller side are
+* then copied into new nodes so that each tree keeps its own pool, which adds
+* O(min(k, n - k)) for k items copied; if a copy throws, both trees are left
+* as they were, except that right has been cleared. Iterators into either
+* tree are invalidated.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::split(const Key& key, AVLTree<Key, Value, Compare>& right)
+{
+    checkCompatible(right);
+    bool fresh = right.root_ == nullptr && !right.pool_.shared();
+    right.clear();
+    if (this->root_ == nullptr || this->comp_(this->rightmost_->getKey(), key)) {
+        return;
+    }
+    if (fresh) {
+        right.pool_.share(this->pool_);
+    }
+
+    //the two nodes on either side of the cut
+    Node<Key, Value>* after = this->lowerBoundNode(key);
+    Node<Key, Value>* before = this->prevNode(after);
+
+    AVLNode<Key, Value>* root = static_cast<AVLNode<Key, Value>*>(this->root_);
+    //rotations update root_ when they move it, so keep it out of the way
+    this->root_ = nullptr;
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* notLess = nullptr;
+    splitNodes(root, key, less, notLess);
+    linkNeighbours(before, nullptr);
+    linkNeighbours(nullptr, after);
+    if (!this->pool_.sharesWith(right.pool_)) {
+        bool swapped = false;
+        try {
+            if (swapsPools(less, notLess, right)) {
+                //right takes over the pool and the smaller side moves out
+                this->pool_.swap(right.pool_);
+                swapped = true;
+                less = right.moveNodes(less, *this);
+            }
+            else {
+                notLess = moveNodes(notLess, right);
+            }
+        }
+        catch (...) {
+            //nothing has moved, so put the two halves back together
+            if (swapped) {
+                this->pool_.swap(right.pool_);
+            }
+            adoptRoot(joinNodes(less, notLess));
+            linkNeighbours(before, after);
+            throw;
+        }
+    }
+    adoptRoot(less);
+    right.adoptRoot(notLess);
+}
+
+/**
+* Moves every item of right, whose keys must all be greater than the keys
+* in this tree, onto the end of this tree, leaving right empty. Takes
+* O(log n) if the two trees share a pool, plus copying the items of the
+* smaller tree into new nodes if they do not (see split()). Throws
+* std::invalid_argument if the keys overlap; if a copy throws, both trees
+* are left as they were.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::join(AVLTree<Key, Value, Compare>& right)
+{
+    checkCompatible(right);
+    if (right.root_ == nullptr) {
+        return;
+    }
+    if (this->root_ != nullptr && !this->comp_(this->rightmost_->getKey(), right.leftmost_->getKey())) {
+        throw std::invalid_argument("Keys to join are out of order");
+    }
+
+    AVLNode<Key, Value>* left = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* moved = static_cast<AVLNode<Key, Value>*>(right.root_);
+    this->root_ = nullptr;
+    right.adoptRoot(nullptr);
+    try {
+        gatherNodes(left, moved, right);
+    }
+    catch (...) {
+        adoptRoot(left);
+        right.adoptRoot(moved);
+        throw;
+    }
+    Piece leftPiece = makePiece(left);
+    Piece rightPiece = makePiece(moved);
+    adoptRoot(joinNodes(left, moved));
+    linkNeighbours(leftPiece.last, rightPiece.first);
+}
+
+/**
+* Like join(right), with a new item for key in between: key must be greater
+* than every key in this tree and less than every key in right.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::join(const Key& key, const Value& value, AVLTree<Key, Value, Compare>& right)
+{
+    checkCompatible(right);
+    if ((this->root_ != nullptr && !this->comp_(this->rightmost_->getKey(), key)) ||
+        (right.root_ != nullptr && !this->comp_(key, right.leftmost_->getKey()))) {
+        throw std::invalid_argument("Keys to join are out of order");
+    }
+
+    AVLNode<Key, Value>* left = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* moved = static_cast<AVLNode<Key, Value>*>(right.root_);
+    //the new node is made first, while a failure still leaves nothing to
+    //undo, in the pool this tree will end up with
+    AVLTree<Key, Value, Compare>& home = swapsPools(left, moved, right) ? right : *this;
+    AVLNode<Key, Value>* middle = static_cast<AVLNode<Key, Value>*>(home.createNode(key, value, nullptr));
+    this->root_ = nullptr;
+    right.adoptRoot(nullptr);
+    try {
+        gatherNodes(left, moved, right);
+    }
+    catch (...) {
+        home.destroyNode(middle);
+        adoptRoot(left);
+        right.adoptRoot(moved);
+        throw;
+    }
+    Piece leftPiece = makePiece(left);
+    Piece rightPiece = makePiece(moved);
+    adoptRoot(joinNodes(left, middle, moved));
+    linkNeighbours(leftPiece.last, middle);
+    linkNeighbours(middle, rightPiece.first);
+}
+
+/**
+* Nodes are only linked into the tree, so there is nothing to do here.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::linkNeighbours(Node<Key, Value>* before, Node<Key, Value>* after)
+{
+
+}
+
+/**
+* Throws std::invalid_argument unless other is a different tree of the same
+* kind, whose nodes can be moved into this one.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::checkCompatible(const AVLTree<Key, Value, Compare>& other) const
+{
+    if (&other == this || typeid(other) != typeid(*this)) {
+        throw std::invalid_argument("Trees to split or join must be distinct and of the same type");
+    }
+}
+
+/**
+* Makes root, a detached subtree, the whole tree, and recomputes the size and
+* the cached ends from it.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::adoptRoot(AVLNode<Key, Value>* root)
+{
+    this->root_ = root;
+    this->size_ = subtreeSize(root);
+    this->leftmost_ = root;
+    this->rightmost_ = root;
+    if (root == nullptr) {
+        return;
+    }
+    while (this->leftmost_->getLeft() != nullptr) {
+        this->leftmost_ = this->leftmost_->getLeft();
+    }
+    while (this->rightmost_->getRight() != nullptr) {
+        this->rightmost_ = this->rightmost_->getRight();
+    }
+}
+
+/**
+* Appends the nodes of the subtree rooted at node to nodes in key order.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::collectNodes(AVLNode<Key, Value>* node, std::vector<AVLNode<Key, Value>*>& nodes)
+{
+    if (node == nullptr) {
+        return;
+    }
+    collectNodes(node->getLeft(), nodes);
+    nodes.push_back(node);
+    collectNodes(node->getRight(), nodes);
+}
+
+/**
+* Copies the items of subtree, a detached subtree of this tree's nodes, into
+* new nodes from target's pool and returns them as a balanced subtree, in
+* O(k) for k items. The old nodes are destroyed only once every new node
+* has been made, so if a copy throws, subtree is left as it was. The first
+* and last new nodes are not linked to any neighbours.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::moveNodes(AVLNode<Key, Value>* subtree, AVLTree<Key, Value, Compare>& target)
+{
+    std::vector<AVLNode<Key, Value>*> nodes;
+    collectNodes(subtree, nodes);
+    std::vector<std::pair<Key, Value> > items;
+    items.reserve(nodes.size());
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        items.push_back(std::pair<Key, Value>(nodes[i]->getKey(), nodes[i]->getValue()));
+    }
+    typename std::vector<std::pair<Key, Value> >::iterator it = items.begin();
+    int height = 0;
+    AVLNode<Key, Value>* built = static_cast<AVLNode<Key, Value>*>(target.buildSubtree(it, items.size(), nullptr, height));
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        destroyNode(nodes[i]);
+    }
+    return built;
+}
+
+/**
+* Returns true if mine, nodes of this tree, is the smaller side to copy
+* when gathering it with theirs, nodes of other, into one pool, and the
+* pools can be swapped first so that this tree takes over other's.
+*/
+template<class Key, class Value, class Compare>
+bool AVLTree<Key, Value, Compare>::swapsPools(AVLNode<Key, Value>* mine, AVLNode<Key, Value>* theirs, const AVLTree<Key, Value, Compare>& other) const
+{
+    return !this->pool_.sharesWith(other.pool_) && subtreeSize(mine) < subtreeSize(theirs) &&
+        !this->pool_.shared() && !other.pool_.shared();
+}
+
+/**
+* Makes mine, a detached subtree of this tree, and theirs, a detached
+* subtree holding all of other's nodes, both live in this tree's pool so
+* they can be joined. Nothing moves if the trees share a pool. Otherwise
+* the items of the smaller side are copied into new nodes; when that is
+* mine, the pools are swapped first so that this tree takes over theirs.
+* other's pool is left empty and gives its slabs back. If a copy throws,
+* mine, theirs and the pools are left as they were.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::gatherNodes(AVLNode<Key, Value>*& mine, AVLNode<Key, Value>*& theirs, AVLTree<Key, Value, Compare>& other)
+{
+    if (this->pool_.sharesWith(other.pool_)) {
+        return;
+    }
+    if (swapsPools(mine, theirs, other)) {
+        this->pool_.swap(other.pool_);
+        try {
+            mine = other.moveNodes(mine, *this);
+        }
+        catch (...) {
+            this->pool_.swap(other.pool_);
+            throw;
+        }
+    }
+    else {
+        theirs = other.moveNodes(theirs, *this);
+    }
+    other.pool_.release();
+}
+
+/**
+* Recomputes the height, size and balance of node from its children.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::refresh(AVLNode<Key, Value>* node)
+{
+    updateHeight(node);
+    updateSize(node);
+    node->setBalance((int8_t)(height(node->getRight()) - height(node->getLeft())));
+}
+
+/**
+* Refreshes node and, if its subtrees now differ in height by two, rotates
+* it back into balance. Returns the node that has taken node's place.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::rebalanceAt(AVLNode<Key, Value>* node)
+{
+    refresh(node);
+    if (node->getBalance() > 1) {
+        AVLNode<Key, Value>* child = node->getRight();
+        if (child->getBalance() < 0) {
+            AVLNode<Key, Value>* grandchild = child->getLeft();
+            rotateRight(child);
+            refresh(child);
+            refresh(grandchild);
+        }
+        rotateLeft(node);
+        refresh(node);
+        node = node->getParent();
+        refresh(node);
+    }
+    else if (node->getBalance() < -1) {
+        AVLNode<Key, Value>* child = node->getLeft();
+        if (child->getBalance() > 0) {
+            AVLNode<Key, Value>* grandchild = child->getRight();
+            rotateLeft(child);
+            refresh(child);
+            refresh(grandchild);
+        }
+        rotateRight(node);
+        refresh(node);
+        node = node->getParent();
+        refresh(node);
+    }
+    return node;
+}
+
+/**
+* Joins two detached subtrees, with every key in left less than middle's
+* and every key in right greater, into one balanced subtree and returns its
+* root. The shorter subtree and middle are hung off the spine of the taller
+* one at the first node no more than one level taller, then the spine is
+* rebalanced on the way back up. That costs O(1 + the difference in height).
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::joinNodes(AVLNode<Key, Value>* left, AVLNode<Key, Value>* middle, AVLNode<Key, Value>* right)
+{
+    int leftHeight = height(left);
+    int rightHeight = height(right);
+    AVLNode<Key, Value>* parent = nullptr;
+    if (leftHeight > rightHeight + 1) {
+        //walk down the right spine of left
+        parent = left;
+        while (height(parent->getRight()) > rightHeight + 1) {
+            parent = parent->getRight();
+        }
+        left = parent->getRight();
+    }
+    else if (rightHeight > leftHeight + 1) {
+        //walk down the left spine of right
+        parent = right;
+        while (height(parent->getLeft()) > leftHeight + 1) {
+            parent = parent->getLeft();
+        }
+        right = parent->getLeft();
+    }
+
+    middle->setLeft(left);
+    middle->setRight(right);
+    if (left != nullptr) {
+        left->setParent(middle);
+    }
+    if (right != nullptr) {
+        right->setParent(middle);
+    }
+    middle->setParent(parent);
+    refresh(middle);
+    if (parent == nullptr) {
+        return middle;
+    }
+    if (leftHeight > rightHeight) {
+        parent->setRight(middle);
+    }
+    else {
+        parent->setLeft(middle);
+    }
+
+    AVLNode<Key, Value>* top = middle;
+    for (AVLNode<Key, Value>* node = parent; node != nullptr; node = top->getParent()) {
+        top = rebalanceAt(node);
+    }
+    return top;
+}
+
+/**
+* Joins two detached subtrees, with every key in left less than every key in
+* right, by taking the largest node out of left to go between them.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::joinNodes(AVLNode<Key, Value>* left, AVLNode<Key, Value>* right)
+{
+    if (left == nullptr) {
+        return right;
+    }
+    if (right == nullptr) {
+        return left;
+    }
+    AVLNode<Key, Value>* max = nullptr;
+    left = detachMax(left, max);
+    return joinNodes(left, max, right);
+}
+
+/**
+* Takes the node with the largest key out of the detached subtree rooted at
+* node, setting max to it, and returns the root of what is left. Each level
+* on the way back up is rejoined to the remainder below it; the joins cost
+* O(log n) together because the heights they bridge add up to the height.
+*/
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::detachMax(AVLNode<Key, Value>* node, AVLNode<Key, Value>*& max)
+{
+    AVLNode<Key, Value>* left = node->getLeft();
+    AVLNode<Key, Value>* right = node->getRight();
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    if (left != nullptr) {
+        left->setParent(nullptr);
+    }
+    if (right == nullptr) {
+        max = node;
+        return left;
+    }
+    right->setParent(nullptr);
+    return joinNodes(left, node, detachMax(right, max));
+}
+
+/**
+* Splits the detached subtree rooted at node into the nodes with keys less
+* than key (less) and the rest (notLess), both balanced. Each node on the
+* search path is joined to the side it belongs on together with its
+* subtree on that side, in O(log n) overall as for detachMax().
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::splitNodes(AVLNode<Key, Value>* node, const Key& key, AVLNode<Key, Value>*& less, AVLNode<Key, Value>*& notLess)
+{
+    if (node == nullptr) {
+        less = nullptr;
+        notLess = nullptr;
+        return;
+    }
+    AVLNode<Key, Value>* left = node->getLeft();
+    AVLNode<Key, Value>* right = node->getRight();
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    if (left != nullptr) {
+        left->setParent(nullptr);
+    }
+    if (right != nullptr) {
+        right->setParent(nullptr);
+    }
+    if (this->comp_(node->getKey(), key)) {
+        AVLNode<Key, Value>* rest = nullptr;
+        splitNodes(right, key, rest, notLess);
+        less = joinNodes(left, node, rest);
+    }
+    else {
+        AVLNode<Key, Value>* rest = nullptr;
+        splitNodes(left, key, less, rest);
+        notLess = joinNodes(rest, node, right);
+    }
+}
+
+/**
+* Merges other into this tree, leaving other empty. Where both trees have a
+* key, the item from other replaces this tree's, as if every item of other
+* had been inserted. Nodes are moved rather than copied: this tree is split
+* around each key of other and the pieces are joined back up, which takes
+* O(m log(n/m + 1)) work for trees of m <= n items instead of O(m log n).
+* The two halves under each key are merged by different threads while there
+* are threads left and enough items to be worth it. If the trees do not
+* share a pool, the items of the smaller tree are first copied into new
+* nodes in the other's pool, in O(min(n, m)). If the comparator throws, the
+* exception is passed on once every thread has finished, and both trees are
+* left empty. Iterators into either tree are invalidated.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::union_with(AVLTree<Key, Value, Compare>& other, unsigned threads)
+{
+    if (&other == this) {
+        return;
+    }
+    checkCompatible(other);
+    if (other.root_ == nullptr) {
+        return;
+    }
+
+    AVLNode<Key, Value>* mine = static_cast<AVLNode<Key, Value>*>(this->root_);
+    AVLNode<Key, Value>* theirs = static_cast<AVLNode<Key, Value>*>(other.root_);
+    this->root_ = nullptr;
+    other.adoptRoot(nullptr);
+    try {
+        gatherNodes(mine, theirs, other);
+    }
+    catch (...) {
+        adoptRoot(mine);
+        other.adoptRoot(theirs);
+        throw;
+    }
+    std::vector<AVLNode<Key, Value>*> dropped;
+    Piece result;
+    try {
+        result = unionNodes(mine, theirs, threadBudget(threads), dropped);
+    }
+    catch (...) {
+        //the pieces cannot be put back, so the items stay in the pool until it goes
+        adoptRoot(nullptr);
+        throw;
+    }
+    finishSetOperation(result, dropped);
+}
+
+/**
+* Removes every item whose key is not also in other, which is left as it
+* is. Takes the same work as union_with() and is parallel in the same way;
+* if the comparator throws, this tree is left empty.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::intersect_with(const AVLTree<Key, Value, Compare>& other, unsigned threads)
+{
+    if (&other != this) {
+        filterWith(other, true, threads);
+    }
+}
+
+/**
+* Removes every item whose key is also in other, which is left as it is.
+* Takes the same work as union_with() and is parallel in the same way; if
+* the comparator throws, this tree is left empty.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::difference_with(const AVLTree<Key, Value, Compare>& other, unsigned threads)
+{
+    if (&other == this) {
+        this->clear();
+        return;
+    }
+    filterWith(other, false, threads);
+}
+
+/**
+* Keeps the items whose keys are in other if keepShared is set, and the
+* items whose keys are not otherwise. Only this tree is restructured, so
+* the threads can all read other at once.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::filterWith(const AVLTree<Key, Value, Compare>& other, bool keepShared, unsigned threads)
+{
+    if (this->root_ == nullptr) {
+        return;
+    }
+    AVLNode<Key, Value>* mine = static_cast<AVLNode<Key, Value>*>(this->root_);
+    this->root_ = nullptr;
+    std::vector<AVLNode<Key, Value>*> dropped;
+    Piece result;
+    try {
+        result = filterNodes(mine, other.root_, keepShared, threadBudget(threads), dropped);
+    }
+    catch (...) {
+        adoptRoot(nullptr);
+        throw;
+    }
+    finishSetOperation(result, dropped);
+}
+
+/**
+* Makes result the whole tree and frees the nodes the operation dropped.
+* That is left until the threads are done, as the pool is not thread-safe.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::finishSetOperation(const Piece& result, std::vector<AVLNode<Key, Value>*>& dropped)
+{
+    adoptRoot(result.root);
+    linkNeighbours(nullptr, result.first);
+    linkNeighbours(result.last, nullptr);
+    for (std::size_t i = 0; i < dropped.size(); ++i) {
+        destroyNode(dropped[i]);
+    }
+}
+
+/**
+* Returns how many threads to use when asked for threads, where 0 means one
+* per core.
+*/
+template<class Key, class Value, class Compare>
+unsigned AVLTree<Key, Value, Compare>::threadBudget(unsigned threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return threads == 0 ? 1 : threads;
+}
+
+/**
+* Runs left and right, on a new thread for left if parallel is set. If no
+* thread can be started they just run one after the other. The worker is
+* always joined before this returns; an exception thrown by either task is
+* passed on then, right's if both throw.
+*/
+template<class Key, class Value, class Compare>
+template<typename LeftTask, typename RightTask>
+void AVLTree<Key, Value, Compare>::forkJoin(bool parallel, LeftTask left, RightTask right)
+{
+    if (parallel) {
+        std::exception_ptr leftError;
+        std::thread worker;
+        try {
+            worker = std::thread([&]() {
+                try {
+                    left();
+                }
+                catch (...) {
+                    leftError = std::current_exception();
+                }
+            });
+        }
+        catch (const std::system_error&) {
+            parallel = false;
+        }
+        if (parallel) {
+            try {
+                right();
+            }
+            catch (...) {
+                worker.join();
+                throw;
+            }
+            worker.join();
+            if (leftError) {
+                std::rethrow_exception(leftError);
+            }
+            return;
+        }
+    }
+    left();
+    right();
+}
+
+/**
+* Merges the detached subtrees mine and theirs. mine is split around the
+* key at the root of theirs, each half is merged with the subtree of theirs
+* on the same side, and the results are joined with theirs' root between
+* them. A node of mine with the same key is added to dropped.
+*/
+template<class Key, class Value, class Compare>
+typename AVLTree<Key, Value, Compare>::Piece
+AVLTree<Key, Value, Compare>::unionNodes(AVLNode<Key, Value>* mine, AVLNode<Key, Value>* theirs, unsigned threads, std::vector<AVLNode<Key, Value>*>& dropped)
+{
+    if (theirs == nullptr) {
+        return makePiece(mine);
+    }
+    if (mine == nullptr) {
+        return makePiece(theirs);
+    }
+    bool parallel = threads > 1 && subtreeSize(mine) + subtreeSize(theirs) >= PARALLEL_GRAIN;
+
+    AVLNode<Key, Value>* theirsLeft = theirs->getLeft();
+    AVLNode<Key, Value>* theirsRight = theirs->getRight();
+    if (theirsLeft != nullptr) {
+        theirsLeft->setParent(nullptr);
+    }
+    if (theirsRight != nullptr) {
+        theirsRight->setParent(nullptr);
+    }
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* match = nullptr;
+    AVLNode<Key, Value>* greater = nullptr;
+    splitAround(mine, theirs->getKey(), less, match, greater);
+    if (match != nullptr) {
+        dropped.push_back(match);
+    }
+
+    Piece left, right;
+    std::vector<AVLNode<Key, Value>*> leftDropped;
+    std::vector<AVLNode<Key, Value>*>& leftOut = parallel ? leftDropped : dropped;
+    unsigned leftThreads = parallel ? threads / 2 : 1;
+    unsigned rightThreads = parallel ? threads - leftThreads : 1;
+    forkJoin(parallel,
+        [&]() { left = unionNodes(less, theirsLeft, leftThreads, leftOut); },
+        [&]() { right = unionNodes(greater, theirsRight, rightThreads, dropped); });
+    dropped.insert(dropped.end(), leftDropped.begin(), leftDropped.end());
+    return joinPieces(left, theirs, right);
+}
+
+/**
+* Filters the detached subtree mine against the subtree of another tree
+* rooted at theirs, keeping the nodes whose keys are in theirs if keepShared
+* is set and the others if not. mine is split around the key at the root of
+* theirs and each half is filtered against the subtree of theirs on the
+* same side. Removed nodes are added to dropped.
+*/
+template<class Key, class Value, class Compare>
+typename AVLTree<Key, Value, Compare>::Piece
+AVLTree<Key, Value, Compare>::filterNodes(AVLNode<Key, Value>* mine, const Node<Key, Value>* theirs, bool keepShared, unsigned threads, std::vector<AVLNode<Key, Value>*>& dropped)
+{
+    if (mine == nullptr) {
+        return makePiece(nullptr);
+    }
+    if (theirs == nullptr) {
+        if (!keepShared) {
+            return makePiece(mine);
+        }
+        //nothing left to match, so drop the whole subtree
+        std::vector<AVLNode<Key, Value>*> pending(1, mine);
+        while (!pending.empty()) {
+            AVLNode<Key, Value>* node = pending.back();
+            pending.pop_back();
+            if (node->getLeft() != nullptr) {
+                pending.push_back(node->getLeft());
+            }
+            if (node->getRight() != nullptr) {
+                pending.push_back(node->getRight());
+            }
+            dropped.push_back(node);
+        }
+        return makePiece(nullptr);
+    }
+    bool parallel = threads > 1 && subtreeSize(mine) >= PARALLEL_GRAIN;
+
+    AVLNode<Key, Value>* less = nullptr;
+    AVLNode<Key, Value>* match = nullptr;
+    AVLNode<Key, Value>* greater = nullptr;
+    splitAround(mine, theirs->getKey(), less, match, greater);
+
+    Piece left, right;
+    std::vector<AVLNode<Key, Value>*> leftDropped;
+    std::vector<AVLNode<Key, Value>*>& leftOut = parallel ? leftDropped : dropped;
+    unsigned leftThreads = parallel ? threads / 2 : 1;
+    unsigned rightThreads = parallel ? threads - leftThreads : 1;
+    forkJoin(parallel,
+        [&]() { left = filterNodes(less, theirs->getLeft(), keepShared, leftThreads, leftOut); },
+        [&]() { right = filterNodes(greater, theirs->getRight(), keepShared, rightThreads, dropped); });
+    dropped.insert(dropped.end(), leftDropped.begin(), leftDropped.end());
+    if (match != nullptr && keepShared) {
+        return joinPieces(left, match, right);
+    }
+    if (match != nullptr) {
+        dropped.push_back(match);
+    }
+    return joinPieces(left, right);
+}
+
+/**
+* Like splitNodes(), but a node whose key is equal to key is taken out
+* as match instead of going into greater.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::splitAround(AVLNode<Key, Value>* node, const Key& key, AVLNode<Key, Value>*& less, AVLNode<Key, Value>*& match, AVLNode<Key, Value>*& greater)
+{
+    if (node == nullptr) {
+        less = nullptr;
+        match = nullptr;
+        greater = nullptr;
+        return;
+    }
+    AVLNode<Key, Value>* left = node->getLeft();
+    AVLNode<Key, Value>* right = node->getRight();
+    node->setLeft(nullptr);
+    node->setRight(nullptr);
+    if (left != nullptr) {
+        left->setParent(nullptr);
+    }
+    if (right != nullptr) {
+        right->setParent(nullptr);
+    }
+    int order = this->compareKeys(key, node->getKey());
+    if (order == 0) {
+        node->setParent(nullptr);
+        refresh(node);
+        less = left;
+        match = node;
+        greater = right;
+    }
+    else if (order > 0) {
+        AVLNode<Key, Value>* rest = nullptr;
+        splitAround(right, key, rest, match, greater);
+        less = joinNodes(left, node, rest);
+    }
+    else {
+        AVLNode<Key, Value>* rest = nullptr;
+        splitAround(left, key, less, match, rest);
+        greater = joinNodes(rest, node, right);
+    }
+}
+
+/**
+* Wraps the detached subtree rooted at root, finding its first and last
+* nodes.
+*/
+template<class Key, class Value, class Compare>
+typename AVLTree<Key, Value, Compare>::Piece AVLTree<Key, Value, Compare>::makePiece(AVLNode<Key, Value>* root)
+{
+    Piece piece = { root, root, root };
+    if (root == nullptr) {
+        return piece;
+    }
+    root->setParent(nullptr);
+    while (piece.first->getLeft() != nullptr) {
+        piece.first = piece.first->getLeft();
+    }
+    while (piece.last->getRight() != nullptr) {
+        piece.last = piece.last->getRight();
+    }
+    return piece;
+}
+
+/**
+* joinNodes() for pieces, linking middle to the nodes on either side.
+*/
+template<class Key, class Value, class Compare>
+typename AVLTree<Key, Value, Compare>::Piece
+AVLTree<Key, Value, Compare>::joinPieces(const Piece& left, AVLNode<Key, Value>* middle, const Piece& right)
+{
+    linkNeighbours(left.last, middle);
+    linkNeighbours(middle, right.first);
+    Piece piece = { joinNodes(left.root, middle, right.root),
+        left.root != nullptr ? left.first : middle,
+        right.root != nullptr ? right.last : middle };
+    return piece;
+}
+
+/**
+* joinNodes() for pieces, linking the last node of left to the first of
+* right.
+*/
+template<class Key, class Value, class Compare>
+typename AVLTree<Key, Value, Compare>::Piece
+AVLTree<Key, Value, Compare>::joinPieces(const Piece& left, const Piece& right)
+{
+    if (left.root == nullptr) {
+        return right;
+    }
+    if (right.root == nullptr) {
+        return left;
+    }
+    linkNeighbours(left.last, right.first);
+    Piece piece = { joinNodes(left.root, right.root), left.first, right.last };
+    return piece;
+}
+
+template<class Key, class Value, class Compare>
+AVLNode<Key, Value>* AVLTree<Key, Value, Compare>::predecessor(AVLNode<Key, Value>* current){
     
     AVLNode<Key, Value>* pred; 
     if (current->getLeft() != nullptr) {
@@ -169,8 +1290,8 @@ AVLNode<Key, Value>* AVLTree<Key, Value>::predecessor(AVLNode<Key, Value>* curre
     return nullptr; 
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* current) {
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Value>* current) {
     //Pseudocode:
         //if curr node is null or parent node is null  
             //return
@@ -223,8 +1344,9 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
             if (grandparent->getBalance() == 0) {
                 return; 
             }
-            //balance off by -1
+            //balance off by -1, so the grandparent grew taller
             if (grandparent->getBalance() == -1) {
+                updateHeight(grandparent); 
                 insertFix(grandparent, parent);
                 return; 
             }
@@ -265,8 +1387,9 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
             if (grandparent->getBalance() == 0) {
                 return; 
             }
-            //balalnce off by 1
+            //balalnce off by 1, so the grandparent grew taller
             if (grandparent->getBalance() == 1) {
+                updateHeight(grandparent); 
                 insertFix(grandparent, parent); 
                 return; 
             }
@@ -302,8 +1425,8 @@ void AVLTree<Key, Value>::insertFix(AVLNode<Key, Value>* parent, AVLNode<Key, Va
         }
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* current, int diff){
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::removeFix(AVLNode<Key, Value>* current, int diff){
         //p = parent of n
         //n = current node
         //c = taller child of n
@@ -336,6 +1459,9 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* current, int diff){
         if (current == nullptr) {
             return; 
         }
+        //one of current's subtrees just got shorter, so refresh its cached height
+        //(rotations below recompute the heights of the nodes they move)
+        updateHeight(current); 
         AVLNode<Key, Value>* parent = current->getParent(); 
         char ndiff = 0; 
         //if p is not NULL let ndiff = +1 if n is a left child and -1 otherwise.
@@ -355,13 +1481,8 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* current, int diff){
             //Case 1: b(n) + diff == -2
             if (current->getBalance() + diff == -2) {
                 //Case 1a: b(c) == 1, zig-zig case
-                AVLNode<Key, Value>* child; 
-                if (height(current->getLeft()) > height(current->getRight())) {
-                    child = current->getLeft();
-                }
-                else {
-                    child = current->getRight(); 
-                }
+                //the right side got shorter, so the left child is the taller one
+                AVLNode<Key, Value>* child = current->getLeft(); 
 
                 if (child->getBalance() == -1) {
                     rotateRight(current);
@@ -411,14 +1532,9 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* current, int diff){
         else if (diff == 1) {
             //Case 1: b(n) + diff == 2
             if (current->getBalance() + diff == 2) {
-                //let child = the taller of the children
-                AVLNode<Key, Value>* child; 
-                if (height(current->getLeft()) > height(current->getRight())) {
-                    child = current->getLeft(); 
-                }
-                else {
-                    child = current->getRight(); 
-                }
+                //let child = the taller of the children, which is the right one
+                //since the left side got shorter
+                AVLNode<Key, Value>* child = current->getRight(); 
                 //Case 1a: b(c) == -1, zig-zig case
                 if (child->getBalance() == 1) {
                     rotateLeft(current); 
@@ -467,19 +1583,56 @@ void AVLTree<Key, Value>::removeFix(AVLNode<Key, Value>* current, int diff){
         }
 }
 
-template<class Key, class Value>
-int AVLTree<Key, Value>::height(AVLNode<Key, Value>* node) {
+/**
+* Returns the height of the subtree rooted at node (0 for an empty subtree)
+* from the height cached in the node.
+*/
+template<class Key, class Value, class Compare>
+int AVLTree<Key, Value, Compare>::height(AVLNode<Key, Value>* node) const {
     if (node == nullptr) {
         return 0; 
     }
+    return node->getHeight(); 
+}
+
+/**
+* Recomputes the cached height of node from the cached heights of its children.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::updateHeight(AVLNode<Key, Value>* node) {
+    if (node == nullptr) {
+        return; 
+    }
     int leftHeight = height(node->getLeft());
     int rightHeight = height(node->getRight());
         
-    return 1 + std::max(leftHeight, rightHeight);
+    node->setHeight((int8_t)(1 + std::max(leftHeight, rightHeight)));
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node){
+/**
+* Returns the number of nodes in the subtree rooted at node (0 for NULL).
+*/
+template<class Key, class Value, class Compare>
+std::size_t AVLTree<Key, Value, Compare>::subtreeSize(AVLNode<Key, Value>* node) {
+    if (node == nullptr) {
+        return 0; 
+    }
+    return node->getSize(); 
+}
+
+/**
+* Recomputes the cached subtree size of node from the sizes of its children.
+*/
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::updateSize(AVLNode<Key, Value>* node) {
+    if (node == nullptr) {
+        return; 
+    }
+    node->setSize(1 + subtreeSize(node->getLeft()) + subtreeSize(node->getRight()));
+}
+
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::rotateRight(AVLNode<Key, Value>* node){
     //6 pointer changes to implement rotations:
         // 1. parent's child
         // 2. current's parent
@@ -558,10 +1711,16 @@ void AVLTree<Key, Value>::rotateRight(AVLNode<Key, Value>* node){
     if (child != nullptr) {
         child->setRight(node); 
     }
+
+    //node is now below child, so fix node's height and size first
+    updateHeight(node); 
+    updateHeight(child); 
+    updateSize(node); 
+    updateSize(child); 
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) {
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::rotateLeft(AVLNode<Key, Value>* node) {
     //6 pointer changes to implement rotations:
         //1. parent's child
         //2. current's parent
@@ -632,137 +1791,61 @@ void AVLTree<Key, Value>::rotateLeft(AVLNode<Key, Value>* node) {
         child->setLeft(node);
     }
 
-    
+    //node is now below child, so fix node's height and size first
+    updateHeight(node); 
+    updateHeight(child); 
+    updateSize(node); 
+    updateSize(child); 
 }
 
 /*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
+ * Rebalances after BinarySearchTree has linked a new leaf into the tree.
+ * All of the insert, emplace and try_emplace variants end up here, so the
+ * search for the insertion point (and overwriting an existing key) is shared
+ * with the plain BST.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
 {
-    // TODO
-    //Pseduocode:
-        //Use internal find to get node_to_insert... do you need to do this?
-        //If node_to_insert is equal to null pointer ...do you need to do this?
-            //return ...do you need to do this?
-        //empty tree case
-            //insert into the tree, steps:
-                //dynamically create new node
-                //setbalance equal to 0
-                //make root pointer equal to new node
-                //set child pointers of node possilby to node?
-                    //check node class and see what variables are associated, specifically which one i need to set
-        //get current node by getting the root
-        //while current node is not null
-            //if node_to_insert key > current key, insert right 
-                //if current->getRight() is null, insert node_to_insert as current keys right child
-                    //dynamically create new ndoe 
-                    //setbalance of new node to 0
-                    //update current's right child to new node (the dynamically created one)
-                    //update the balance
-                    //save the parent's current balance to a variable 
-                    //if balance is -1
-                        //set current node balance to 0
-                        //return becuase balanced
-                    //if balance is 0
-                        //set current node balance to 1 (because right child )
-                        //call insertFix(new node, current node)
-                        //return
-                //if current->getRight() is not null
-                    //current = current->getRight()
-            //if node_to_insert key < current key, insert left
-                //if current->getLeft is null (meaning you insert node_to insert as current keys left child)
-                    //dynamically create new node
-                    //setbalance of new node to 0
-                    //Update current's left child to new node (the dynamically created one)
-                    //Update balance
-                    //Save the parent's current balance to a vaariable
-                    //If balance is 1
-                        //Set current node balance to 0
-                        //Return because balanced
-                    //if balance is 0
-                        //set current node balance to -1
-                        //call InsertFix(new node, current node)
-                        //return
-                //if current->getLeft() is not null
-                    //current = current->getLeft()
-            //if node_to_insert key == current key  
-                //override value with node to insert's value
-                //return
-
-        //pseudocode from slides
-            //if empty tree => set n as root, b(n) = 0, DONE
-            //else insert n (by walking the tree to a leaf, p, and inserting the new node as its child) set balance to 0, and look at its parent pair
-                //if b(p) was -1, then b(p) = 0. DONE
-                //if b(p) was 1, then b(p) = 0. DONE
-                //if b(p) was 0, then update b(p) and call insert-fix(p,n)
-    
-    // std::cout << "Inserting key: " << new_item.first << " with value: " << new_item.second << std::endl;
-
-    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*> (this->root_); 
-    AVLNode<Key, Value>* parent = nullptr; 
+    //pseudocode from slides
+        //if empty tree => set n as root, b(n) = 0, DONE
+        //else insert n (by walking the tree to a leaf, p, and inserting the new node as its child) set balance to 0, and look at its parent pair
+            //if b(p) was -1, then b(p) = 0. DONE
+            //if b(p) was 1, then b(p) = 0. DONE
+            //if b(p) was 0, then update b(p) and call insert-fix(p,n)
+
+    AVLNode<Key, Value>* newNode = static_cast<AVLNode<Key, Value>*>(node); 
+    AVLNode<Key, Value>* parent = newNode->getParent(); 
+    newNode->setBalance(0); 
+
+    //every ancestor gained a node; rotations below recompute sizes from these
+    for (AVLNode<Key, Value>* ancestor = parent; ancestor != nullptr; ancestor = ancestor->getParent()) {
+        ancestor->setSize(ancestor->getSize() + 1); 
+    }
 
     //empty tree case
-    if (this->root_ == nullptr) {
-        AVLNode<Key,Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr); 
-        this->root_ = newNode;
-        static_cast<AVLNode<Key,Value>*>(this->root_)->setBalance(0); 
+    if (parent == nullptr) {
         return;
     }
-    else {
-        AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_); 
-        AVLNode<Key, Value>* parent = nullptr; 
-        
-        
-        //traverse to find a parent for the newnode
-        while (current != nullptr) {
-            parent = current; 
 
-            //if key less than node key go left
-            if (new_item.first < current->getKey()) {
-                current = current->getLeft();
-            }
-            //if key greater than node key go right
-            else if (new_item.first > current->getKey()) {
-                current = current->getRight();
-            }
-            //if key equal to node key replace the value
-            else {
-                current->setValue(new_item.second);
-                return;
-            }
-        }
-
-        AVLNode<Key, Value>* newNode = new AVLNode<Key, Value>(new_item.first, new_item.second, parent);
-        //insert new node into location we found
-        if (new_item.first < parent->getKey()) {
-            parent->setLeft(newNode);
+    if (parent->getBalance() == -1) {
+        parent->setBalance(0);
+        return;
+    }
+    else if (parent->getBalance() == 1) {
+        parent->setBalance(0);
+        return;
+    }
+    else if (parent->getBalance() == 0) {
+        //parent was a leaf, so it now leans towards the new node and grew taller
+        if (parent->getLeft() == newNode) {
+            parent->setBalance(-1); 
         }
         else {
-            parent->setRight(newNode);  
-        }
-        newNode->setBalance(0); 
-
-        if (parent->getBalance() == -1) {
-            parent->setBalance(0);
-            return;
-        }
-        else if (parent->getBalance() == 1) {
-            parent->setBalance(0);
-            return;
+            parent->setBalance(1); 
         }
-        else if (parent->getBalance() == 0) {
-            if (parent == nullptr){
-                return;
-            }
-            int leftHeight = height(parent->getLeft()); 
-            int rightHeight = height(parent->getRight()); 
-            parent->setBalance((int8_t)(rightHeight - leftHeight));
-            insertFix(parent, newNode);
-        }
-
+        parent->setHeight(2); 
+        insertFix(parent, newNode);
     }
 }
 
@@ -770,8 +1853,8 @@ void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>:: remove(const Key& key)
 {
     // TODO
     //Pseudocode:
@@ -829,129 +1912,127 @@ void AVLTree<Key, Value>:: remove(const Key& key)
             return;
         }
 
-        AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_); 
+        //find the node to remove with a single descent
+        AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->internalFind(key)); 
         char diff = 0; 
+        if (current == nullptr) {
+            return;
+        }
+        this->beforeRemove(current); 
 
-        while (current != nullptr) {
-            //check if current node is the one to be removed
-            if (key == current->getKey()) {
-                //Case 1: 0 child
-                if (current->getLeft() == nullptr && current->getRight() == nullptr) {
-                    //if node has no parents(the root), after removal make the root null
-                    if (current->getParent() == nullptr) {
-                        this->root_ = nullptr; 
-                    }
-                    //if it has parents
-                    //find out whether node is a left child or a right child, set diff accordingly
-                    else {
-                        //left
-                        if (current->getParent()->getLeft() == current){
-                            diff = 1; 
-                        }
-                        //right
-                        else if (current->getParent()->getRight() == current){
-                            diff = -1; 
-                        }
-                        //if left child, make parent's left child null
-                        if (current->getParent()->getLeft() == current) {
-                            current->getParent()->setLeft(nullptr); 
-                        }
-                        //if right child, make parent's right child null
-                        else {
-                            current->getParent()->setRight(nullptr);
-                        }
-                    }
-                    break;
+        //2 child case: swap with the predecessor, which has at most one child
+        if (current->getLeft() != nullptr && current->getRight() != nullptr) {
+            AVLNode<Key,Value>* pred = predecessor(current); 
+            nodeSwap(current, pred); 
+        }
+
+        //Case 1: 0 child
+        if (current->getLeft() == nullptr && current->getRight() == nullptr) {
+            //if node has no parents(the root), after removal make the root null
+            if (current->getParent() == nullptr) {
+                this->root_ = nullptr; 
+            }
+            //if it has parents
+            //find out whether node is a left child or a right child, set diff accordingly
+            else {
+                //left
+                if (current->getParent()->getLeft() == current){
+                    diff = 1; 
                 }
-                //case 2: 1 left child 
-                else if (current->getLeft() != nullptr && current->getRight() == nullptr) {
-                    //if node to remove is the root
-                    if (current->getParent() == nullptr) {
-                        this->root_ = current->getLeft(); 
-                    }
-                    //if it has parents
-                    else {
-                        if (current->getParent()->getLeft() == current) {
-                            diff = 1; 
-                        }
-                        else if (current->getParent()->getRight() == current) {
-                            diff = -1; 
-                        }
-                        //if left child make parent's left child current's left child
-                        if (current->getParent()->getLeft() == current) {
-                            current->getParent()->setLeft(current->getLeft());
-                        }
-                        //if right child make parent's right child current's left child
-                        else {
-                            current->getParent()->setRight(current->getLeft());
-                        }
-                    }
-                    //update child's parent pointer to point at grandparent
-                    current->getLeft()->setParent(current->getParent());
-                    break;
+                //right
+                else if (current->getParent()->getRight() == current){
+                    diff = -1; 
                 }
-                //case 3: 1 right child
-                else if (current->getLeft() == nullptr && current->getRight() != nullptr) {
-                    //if no parents, so root
-                    if (current->getParent() == nullptr) {
-                        this->root_ = current->getRight(); 
-                    }
-                    //if it has parents 
-                    else {
-                        if (current->getParent()->getLeft() == current) {
-                            diff = 1; 
-                        }
-                        else if (current->getParent()->getRight() == current) {
-                            diff = -1; 
-                        }
-                        //if left child make parent's left child current's right child
-                        if (current->getParent()->getLeft() == current) {
-                            current->getParent()->setLeft(current->getRight());
-                        }
-                        // if right child make parent's right child current's right child
-                        else {
-                            current->getParent()->setRight(current->getRight());
-                        }
-                    }
-                    //update child's parent pointer to point at grandparent
-                    current->getRight()->setParent(current->getParent());
-                    break;
+                //if left child, make parent's left child null
+                if (current->getParent()->getLeft() == current) {
+                    current->getParent()->setLeft(nullptr); 
                 }
-                //2 child case
+                //if right child, make parent's right child null
                 else {
-                    AVLNode<Key,Value>* pred = predecessor(current); 
-                    nodeSwap(current, pred); 
+                    current->getParent()->setRight(nullptr);
                 }
             }
-            //continue looking for matching key
+        }
+        //case 2: 1 left child 
+        else if (current->getLeft() != nullptr && current->getRight() == nullptr) {
+            //if node to remove is the root
+            if (current->getParent() == nullptr) {
+                this->root_ = current->getLeft(); 
+            }
+            //if it has parents
             else {
-                if (key < current->getKey()) {
-                    current = current->getLeft(); 
+                if (current->getParent()->getLeft() == current) {
+                    diff = 1; 
+                }
+                else if (current->getParent()->getRight() == current) {
+                    diff = -1; 
                 }
+                //if left child make parent's left child current's left child
+                if (current->getParent()->getLeft() == current) {
+                    current->getParent()->setLeft(current->getLeft());
+                }
+                //if right child make parent's right child current's left child
                 else {
-                    current = current->getRight(); 
+                    current->getParent()->setRight(current->getLeft());
                 }
             }
+            //update child's parent pointer to point at grandparent
+            current->getLeft()->setParent(current->getParent());
         }
-
-        //balance tree
-        if (current == nullptr) {
-            return;
+        //case 3: 1 right child
+        else if (current->getLeft() == nullptr && current->getRight() != nullptr) {
+            //if no parents, so root
+            if (current->getParent() == nullptr) {
+                this->root_ = current->getRight(); 
+            }
+            //if it has parents 
+            else {
+                if (current->getParent()->getLeft() == current) {
+                    diff = 1; 
+                }
+                else if (current->getParent()->getRight() == current) {
+                    diff = -1; 
+                }
+                //if left child make parent's left child current's right child
+                if (current->getParent()->getLeft() == current) {
+                    current->getParent()->setLeft(current->getRight());
+                }
+                // if right child make parent's right child current's right child
+                else {
+                    current->getParent()->setRight(current->getRight());
+                }
+            }
+            //update child's parent pointer to point at grandparent
+            current->getRight()->setParent(current->getParent());
         }
+
+        //every ancestor lost a node, which removeFix's rotations rely on
         AVLNode<Key, Value>* parent = current->getParent();
+        for (AVLNode<Key, Value>* ancestor = parent; ancestor != nullptr; ancestor = ancestor->getParent()) {
+            ancestor->setSize(ancestor->getSize() - 1); 
+        }
+
+        //balance tree
         if (parent != nullptr) {
             removeFix(parent, diff); 
         }
-        delete current; 
+        destroyNode(current); 
+        --this->size_; 
 }
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, class Compare>
+void AVLTree<Key, Value, Compare>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
 {
-    BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+    int8_t tempH = n1->getHeight();
+    n1->setHeight(n2->getHeight());
+    n2->setHeight(tempH);
+    std::size_t tempS = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempS);
 }
 
 
@@ -0,0 +1,1483 @@
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <new>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "bst.h"
+#include "avlbst.h"
+#include "threaded_avlbst.h"
+#include "btree_map.h"
+#include "rbbst.h"
+#include "splaybst.h"
+#include "compact_avlbst.h"
+#include "parentless_avlbst.h"
+#include "persistent_avlbst.h"
+#include "concurrent_avlbst.h"
+
+using namespace std;
+
+/*
+  Micro benchmarks for the search trees.
+
+  Usage: ./bst-bench [section] [n]
+    section  one of the names in the table at the bottom of this file,
+             or "all" (the default) to run every section
+    n        number of keys to use (default 1000000)
+*/
+
+typedef chrono::steady_clock Clock;
+
+// Every heap allocation in the program, so sections can report allocations
+// per op and bytes per item. The concurrent sections allocate from several
+// threads at once; the counts only need to be exact once those have joined.
+atomic<size_t> allocationCount(0);
+atomic<size_t> allocationBytes(0);
+
+void* operator new(size_t bytes)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocationBytes.fetch_add(bytes, memory_order_relaxed);
+    void* p = malloc(bytes == 0 ? 1 : bytes);
+    if(p == NULL) {
+        throw bad_alloc();
+    }
+    return p;
+}
+
+// Not inlined, or GCC sees the free() in std::thread's cleanup and warns
+// that it does not match the new
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+/**
+* Runs f once and returns the elapsed wall time in seconds.
+*/
+template<typename F>
+double timeIt(F f)
+{
+    Clock::time_point start = Clock::now();
+    f();
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+/**
+* Prints one result line as nanoseconds per operation.
+*/
+void report(const string& label, size_t ops, double secs)
+{
+    cout << "  " << left << setw(44) << label << right << setw(10)
+         << fixed << setprecision(1) << (secs * 1e9 / ops) << " ns/op" << endl;
+}
+
+/**
+* Returns the keys 0..n-1 in a random (but repeatable) order.
+*/
+vector<int> shuffledKeys(size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = (int)i;
+    }
+    mt19937 rng(104);
+    shuffle(keys.begin(), keys.end(), rng);
+    return keys;
+}
+
+/**
+* An AVLTree that allocates each node with new/delete instead of the
+* NodePool, used as the baseline for the allocator benchmark.
+*/
+template<class Key, class Value>
+class HeapAVLTree : public AVLTree<Key, Value>
+{
+public:
+    ~HeapAVLTree()
+    {
+        clearAll();
+    }
+    void clearAll()
+    {
+        this->clearHelper(this->root_);
+        this->root_ = nullptr;
+    }
+protected:
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+    {
+        return new AVLNode<Key, Value>(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+    }
+    virtual Node<Key, Value>* createNode(Key&& key, Value&& value, Node<Key, Value>* parent)
+    {
+        return new AVLNode<Key, Value>(std::move(key), std::move(value), static_cast<AVLNode<Key, Value>*>(parent));
+    }
+    virtual void destroyNode(Node<Key, Value>* node)
+    {
+        delete static_cast<AVLNode<Key, Value>*>(node);
+    }
+};
+
+void resetTree(AVLTree<int, int>& tree)
+{
+    tree.clear();
+}
+
+void resetTree(HeapAVLTree<int, int>& tree)
+{
+    tree.clearAll();
+}
+
+template<typename Tree>
+void allocRun(const string& label, const vector<int>& keys)
+{
+    Tree tree;
+    size_t n = keys.size();
+    double insertSecs = timeIt([&]() {
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    // remove and reinsert half of the keys so freed nodes get reused
+    double churnSecs = timeIt([&]() {
+        for(size_t i = 0; i < n; i += 2) {
+            tree.remove(keys[i]);
+        }
+        for(size_t i = 0; i < n; i += 2) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    double clearSecs = timeIt([&]() {
+        resetTree(tree);
+    });
+    report(label + " insert", n, insertSecs);
+    report(label + " remove+reinsert", n, churnSecs);
+    report(label + " clear", n, clearSecs);
+}
+
+/**
+* NodePool against plain new/delete for insert, remove and clear.
+*/
+void benchAlloc(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    allocRun<HeapAVLTree<int, int> >("new/delete AVLTree", keys);
+    allocRun<AVLTree<int, int> >("NodePool AVLTree", keys);
+}
+
+/**
+* An AVLTree that can report the shape of its nodes.
+*/
+template<class Key, class Value>
+class InspectableAVLTree : public AVLTree<Key, Value>
+{
+public:
+    // Returns the average depth (root = 1) of the nodes in the tree.
+    double averageDepth() const
+    {
+        size_t count = 0;
+        double total = depthSum(this->root_, 1, count);
+        return count == 0 ? 0 : total / count;
+    }
+    // Returns the cached height of the root.
+    int rootHeight() const
+    {
+        return this->height(static_cast<AVLNode<Key, Value>*>(this->root_));
+    }
+    // Finds the smallest node by walking the left spine, as begin() used to.
+    Node<Key, Value>* walkToSmallest() const
+    {
+        return this->getSmallestNode();
+    }
+private:
+    static double depthSum(Node<Key, Value>* node, int depth, size_t& count)
+    {
+        if(node == nullptr) {
+            return 0;
+        }
+        ++count;
+        return depth + depthSum(node->getLeft(), depth + 1, count)
+                     + depthSum(node->getRight(), depth + 1, count);
+    }
+};
+
+/**
+* Successful random lookups with find(), reported per lookup and per
+* level of the descent.
+*/
+void benchFind(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    InspectableAVLTree<int, int> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    mt19937 rng(7);
+    shuffle(keys.begin(), keys.end(), rng);
+
+    long long sum = 0;
+    double secs = timeIt([&]() {
+        for(size_t i = 0; i < n; ++i) {
+            sum += tree.find(keys[i])->second;
+        }
+    });
+    double depth = tree.averageDepth();
+    report("AVLTree find", n, secs);
+    report("AVLTree find per level", (size_t)(n * depth), secs);
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+/**
+* Inserts sequential and random keys into trees of growing size, up to n,
+* and reports the cost per insert divided by log2 of the tree size. With
+* O(log n) inserts the last column stays flat as the tree grows.
+*/
+void benchScaling(size_t n)
+{
+    cout << "  " << left << setw(10) << "size" << setw(12) << "order" << right
+         << setw(12) << "ns/insert" << setw(16) << "ns/insert/lg n" << setw(8) << "height" << endl;
+    for(size_t size = 1000; size <= n; size *= 10) {
+        vector<int> sequential(size);
+        for(size_t i = 0; i < size; ++i) {
+            sequential[i] = (int)i;
+        }
+        vector<int> random = shuffledKeys(size);
+        const vector<int>* orders[] = { &sequential, &random };
+        const char* names[] = { "sequential", "random" };
+
+        for(int o = 0; o < 2; ++o) {
+            const vector<int>& keys = *orders[o];
+            InspectableAVLTree<int, int> tree;
+            double secs = timeIt([&]() {
+                for(size_t i = 0; i < size; ++i) {
+                    tree.insert(make_pair(keys[i], keys[i]));
+                }
+            });
+            double perOp = secs * 1e9 / size;
+            cout << "  " << left << setw(10) << size << setw(12) << names[o] << right
+                 << setw(12) << fixed << setprecision(1) << perOp
+                 << setw(16) << perOp / log2((double)size)
+                 << setw(8) << tree.rootHeight() << endl;
+        }
+    }
+}
+
+/**
+* Building a tree from n sorted pairs with repeated inserts, with the
+* bulk-load constructor, and with the constructor on shuffled input.
+*/
+void benchBulkLoad(size_t n)
+{
+    vector<pair<int, int> > sorted(n);
+    for(size_t i = 0; i < n; ++i) {
+        sorted[i] = make_pair((int)i, (int)i);
+    }
+    vector<pair<int, int> > shuffled(sorted);
+    mt19937 rng(3);
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    double insertSecs = timeIt([&]() {
+        AVLTree<int, int> tree;
+        for(size_t i = 0; i < n; ++i) {
+            tree.insert(sorted[i]);
+        }
+    });
+    double bulkSecs = timeIt([&]() {
+        AVLTree<int, int> tree(sorted.begin(), sorted.end());
+    });
+    double sortSecs = timeIt([&]() {
+        AVLTree<int, int> tree(shuffled.begin(), shuffled.end(), false);
+    });
+    report("AVLTree insert one at a time (sorted)", n, insertSecs);
+    report("AVLTree bulk load (sorted)", n, bulkSecs);
+    report("AVLTree bulk load (shuffled, sort first)", n, sortSecs);
+}
+
+/**
+* Lookups on string keys that share a long prefix, ordered by std::less
+* and by the three-way StringCompare, with std::string and C string probes.
+*/
+void benchCompare(size_t n)
+{
+    vector<int> ids = shuffledKeys(n);
+    vector<string> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = "customer/region-0/account-" + to_string(ids[i]);
+    }
+
+    AVLTree<string, int> lessTree;
+    AVLTree<string, int, StringCompare> threeWayTree;
+    for(size_t i = 0; i < n; ++i) {
+        lessTree.insert(make_pair(keys[i], (int)i));
+        threeWayTree.insert(make_pair(keys[i], (int)i));
+    }
+    mt19937 rng(11);
+    shuffle(keys.begin(), keys.end(), rng);
+
+    long long sum = 0;
+    double lessSecs = timeIt([&]() {
+        for(size_t i = 0; i < n; ++i) {
+            sum += lessTree.find(keys[i])->second;
+        }
+    });
+    double threeWaySecs = timeIt([&]() {
+        for(size_t i = 0; i < n; ++i) {
+            sum += threeWayTree.find(keys[i])->second;
+        }
+    });
+    double cStringSecs = timeIt([&]() {
+        for(size_t i = 0; i < n; ++i) {
+            sum += threeWayTree.find(keys[i].c_str())->second;
+        }
+    });
+    report("find, std::less<string>", n, lessSecs);
+    report("find, StringCompare", n, threeWaySecs);
+    report("find, StringCompare with const char*", n, cStringSecs);
+    if(sum == 42) cout << "";
+}
+
+typedef vector<int> HeavyValue;
+
+HeavyValue makeValue(int key)
+{
+    return HeavyValue(64, key);
+}
+
+/**
+* Upserts of a heap-owning value over n/2 distinct keys (so half the ops
+* insert and half overwrite) through the copying insert and the move-aware
+* APIs, reporting time and heap allocations per op.
+*/
+template<typename F>
+void upsertRun(const string& label, const vector<int>& keys, F op)
+{
+    AVLTree<int, HeavyValue> tree;
+    size_t before = allocationCount.load(memory_order_relaxed);
+    double secs = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            op(tree, keys[i]);
+        }
+    });
+    double allocs = (double)(allocationCount.load(memory_order_relaxed) - before) / keys.size();
+    cout << "  " << left << setw(44) << label << right << setw(10) << fixed << setprecision(1)
+         << (secs * 1e9 / keys.size()) << " ns/op" << setw(8) << setprecision(2) << allocs << " allocs/op" << endl;
+}
+
+void benchUpsert(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] /= 2;
+    }
+    upsertRun("insert(const pair&)", keys, [](AVLTree<int, HeavyValue>& tree, int key) {
+        const pair<const int, HeavyValue> item(key, makeValue(key));
+        tree.insert(item);
+    });
+    upsertRun("insert(pair&&)", keys, [](AVLTree<int, HeavyValue>& tree, int key) {
+        tree.insert(make_pair(key, makeValue(key)));
+    });
+    upsertRun("insert_or_assign", keys, [](AVLTree<int, HeavyValue>& tree, int key) {
+        tree.insert_or_assign(key, makeValue(key));
+    });
+    upsertRun("try_emplace", keys, [](AVLTree<int, HeavyValue>& tree, int key) {
+        tree.try_emplace(key, 64, key);
+    });
+}
+
+/**
+* Builds a tree from n keys arriving in increasing order, nearly in order
+* (each key displaced by at most a few places) and in random order, once
+* with plain inserts and once passing the previous insert's iterator as
+* the hint.
+*/
+void hintRun(const string& stream, const vector<int>& keys)
+{
+    double plain = timeIt([&]() {
+        AVLTree<int, int> tree;
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    report(stream + ": insert", keys.size(), plain);
+    double hinted = timeIt([&]() {
+        AVLTree<int, int> tree;
+        AVLTree<int, int>::iterator hint = tree.end();
+        for(size_t i = 0; i < keys.size(); ++i) {
+            hint = tree.insert(hint, make_pair(keys[i], keys[i]));
+        }
+    });
+    report(stream + ": insert(hint)", keys.size(), hinted);
+}
+
+void benchHint(size_t n)
+{
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = (int)i;
+    }
+    hintRun("monotone", keys);
+
+    mt19937 rng(104);
+    for(size_t i = 0; i + 1 < n; ++i) {
+        size_t j = i + rng() % min<size_t>(8, n - i);
+        swap(keys[i], keys[j]);
+    }
+    hintRun("near-sorted", keys);
+
+    hintRun("random", shuffledKeys(n));
+}
+
+/**
+* Percentile lookups on a tree of n random keys: select() against walking
+* from begin(), plus rank() and count_range().
+*/
+void benchRank(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    const double percentiles[] = { 0.5, 0.9, 0.99 };
+    const size_t queries = 1000;
+
+    long long sum = 0;
+    double scan = timeIt([&]() {
+        for(size_t q = 0; q < 3; ++q) {
+            size_t k = (size_t)(percentiles[q] * (tree.size() - 1));
+            AVLTree<int, int>::iterator it = tree.begin();
+            for(size_t i = 0; i < k; ++i) {
+                ++it;
+            }
+            sum += it->first;
+        }
+    });
+    report("percentile by scanning from begin()", 3, scan);
+    double select = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            size_t k = (size_t)(percentiles[q % 3] * (tree.size() - 1));
+            sum += tree.select(k)->first;
+        }
+    });
+    report("percentile by select(k)", queries, select);
+
+    double rank = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            sum += tree.rank(keys[q]);
+        }
+    });
+    report("rank(key)", queries, rank);
+    double range = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            sum += tree.count_range(keys[q] / 2, keys[q]);
+        }
+    });
+    report("count_range(lo, hi)", queries, range);
+    if(sum == 42) cout << "";   // keep the queries alive
+}
+
+/**
+* Ordered searches on a tree of n random keys, and summing the values of
+* 100 consecutive keys with range() against filtering a scan from begin().
+*/
+void benchRange(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    //every query key is in the tree, so there are at most n different ones
+    const size_t queries = min<size_t>(n, 100000);
+    const size_t scans = min<size_t>(n, 10);
+    long long sum = 0;
+
+    double lower = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            sum += tree.lower_bound(keys[q])->second;
+        }
+    });
+    report("lower_bound", queries, lower);
+    double floor = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            sum += tree.floor(keys[q])->second;
+        }
+    });
+    report("floor", queries, floor);
+
+    const int width = 100;
+    double scan = timeIt([&]() {
+        for(size_t q = 0; q < scans; ++q) {
+            for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+                if(it->first >= keys[q] && it->first < keys[q] + width) {
+                    sum += it->second;
+                }
+            }
+        }
+    });
+    report("100-key range by scanning from begin()", scans, scan);
+    double range = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            for(const pair<const int, int>& item : tree.range(keys[q], keys[q] + width)) {
+                sum += item.second;
+            }
+        }
+    });
+    report("100-key range by range(lo, hi)", queries, range);
+    if(sum == 42) cout << "";   // keep the queries alive
+}
+
+/**
+* Finding the ends of a tree of n random keys, a descending scan, and a
+* pop-min loop that drains the tree through begin().
+*/
+void benchIterate(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    InspectableAVLTree<int, int> tree;
+    for(size_t i = 0; i < n; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    const size_t queries = 1000000;
+    long long sum = 0;
+
+    double walk = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            sum += tree.walkToSmallest()->getKey();
+        }
+    });
+    report("smallest by walking the left spine", queries, walk);
+    double cached = timeIt([&]() {
+        for(size_t q = 0; q < queries; ++q) {
+            sum += tree.begin()->first + tree.max()->first;
+        }
+    });
+    report("begin() + max()", queries, cached);
+
+    double forward = timeIt([&]() {
+        for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report("ascending scan per item", n, forward);
+    double backward = timeIt([&]() {
+        for(AVLTree<int, int>::reverse_iterator it = tree.rbegin(); it != tree.rend(); ++it) {
+            sum += it->second;
+        }
+    });
+    report("descending scan per item", n, backward);
+
+    double popMin = timeIt([&]() {
+        while(!tree.empty()) {
+            tree.remove(tree.begin()->first);
+        }
+    });
+    report("pop-min loop per item", n, popMin);
+    if(sum == 42) cout << "";   // keep the queries alive
+}
+
+/**
+* Inserting n random keys, scanning them both ways and removing them again,
+* with and without successor/predecessor threads.
+*/
+template<typename Tree>
+void threadedRun(const string& name, const vector<int>& keys)
+{
+    Tree tree;
+    long long sum = 0;
+    double insert = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    report(name + " insert", keys.size(), insert);
+    double forward = timeIt([&]() {
+        for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report(name + " ascending scan per item", keys.size(), forward);
+    double backward = timeIt([&]() {
+        typename Tree::iterator it = tree.end();
+        while(it != tree.begin()) {
+            --it;
+            sum += it->second;
+        }
+    });
+    report(name + " descending scan per item", keys.size(), backward);
+    double remove = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.remove(keys[i]);
+        }
+    });
+    report(name + " remove", keys.size(), remove);
+    if(sum == 42) cout << "";   // keep the scans alive
+}
+
+void benchThreaded(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    threadedRun<AVLTree<int, int> >("AVLTree", keys);
+    threadedRun<ThreadedAVLTree<int, int> >("ThreadedAVLTree", keys);
+}
+
+/**
+* Random successful lookups with AVLTree::find() and with the frozen
+* Eytzinger copy, on trees from n/100 up to n keys. Run with a larger n
+* (e.g. 100000000, given enough memory) to see larger trees.
+*/
+void benchFreeze(size_t n)
+{
+    for(size_t size = max<size_t>(n / 100, 1); size <= n; size *= 10) {
+        vector<int> keys = shuffledKeys(size);
+        AVLTree<int, int> tree;
+        for(size_t i = 0; i < size; ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+        FrozenTree<int, int> frozen;
+        double build = timeIt([&]() { frozen = tree.freeze(); });
+        mt19937 rng(7);
+        shuffle(keys.begin(), keys.end(), rng);
+        const size_t queries = min<size_t>(size, 1000000);
+
+        long long sum = 0;
+        double find = timeIt([&]() {
+            for(size_t i = 0; i < queries; ++i) {
+                sum += tree.find(keys[i])->second;
+            }
+        });
+        double frozenFind = timeIt([&]() {
+            for(size_t i = 0; i < queries; ++i) {
+                sum += *frozen.find(keys[i]);
+            }
+        });
+        string label = to_string(size) + " keys: ";
+        report(label + "freeze() per key", size, build);
+        report(label + "AVLTree find", queries, find);
+        report(label + "FrozenTree find", queries, frozenFind);
+        if(sum == 42) cout << "";   // keep the lookups alive
+    }
+}
+
+/**
+* Random inserts, lookups, a full scan and removes with the same code
+* running on any of the map types.
+*/
+template<typename Tree>
+void mapRun(const string& name, const vector<int>& keys)
+{
+    vector<int> lookups(keys);
+    mt19937 rng(7);
+    shuffle(lookups.begin(), lookups.end(), rng);
+    Tree tree;
+    long long sum = 0;
+
+    double insert = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    report(name + " insert", keys.size(), insert);
+    double find = timeIt([&]() {
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            sum += tree.find(lookups[i])->second;
+        }
+    });
+    report(name + " find", lookups.size(), find);
+    double scan = timeIt([&]() {
+        for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report(name + " scan per item", keys.size(), scan);
+    double remove = timeIt([&]() {
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            tree.remove(lookups[i]);
+        }
+    });
+    report(name + " remove", lookups.size(), remove);
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+void benchBTree(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    mapRun<AVLTree<int, int> >("AVLTree", keys);
+    mapRun<BTreeMap<int, int> >("BTreeMap", keys);
+}
+
+/**
+* A write-heavy mix on a tree holding n / 2 keys: each round removes the
+* oldest key, inserts a new one and looks up a live one, so half of the
+* updates are removes.
+*/
+template<typename Tree>
+void churnRun(const string& name, const vector<int>& keys)
+{
+    size_t half = keys.size() / 2;
+    Tree tree;
+    for(size_t i = 0; i < half; ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    mt19937 rng(11);
+    long long sum = 0;
+    double churn = timeIt([&]() {
+        for(size_t i = 0; i < keys.size() - half; ++i) {
+            tree.remove(keys[i]);
+            tree.insert(make_pair(keys[half + i], keys[half + i]));
+            sum += tree.find(keys[i + 1 + rng() % half])->second;
+        }
+    });
+    report(name + " remove+insert+find", keys.size() - half, churn);
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+/**
+* AVLTree against RBTree on the mapRun workload and on a remove-heavy mix.
+*/
+void benchRBTree(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    mapRun<AVLTree<int, int> >("AVLTree", keys);
+    mapRun<RBTree<int, int> >("RBTree", keys);
+    churnRun<AVLTree<int, int> >("AVLTree", keys);
+    churnRun<RBTree<int, int> >("RBTree", keys);
+}
+
+/**
+* Returns count lookups drawn from keys with Zipf weights: the i-th most
+* popular key (in a random order) is drawn with probability proportional to
+* 1 / i^skew.
+*/
+vector<int> zipfLookups(const vector<int>& keys, size_t count, double skew)
+{
+    vector<double> cdf(keys.size());
+    double total = 0;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        total += 1.0 / pow((double)(i + 1), skew);
+        cdf[i] = total;
+    }
+    mt19937 rng(13);
+    uniform_real_distribution<double> pick(0, total);
+    vector<int> lookups(count);
+    for(size_t i = 0; i < count; ++i) {
+        size_t rank = lower_bound(cdf.begin(), cdf.end(), pick(rng)) - cdf.begin();
+        lookups[i] = keys[min(rank, keys.size() - 1)];
+    }
+    return lookups;
+}
+
+template<typename Tree>
+void zipfRun(const string& label, Tree& tree, const vector<int>& keys, const vector<int>& lookups)
+{
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    long long sum = 0;
+    double secs = timeIt([&]() {
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            sum += tree.find(lookups[i])->second;
+        }
+    });
+    report(label, lookups.size(), secs);
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+/**
+* Skewed lookups on AVLTree and on SplayTree with each splaying option.
+* With skew 1.2 about 90% of the lookups hit 1% of the keys.
+*/
+void benchSplay(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    const double skews[] = { 1.2, 0.99 };
+    for(size_t s = 0; s < sizeof(skews) / sizeof(skews[0]); ++s) {
+        vector<int> lookups = zipfLookups(keys, n, skews[s]);
+        string zipf = "zipf " + to_string(skews[s]).substr(0, 4) + " ";
+        {
+            AVLTree<int, int> tree;
+            zipfRun(zipf + "AVLTree find", tree, keys, lookups);
+        }
+        {
+            SplayTree<int, int> tree;
+            zipfRun(zipf + "SplayTree find", tree, keys, lookups);
+        }
+        {
+            SplayTree<int, int> tree;
+            tree.setSemiSplay(true);
+            zipfRun(zipf + "SplayTree semi-splay find", tree, keys, lookups);
+        }
+        {
+            SplayTree<int, int> tree;
+            tree.setSplayPeriod(8);
+            zipfRun(zipf + "SplayTree every 8th find", tree, keys, lookups);
+        }
+    }
+}
+
+/**
+* Heap bytes per item, then insert, find, scan and remove times, for 64-bit
+* keys and values. Bytes are counted as allocated, so the pools and blocks are
+* charged in full.
+*/
+template<typename Tree>
+void compactRun(const string& name, const vector<int>& keys)
+{
+    vector<int> lookups(keys);
+    mt19937 rng(7);
+    shuffle(lookups.begin(), lookups.end(), rng);
+    unsigned long long sum = 0;
+    size_t bytesBefore = allocationBytes.load(memory_order_relaxed);
+    Tree* tree = new Tree;
+
+    double insert = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree->insert(make_pair((uint64_t)keys[i], (uint64_t)keys[i]));
+        }
+    });
+    cout << "  " << left << setw(44) << name + " memory" << right << setw(10)
+         << fixed << setprecision(1) << (double)(allocationBytes.load(memory_order_relaxed) - bytesBefore) / keys.size() << " bytes/item" << endl;
+    report(name + " insert", keys.size(), insert);
+    double find = timeIt([&]() {
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            sum += tree->find((uint64_t)lookups[i])->second;
+        }
+    });
+    report(name + " find", lookups.size(), find);
+    double scan = timeIt([&]() {
+        for(typename Tree::iterator it = tree->begin(); it != tree->end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report(name + " scan per item", keys.size(), scan);
+    double remove = timeIt([&]() {
+        for(size_t i = 0; i < lookups.size(); ++i) {
+            tree->remove((uint64_t)lookups[i]);
+        }
+    });
+    report(name + " remove", lookups.size(), remove);
+    delete tree;
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+void benchCompact(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    compactRun<AVLTree<uint64_t, uint64_t> >("AVLTree", keys);
+    compactRun<CompactAVLTree<uint64_t, uint64_t> >("CompactAVLTree", keys);
+}
+
+void benchParentless(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    compactRun<AVLTree<uint64_t, uint64_t> >("AVLTree", keys);
+    compactRun<ParentlessAVLTree<uint64_t, uint64_t> >("ParentlessAVLTree", keys);
+}
+
+/**
+* Warm restart: rebuilding an AVLTree by replaying inserts against saving it
+* to a snapshot and loading it back. The file is written to the current
+* directory and removed afterwards.
+*/
+void benchSnapshot(size_t n)
+{
+    const char* path = "bst-bench.snapshot";
+    vector<int> keys = shuffledKeys(n);
+    AVLTree<int, int> tree;
+    double replay = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    report("replay insert", n, replay);
+
+    double save = timeIt([&]() {
+        tree.save(path);
+    });
+    report("save", n, save);
+    AVLTree<int, int> loaded;
+    double load = timeIt([&]() {
+        loaded.load(path);
+    });
+    report("load", n, load);
+    double megabytes = (double)(sizeof(SnapshotHeader) + n * (sizeof(int) + sizeof(int))) / (1 << 20);
+    cout << "  snapshot " << fixed << setprecision(1) << megabytes << " MB: save "
+         << megabytes / save << " MB/s, load " << megabytes / load << " MB/s, "
+         << replay / load << "x faster than replay" << endl;
+    remove(path);
+}
+
+struct Section
+{
+    const char* name;
+    void (*run)(size_t n);
+};
+
+/**
+* Writing a tree as a mapped file, opening it, and then random lookups and
+* a full scan through the view next to the same work on the AVLTree it was
+* written from. Opening is timed once for the whole file.
+*/
+void benchMapped(size_t n)
+{
+    const char* path = "bst-bench.mapped";
+    vector<int> keys = shuffledKeys(n);
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    double save = timeIt([&]() {
+        tree.saveMapped(path);
+    });
+    report("saveMapped", n, save);
+    MappedTreeView<int, int> view;
+    double open = timeIt([&]() {
+        view.open(path);
+    });
+    report("open (whole file)", 1, open);
+
+    mt19937 rng(7);
+    shuffle(keys.begin(), keys.end(), rng);
+    long long sum = 0;
+    double find = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            sum += tree.find(keys[i])->second;
+        }
+    });
+    report("AVLTree find", n, find);
+    double mappedFind = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            sum += view.find(keys[i])->second;
+        }
+    });
+    report("MappedTreeView find", n, mappedFind);
+    double scan = timeIt([&]() {
+        for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report("AVLTree scan per item", n, scan);
+    double mappedScan = timeIt([&]() {
+        for(MappedTreeView<int, int>::const_iterator it = view.begin(); it != view.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report("MappedTreeView scan per item", n, mappedScan);
+    if(sum == 42) cout << "";   // keep the lookups alive
+    view.close();
+    remove(path);
+}
+
+/**
+* Random successful lookups on a tree larger than the last-level cache, in
+* request-sized batches: a find() loop against find_batch(), for AVLTree
+* and RBTree.
+*/
+template<typename Tree>
+void batchRun(const string& name, const vector<int>& keys)
+{
+    Tree tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    vector<int> lookups(keys);
+    mt19937 rng(7);
+    shuffle(lookups.begin(), lookups.end(), rng);
+    long long sum = 0;
+
+    const size_t batchSizes[] = { 64, 512 };
+    for(size_t b = 0; b < sizeof(batchSizes) / sizeof(batchSizes[0]); ++b) {
+        const size_t batch = batchSizes[b];
+        vector<int> request(batch);
+        vector<typename Tree::iterator> found;
+        size_t queries = lookups.size() / batch * batch;
+        double serial = timeIt([&]() {
+            for(size_t i = 0; i < queries; i += batch) {
+                request.assign(lookups.begin() + i, lookups.begin() + i + batch);
+                found.clear();
+                for(size_t j = 0; j < batch; ++j) {
+                    found.push_back(tree.find(request[j]));
+                }
+                sum += found[batch - 1]->second;
+            }
+        });
+        double batched = timeIt([&]() {
+            for(size_t i = 0; i < queries; i += batch) {
+                request.assign(lookups.begin() + i, lookups.begin() + i + batch);
+                tree.find_batch(request, found);
+                sum += found[batch - 1]->second;
+            }
+        });
+        string label = name + " batch of " + to_string(batch) + ": ";
+        report(label + "find loop", queries, serial);
+        report(label + "find_batch", queries, batched);
+    }
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+void benchBatch(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    batchRun<AVLTree<int, int> >("AVLTree", keys);
+    batchRun<RBTree<int, int> >("RBTree", keys);
+}
+
+/**
+* Lookups of k sorted keys from an n-key AVLTree, from n/1000 up to every
+* key: a find() loop from the root each time, a finger that starts each
+* search from the previous result, and find_sorted_batch().
+*/
+void benchFinger(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+    long long sum = 0;
+    for(size_t k = max<size_t>(n / 1000, 1); k <= n; k *= 10) {
+        //every (n/k)-th key
+        vector<int> probes;
+        for(size_t i = 0; i < k; ++i) {
+            probes.push_back((int)(i * (n / k)));
+        }
+        vector<AVLTree<int, int>::iterator> found(k);
+        double serial = timeIt([&]() {
+            for(size_t i = 0; i < probes.size(); ++i) {
+                found[i] = tree.find(probes[i]);
+            }
+        });
+        sum += found[0] == tree.end();
+        double finger = timeIt([&]() {
+            AVLTree<int, int>::finger cursor(tree);
+            for(size_t i = 0; i < probes.size(); ++i) {
+                found[i] = cursor.find(probes[i]);
+            }
+        });
+        sum += found[0] == tree.end();
+        double sorted = timeIt([&]() {
+            tree.find_sorted_batch(probes, found);
+        });
+        sum += found[0] == tree.end();
+        string label = to_string(k) + " sorted keys: ";
+        report(label + "find loop", k, serial);
+        report(label + "finger find", k, finger);
+        report(label + "find_sorted_batch", k, sorted);
+    }
+    if(sum == 42) cout << "";   // keep the lookups alive
+}
+
+/**
+* Cutting an n-key AVLTree at its middle key: removing the older half one
+* key at a time (and inserting it into an archive tree), against one
+* split() and then join() to put it back, into a fresh tree (which takes
+* over the nodes by sharing the pool), into a tree that already held items
+* and keeps its own pool, and into a tree made to share the pool. Times are
+* for the whole cut.
+*/
+void benchSplit(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    int middle = (int)(n / 2);
+    AVLTree<int, int> tree;
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(make_pair(keys[i], keys[i]));
+    }
+
+    AVLTree<int, int> archive;
+    double removes = timeIt([&]() {
+        for(int key = 0; key < middle; ++key) {
+            archive.insert(make_pair(key, tree[key]));
+            tree.remove(key);
+        }
+    });
+    report("remove older half one by one, whole cut", 1, removes);
+
+    double rejoin = timeIt([&]() {
+        archive.join(tree);
+    });
+    report("join the archive back on, own pools", 1, rejoin);
+
+    AVLTree<int, int> used;
+    used.insert(make_pair(-1, -1));
+    double split = timeIt([&]() {
+        archive.split(middle, used);
+    });
+    report("split at the middle, own pools", 1, split);
+    double join = timeIt([&]() {
+        archive.join(used);
+    });
+    report("join the halves back, own pools", 1, join);
+
+    AVLTree<int, int> fresh;
+    double freshSplit = timeIt([&]() {
+        archive.split(middle, fresh);
+    });
+    report("split at the middle, fresh tree", 1, freshSplit);
+    double freshJoin = timeIt([&]() {
+        archive.join(fresh);
+    });
+    report("join the halves back, fresh tree", 1, freshJoin);
+
+    AVLTree<int, int> sibling(share_pool, archive);
+    double sharedSplit = timeIt([&]() {
+        archive.split(middle, sibling);
+    });
+    report("split at the middle, shared pool", 1, sharedSplit);
+    double sharedJoin = timeIt([&]() {
+        archive.join(sibling);
+    });
+    report("join the halves back, shared pool", 1, sharedJoin);
+    if(archive.size() != n) cout << "lost items" << endl;
+}
+
+/**
+* Returns the items k * step for k in 0..count-1, in key order.
+*/
+vector<pair<int, int> > multiples(size_t count, int step)
+{
+    vector<pair<int, int> > items(count);
+    for(size_t i = 0; i < count; ++i) {
+        items[i] = make_pair((int)i * step, (int)i);
+    }
+    return items;
+}
+
+/**
+* Set algebra on two AVL trees of n items, every second and every third
+* integer, so a third of the keys are shared. Union is compared with
+* inserting one tree's items into the other, and each operation is timed
+* over a sweep of thread counts. The unions over a thread sweep use trees
+* that share a pool; one run with separate pools shows the cost of moving
+* the items across. The last unions merge in a tree of only n / 1000 items,
+* where the O(m log(n/m + 1)) work pays off most.
+*/
+void benchSetOps(size_t n)
+{
+    vector<pair<int, int> > evens = multiples(n, 2);
+    vector<pair<int, int> > thirds = multiples(n, 3);
+    vector<pair<int, int> > sparse = multiples(n / 1000 + 1, 2999);
+    unsigned threadCounts[] = { 1, 2, 4, 8 };
+    size_t sizes[4];
+
+    {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(thirds.begin(), thirds.end());
+        double secs = timeIt([&]() {
+            for(AVLTree<int, int>::iterator it = other.begin(); it != other.end(); ++it) {
+                tree.insert(make_pair(it->first, it->second));
+            }
+        });
+        report("union by inserting, per item", n, secs);
+    }
+    {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(thirds.begin(), thirds.end());
+        double secs = timeIt([&]() {
+            tree.union_with(other, 1);
+        });
+        report("union_with, own pools, 1 thread, per item", n, secs);
+    }
+    for(size_t t = 0; t < 4; ++t) {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(share_pool, tree);
+        other.assign(thirds.begin(), thirds.end());
+        double secs = timeIt([&]() {
+            tree.union_with(other, threadCounts[t]);
+        });
+        sizes[t] = tree.size();
+        report("union_with, " + to_string(threadCounts[t]) + " threads, per item", n, secs);
+    }
+    for(size_t t = 0; t < 4; ++t) {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(thirds.begin(), thirds.end());
+        double secs = timeIt([&]() {
+            tree.intersect_with(other, threadCounts[t]);
+        });
+        report("intersect_with, " + to_string(threadCounts[t]) + " threads, per item", n, secs);
+    }
+    for(size_t t = 0; t < 4; ++t) {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(thirds.begin(), thirds.end());
+        double secs = timeIt([&]() {
+            tree.difference_with(other, threadCounts[t]);
+        });
+        report("difference_with, " + to_string(threadCounts[t]) + " threads, per item", n, secs);
+    }
+    {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(sparse.begin(), sparse.end());
+        double secs = timeIt([&]() {
+            for(AVLTree<int, int>::iterator it = other.begin(); it != other.end(); ++it) {
+                tree.insert(make_pair(it->first, it->second));
+            }
+        });
+        report("insert n / 1000 items, whole merge", 1, secs);
+    }
+    {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(sparse.begin(), sparse.end());
+        double secs = timeIt([&]() {
+            tree.union_with(other);
+        });
+        report("union_with n / 1000 items, own pools", 1, secs);
+    }
+    {
+        AVLTree<int, int> tree(evens.begin(), evens.end());
+        AVLTree<int, int> other(share_pool, tree);
+        other.assign(sparse.begin(), sparse.end());
+        double secs = timeIt([&]() {
+            tree.union_with(other);
+        });
+        report("union_with n / 1000 items, shared pool", 1, secs);
+    }
+    for(size_t t = 1; t < 4; ++t) {
+        if(sizes[t] != sizes[0]) cout << "union sizes differ" << endl;
+    }
+}
+
+/**
+* Point-in-time views for readers. Copying an AVLTree is what a reader has
+* to do today; snapshot() is O(1). Writes are timed with no view alive, and
+* again with a reader taking a fresh view every 1000 writes, which makes
+* the writer copy paths. A scan of a view is timed against the same scan of
+* an AVLTree.
+*/
+void benchPersistent(size_t n)
+{
+    vector<int> keys = shuffledKeys(n);
+    AVLTree<int, int> tree;
+    double avlInsert = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            tree.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    report("AVLTree insert", n, avlInsert);
+    PersistentAVLTree<int, int> persistent;
+    double plainInsert = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            persistent.insert(make_pair(keys[i], keys[i]));
+        }
+    });
+    report("PersistentAVLTree insert, no views", n, plainInsert);
+
+    double copy = timeIt([&]() {
+        AVLTree<int, int> copied(tree.begin(), tree.end());
+    });
+    report("AVLTree copy for a reader, whole tree", 1, copy);
+    size_t snapshots = 1000;
+    double snap = timeIt([&]() {
+        for(size_t i = 0; i < snapshots; ++i) {
+            PersistentAVLTree<int, int>::snapshot_view view = persistent.snapshot();
+        }
+    });
+    report("snapshot(), whole tree", snapshots, snap);
+
+    PersistentAVLTree<int, int>::snapshot_view view;
+    double viewUpdate = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            if(i % 1000 == 0) {
+                view = persistent.snapshot();
+            }
+            persistent.insert(make_pair(keys[i], (int)i));
+        }
+    });
+    report("update, new view every 1000 writes", n, viewUpdate);
+
+    long sum = 0;
+    double avlScan = timeIt([&]() {
+        for(AVLTree<int, int>::iterator it = tree.begin(); it != tree.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report("AVLTree scan, per item", n, avlScan);
+    view = persistent.snapshot();
+    double viewScan = timeIt([&]() {
+        for(PersistentAVLTree<int, int>::iterator it = view.begin(); it != view.end(); ++it) {
+            sum += it->second;
+        }
+    });
+    report("view scan, per item", n, viewScan);
+
+    double viewRemove = timeIt([&]() {
+        for(size_t i = 0; i < keys.size(); ++i) {
+            persistent.remove(keys[i]);
+        }
+    });
+    report("remove all while a view holds them", n, viewRemove);
+    if(sum == 42 || view.size() != n || !persistent.empty()) cout << "bad persistent run" << endl;
+}
+
+/**
+* An AVLTree behind one mutex, the baseline for ConcurrentAVLMap.
+*/
+struct LockedAVLTree
+{
+    AVLTree<int, int> tree;
+    mutex lock;
+
+    bool find(int key, int& value)
+    {
+        lock_guard<mutex> guard(lock);
+        AVLTree<int, int>::iterator it = tree.find(key);
+        if(it == tree.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+    void insert(int key, int value)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.insert(make_pair(key, value));
+    }
+    void remove(int key)
+    {
+        lock_guard<mutex> guard(lock);
+        tree.remove(key);
+    }
+};
+
+/**
+* A ConcurrentAVLMap with the same interface as LockedAVLTree.
+*/
+struct SharedConcurrentMap
+{
+    ConcurrentAVLMap<int, int> map;
+
+    bool find(int key, int& value)
+    {
+        return map.find(key, value);
+    }
+    void insert(int key, int value)
+    {
+        map.insert(make_pair(key, value));
+    }
+    void remove(int key)
+    {
+        map.remove(key);
+    }
+};
+
+/**
+* Fills map with every other key in 0..2n-1, then splits n operations
+* between threads. readPercent of them are finds; the rest alternate
+* between inserting and removing, so the size stays about the same.
+* Reports the wall time per operation over all threads.
+*/
+template<typename Map>
+void concurrentRun(const string& name, size_t n, unsigned threads, unsigned readPercent)
+{
+    Map map;
+    vector<int> keys = shuffledKeys(n);
+    for(size_t i = 0; i < keys.size(); ++i) {
+        map.insert(keys[i] * 2, keys[i]);
+    }
+    vector<long> found(threads, 0);
+    size_t opsPerThread = n / threads;
+    double secs = timeIt([&]() {
+        vector<thread> workers;
+        for(unsigned t = 0; t < threads; ++t) {
+            workers.push_back(thread([&, t]() {
+                //a xorshift generator is cheap enough not to hide the map
+                unsigned state = 2463534242u + t * 7919u;
+                long hits = 0;
+                for(size_t i = 0; i < opsPerThread; ++i) {
+                    state ^= state << 13;
+                    state ^= state >> 17;
+                    state ^= state << 5;
+                    int key = (int)(state % (2 * n));
+                    int value;
+                    if(state / 7 % 100 < readPercent) {
+                        hits += map.find(key, value);
+                    }
+                    else if(i % 2 == 0) {
+                        map.insert(key, key);
+                    }
+                    else {
+                        map.remove(key);
+                    }
+                }
+                found[t] = hits;
+            }));
+        }
+        for(unsigned t = 0; t < threads; ++t) {
+            workers[t].join();
+        }
+    });
+    long hits = 0;
+    for(unsigned t = 0; t < threads; ++t) {
+        hits += found[t];
+    }
+    report(name + ", " + to_string(threads) + " threads, " + to_string(readPercent) + "% reads",
+           opsPerThread * threads, secs);
+    if(hits < 0) cout << "bad concurrent run" << endl;
+}
+
+void benchConcurrent(size_t n)
+{
+    unsigned threadCounts[] = { 1, 2, 4, 8 };
+    unsigned readPercents[] = { 100, 90, 50 };
+    for(size_t r = 0; r < 3; ++r) {
+        for(size_t t = 0; t < 4; ++t) {
+            concurrentRun<LockedAVLTree>("AVLTree + mutex", n, threadCounts[t], readPercents[r]);
+            concurrentRun<SharedConcurrentMap>("ConcurrentAVLMap", n, threadCounts[t], readPercents[r]);
+        }
+    }
+}
+
+const Section sections[] = {
+    { "alloc", benchAlloc },
+    { "find", benchFind },
+    { "scaling", benchScaling },
+    { "bulkload", benchBulkLoad },
+    { "compare", benchCompare },
+    { "upsert", benchUpsert },
+    { "hint", benchHint },
+    { "rank", benchRank },
+    { "range", benchRange },
+    { "iterate", benchIterate },
+    { "threaded", benchThreaded },
+    { "freeze", benchFreeze },
+    { "btree", benchBTree },
+    { "rbtree", benchRBTree },
+    { "splay", benchSplay },
+    { "compact", benchCompact },
+    { "parentless", benchParentless },
+    { "snapshot", benchSnapshot },
+    { "mapped", benchMapped },
+    { "batch", benchBatch },
+    { "finger", benchFinger },
+    { "split", benchSplit },
+    { "setops", benchSetOps },
+    { "persistent", benchPersistent },
+    { "concurrent", benchConcurrent },
+};
+
+int main(int argc, char *argv[])
+{
+    string which = argc > 1 ? argv[1] : "all";
+    size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    bool ran = false;
+
+    for(size_t i = 0; i < sizeof(sections) / sizeof(sections[0]); ++i) {
+        if(which == "all" || which == sections[i].name) {
+            cout << sections[i].name << " (n = " << n << ")" << endl;
+            sections[i].run(n);
+            ran = true;
+        }
+    }
+    if(!ran) {
+        cerr << "Unknown section: " << which << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -5,20 +5,37 @@
 #include <exception>
 #include <cstdlib>
 #include <utility>
+#include <type_traits>
+#include <iterator>
+#include <functional>
+#include <string>
+#include <vector>
+#include <algorithm>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#include "node_pool.h"
+#include "frozen_bst.h"
+#include "snapshot.h"
+#include "mapped_tree.h"
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * The getters for parent/left/right are not virtual, so
+ * every step of a search or traversal is an inlinable load
+ * and nodes carry no vtable pointer. Future kinds of search
+ * trees, such as Red Black trees, Splay trees, and AVL trees,
+ * derive their own node type and redeclare the getters to
+ * return it; the tree code that works on the derived type
+ * then resolves them at compile time.
  */
 template <typename Key, typename Value>
 class Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    Node(Key&& key, Value&& value, Node<Key, Value>* parent);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,14 +43,15 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
 
 protected:
     std::pair<const Key, Value> item_;
@@ -61,10 +79,24 @@ Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* par
 
 }
 
+/**
+* Constructor for a node that takes ownership of the key and value.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>::Node(Key&& key, Value&& value, Node<Key, Value>* parent) :
+    item_(std::move(key), std::move(value)),
+    parent_(parent),
+    left_(NULL),
+    right_(NULL)
+{
+
+}
+
 /**
 * Destructor, which does not need to do anything since the pointers inside of a node
 * are only used as references to existing nodes. The nodes pointed to by parent/left/right
-* are freed by the BinarySearchTree.
+* are freed by the BinarySearchTree. It is not virtual: trees destroy nodes through
+* destroyNode(), which knows the concrete node type.
 */
 template<typename Key, typename Value>
 Node<Key, Value>::~Node()
@@ -118,7 +150,7 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent of a node.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
@@ -127,7 +159,7 @@ Node<Key, Value>* Node<Key, Value>::getParent() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child of a node.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -136,7 +168,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child of a node.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -180,37 +212,159 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter for the value of a node that moves from value.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/*
+  ---------------------------------------------
+  Begin comparators and comparator traits.
+  ---------------------------------------------
+*/
+
+template<typename T>
+struct TreeVoid
+{
+    typedef void type;
+};
+
+/**
+ * True for comparators that, besides operator(), provide
+ * int compare(a, b) const returning a negative number, zero or a
+ * positive number as a is less than, equal to or greater than b.
+ * They advertise it with a nested is_three_way type, the same way
+ * transparent comparators advertise is_transparent. The trees use
+ * compare() to classify a key against a node with a single call.
+ */
+template<typename Compare, typename = void>
+struct IsThreeWayCompare : std::false_type
+{
+};
+
+template<typename Compare>
+struct IsThreeWayCompare<Compare, typename TreeVoid<typename Compare::is_three_way>::type> : std::true_type
+{
+};
+
+/**
+ * True for std::less and std::greater on arithmetic and pointer keys.
+ * Comparing those costs a single instruction, so searches classify keys
+ * three ways with two comparisons and stop at the matching node, rather
+ * than making one comparison per level all the way to a leaf.
+ */
+template<typename Compare, typename Key>
+struct IsCheapCompare : std::integral_constant<bool,
+    (std::is_arithmetic<Key>::value || std::is_pointer<Key>::value) &&
+    (std::is_same<Compare, std::less<Key> >::value || std::is_same<Compare, std::greater<Key> >::value)>
+{
+};
+
+/**
+ * A transparent three-way comparator for std::string keys. Lookups
+ * can use a C string (or a std::string_view in C++17) without
+ * building a std::string, and each node visited costs one string
+ * comparison.
+ */
+struct StringCompare
+{
+    typedef void is_transparent;
+    typedef void is_three_way;
+
+    int compare(const std::string& a, const std::string& b) const
+    {
+        return a.compare(b);
+    }
+    int compare(const std::string& a, const char* b) const
+    {
+        return a.compare(b);
+    }
+    int compare(const char* a, const std::string& b) const
+    {
+        int c = b.compare(a);
+        return c < 0 ? 1 : (c > 0 ? -1 : 0);
+    }
+#if __cplusplus >= 201703L
+    int compare(const std::string& a, std::string_view b) const
+    {
+        return a.compare(b);
+    }
+    int compare(std::string_view a, const std::string& b) const
+    {
+        return a.compare(b);
+    }
+#endif
+
+    template<typename A, typename B>
+    bool operator()(const A& a, const B& b) const
+    {
+        return compare(a, b) < 0;
+    }
+};
+
+/*
+  ---------------------------------------------
+  End comparators and comparator traits.
+  ---------------------------------------------
+*/
+
 /**
 * A templated unbalanced binary search tree.
+* Keys are ordered by Compare, a strict weak ordering like the one
+* std::map takes. If Compare defines is_transparent, find() also
+* accepts any type Compare can compare against a Key. If it defines
+* is_three_way (see IsThreeWayCompare), searches make one call to
+* Compare::compare per node; otherwise they make one call to
+* Compare::operator() per node plus one at the bottom (except for
+* the cheap comparisons described by IsCheapCompare).
 */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename Compare = std::less<Key> >
 class BinarySearchTree
 {
 public:
     BinarySearchTree(); //TODO
+    explicit BinarySearchTree(const Compare& comp);
+    template<typename InputIt>
+    BinarySearchTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
     virtual ~BinarySearchTree(); //TODO
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last, bool sorted = true);
     virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
     bool isBalanced() const; //TODO
     void print() const;
     bool empty() const;
+    std::size_t size() const;
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
 public:
+    class const_iterator;
+
     /**
     * An internal iterator class for traversing the contents of the BST.
+    * It is bidirectional: decrementing end() gives the largest item.
     */
     class iterator  // TODO
     {
     public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
         iterator();
 
         std::pair<const Key,Value>& operator*() const;
@@ -220,17 +374,145 @@ public:
         bool operator!=(const iterator& rhs) const;
 
         iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BinarySearchTree<Key, Value, Compare>;
+        friend class const_iterator;
+        iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare>* tree);
+        Node<Key, Value> *current_;
+        // The tree being walked, so that --end() can find the largest item
+        const BinarySearchTree<Key, Value, Compare>* tree_;
+    };
+
+    /**
+    * An iterator that gives read-only access to the items. An iterator
+    * converts to a const_iterator.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        const_iterator();
+        const_iterator(const iterator& it);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
 
     protected:
-        friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        friend class BinarySearchTree<Key, Value, Compare>;
+        const_iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value, Compare>* tree);
         Node<Key, Value> *current_;
+        const BinarySearchTree<Key, Value, Compare>* tree_;
+    };
+
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    /**
+    * The items with keys in [lo, hi), as returned by range(). Iterating it
+    * walks the tree in order from lo and stops at the first key not less
+    * than hi.
+    */
+    class range_view
+    {
+    public:
+        range_view(iterator first, iterator last);
+        iterator begin() const;
+        iterator end() const;
+        bool empty() const;
+
+    private:
+        iterator first_;
+        iterator last_;
+    };
+
+    /**
+    * A search cursor that starts each lookup from where the last one ended
+    * rather than from the root. It climbs the parent links only until it
+    * reaches a subtree whose key range holds the new key, then descends
+    * from there, so a lookup costs O(log d) for a key d positions away
+    * from the previous one. k lookups in sorted order cost
+    * O(k log(n/k)) together instead of O(k log n). Lookups in any order
+    * still give the right answers. Removing items or clearing the tree
+    * invalidates the finger, as it does iterators.
+    */
+    class finger
+    {
+    public:
+        explicit finger(const BinarySearchTree<Key, Value, Compare>& tree);
+        iterator find(const Key& key);
+        iterator lower_bound(const Key& key);
+
+    private:
+        const BinarySearchTree<Key, Value, Compare>* tree_;
+        // the last node visited, or NULL to start from the root
+        Node<Key, Value>* node_;
     };
 
 public:
     iterator begin() const;
     iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
+    iterator min() const;
+    iterator max() const;
     iterator find(const Key& key) const;
+    void find_batch(const std::vector<Key>& keys, std::vector<iterator>& out) const;
+    void find_sorted_batch(const std::vector<Key>& keys, std::vector<iterator>& out) const;
+
+    // Ordered searches, each one O(log n) descent
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    iterator floor(const Key& key) const;
+    iterator ceiling(const Key& key) const;
+    range_view range(const Key& lo, const Key& hi) const;
+
+    // Upserts that construct in place and report whether a node was added
+    template<typename P, typename = typename std::enable_if<
+        std::is_constructible<std::pair<Key, Value>, P&&>::value>::type>
+    std::pair<iterator, bool> insert(P&& keyValuePair);
+    template<typename P, typename = typename std::enable_if<
+        std::is_constructible<std::pair<Key, Value>, P&&>::value>::type>
+    iterator insert(iterator hint, P&& keyValuePair);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, M&& obj);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, M&& obj);
+
+    template<typename K, typename C = Compare, typename = typename C::is_transparent>
+    iterator find(const K& key) const;
+    Compare key_comp() const;
+    FrozenTree<Key, Value, Compare> freeze() const;
+    void save(const std::string& path) const;
+    void load(const std::string& path);
+    void saveMapped(const std::string& path) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
@@ -239,22 +521,83 @@ protected:
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
+    static Node<Key, Value>* successor(Node<Key, Value>* current);
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
 
+    // Lets derived trees hand out iterators to their nodes
+    iterator makeIterator(Node<Key, Value>* node) const;
+
     // Provided helper functions
-    virtual void printRoot (Node<Key, Value> *r) const;
+    void printRoot (Node<Key, Value> *r) const;
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
     void clearHelper(Node<Key, Value>* node); 
     int balanceHelper(Node<Key, Value>* node) const; 
 
+    // Key comparisons, dispatched on whether searches compare three ways
+    typedef std::integral_constant<bool, IsThreeWayCompare<Compare>::value ||
+        IsCheapCompare<Compare, Key>::value> ThreeWaySearch;
+    template<typename K>
+    int compareKeys(const K& a, const Key& b) const;
+    template<typename K>
+    int compareKeys(const K& a, const Key& b, std::true_type) const;
+    template<typename K>
+    int compareKeys(const K& a, const Key& b, std::false_type) const;
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key) const;
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key, std::true_type) const;
+    template<typename K>
+    Node<Key, Value>* findNode(const K& key, std::false_type) const;
+    Node<Key, Value>* findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft) const;
+    Node<Key, Value>* findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft, std::true_type) const;
+    Node<Key, Value>* findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft, std::false_type) const;
+    Node<Key, Value>* findHintSlot(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent, bool& isLeft) const;
+    Node<Key, Value>* lowerBoundNode(const Key& key) const;
+    Node<Key, Value>* fingerLowerBound(Node<Key, Value>*& finger, const Key& key) const;
+    void findSortedRange(Node<Key, Value>* node, const std::vector<Key>& keys, std::size_t lo, std::size_t hi, std::vector<iterator>& out) const;
+
+    // Lookups find_batch() runs side by side
+    static const std::size_t BATCH_LANES = 32;
+    Node<Key, Value>* upperBoundNode(const Key& key) const;
+
+    // Node allocation, overridden by trees that use a derived node type
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* createNode(Key&& key, Value&& value, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+
+    // Hooks a new node into the slot found by findSlot, then lets the tree rebalance
+    void linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft);
+    virtual void afterInsert(Node<Key, Value>* node);
+    virtual void afterAccess(Node<Key, Value>* node);
+    virtual void beforeRemove(Node<Key, Value>* node);
+
+    // In-order steps taken by the iterators, overridden by trees that keep links
+    virtual Node<Key, Value>* nextNode(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* prevNode(Node<Key, Value>* node) const;
+
+    // Bulk loading from sorted input
+    template<typename ForwardIt>
+    void assignSorted(ForwardIt first, std::size_t n);
+    template<typename ForwardIt>
+    Node<Key, Value>* buildSubtree(ForwardIt& it, std::size_t n, Node<Key, Value>* parent, int& height);
+    virtual void initBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    virtual void afterBuild();
 
 
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    // The nodes with the smallest and largest keys, so begin(), --end() and
+    // appends can skip the walk down a spine
+    Node<Key, Value>* leftmost_;
+    Node<Key, Value>* rightmost_;
+    // Number of nodes in the tree
+    std::size_t size_;
+    // Slab allocator that owns the memory of every node in the tree
+    NodePool pool_;
+    Compare comp_;
 };
 
 /*
@@ -266,29 +609,31 @@ Begin implementations for the BinarySearchTree::iterator class.
 /**
 * Explicit constructor that initializes an iterator with a given node pointer.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value, Compare>* tree)
 {
     // TODO
     current_ = ptr; 
+    tree_ = tree; 
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::iterator::iterator() 
 {
     // TODO
     current_ = nullptr; 
+    tree_ = nullptr; 
 }
 
 /**
 * Provides access to the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator*() const
 {
     return current_->getItem();
 }
@@ -296,9 +641,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 /**
 * Provides access to the address of the item.
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+BinarySearchTree<Key, Value, Compare>::iterator::operator->() const
 {
     return &(current_->getItem());
 }
@@ -307,10 +652,10 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * Checks if 'this' iterator's internals have the same value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
     return current_ == rhs.current_; 
@@ -320,10 +665,10 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * Checks if 'this' iterator's internals have a different value
 * as 'rhs'
 */
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value, Compare>::iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::iterator& rhs) const
 {
     // TODO
     return current_ != rhs.current_; 
@@ -334,34 +679,50 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 /**
 * Advances the iterator's location using an in-order sequencing
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator++()
 {
     // TODO
+    if (current_ != nullptr) {
+      current_ = tree_->nextNode(current_); 
+    }
+    return *this; 
+}
 
-    //if iterator reached the end
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this); 
+    ++(*this); 
+    return old; 
+}
+
+/**
+* Moves the iterator back to the previous item in order. Decrementing end()
+* moves to the largest item.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator&
+BinarySearchTree<Key, Value, Compare>::iterator::operator--()
+{
     if (current_ == nullptr) {
-      return *this; 
-    }
-    //if the current node has a right child, the next node to iterate to is the left most node of the right subtree
-    if (current_->getRight() != nullptr) {
-      current_ = current_->getRight(); 
-      //go to leftmost child
-      while (current_->getLeft() != nullptr) {
-        current_ = current_->getLeft(); 
-      }
+      current_ = tree_->rightmost_; 
     }
-    //if no right child, we go to parent that we haven't vistited yet
-    else{
-      Node<Key, Value>* parent = current_->getParent(); 
-      while (parent != nullptr && current_ == parent->getRight()) {
-        current_ = parent; 
-        parent = parent->getParent(); 
-      }
-      current_ = parent; 
+    else {
+      current_ = tree_->prevNode(current_); 
     }
-  return *this; 
+    return *this; 
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this); 
+    --(*this); 
+    return old; 
 }
 
 
@@ -372,155 +733,1092 @@ End implementations for the BinarySearchTree::iterator class.
 */
 
 /*
------------------------------------------------------
-Begin implementations for the BinarySearchTree class.
------------------------------------------------------
+-------------------------------------------------------------------
+Begin implementations for the BinarySearchTree::const_iterator class.
+-------------------------------------------------------------------
 */
 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value, Compare>* tree) :
+    current_(ptr), tree_(tree)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator() :
+    current_(nullptr), tree_(nullptr)
+{
+
+}
+
 /**
-* Default constructor for a BinarySearchTree, which sets the root to NULL.
+* Converts an iterator to a read-only iterator at the same position.
 */
-template<class Key, class Value>
-BinarySearchTree<Key, Value>::BinarySearchTree() 
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::const_iterator::const_iterator(const iterator& it) :
+    current_(it.current_), tree_(it.tree_)
 {
-    // TODO
-    root_ = nullptr; 
+
 }
 
-template<typename Key, typename Value>
-BinarySearchTree<Key, Value>::~BinarySearchTree()
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> &
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator*() const
 {
-    // TODO
-    clear(); 
+    return current_->getItem();
 }
 
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> *
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator->() const
+{
+    return &(current_->getItem());
+}
+
+template<class Key, class Value, class Compare>
+bool
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator==(
+    const BinarySearchTree<Key, Value, Compare>::const_iterator& rhs) const
+{
+    return current_ == rhs.current_; 
+}
+
+template<class Key, class Value, class Compare>
+bool
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator!=(
+    const BinarySearchTree<Key, Value, Compare>::const_iterator& rhs) const
+{
+    return current_ != rhs.current_; 
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator&
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator++()
+{
+    if (current_ != nullptr) {
+      current_ = tree_->nextNode(current_); 
+    }
+    return *this; 
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old(*this); 
+    ++(*this); 
+    return old; 
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator&
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator--()
+{
+    if (current_ == nullptr) {
+      current_ = tree_->rightmost_; 
+    }
+    else {
+      current_ = tree_->prevNode(current_); 
+    }
+    return *this; 
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old(*this); 
+    --(*this); 
+    return old; 
+}
+
+/*
+-----------------------------------------------------------------
+End implementations for the BinarySearchTree::const_iterator class.
+-----------------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------------------
+Begin implementations for the BinarySearchTree::range_view class.
+-----------------------------------------------------------------
+*/
+
 /**
- * Returns true if tree is empty
+* Makes a view of the items from first up to (but not including) last.
 */
-template<class Key, class Value>
-bool BinarySearchTree<Key, Value>::empty() const
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::range_view::range_view(iterator first, iterator last) :
+    first_(first), last_(last)
 {
-    return root_ == NULL;
+
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::print() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::range_view::begin() const
 {
-    printRoot(root_);
-    std::cout << "\n";
+    return first_;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::range_view::end() const
+{
+    return last_;
+}
+
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::range_view::empty() const
+{
+    return first_ == last_;
 }
 
+/*
+---------------------------------------------------------------
+End implementations for the BinarySearchTree::range_view class.
+---------------------------------------------------------------
+*/
+
+/*
+-------------------------------------------------------------
+Begin implementations for the BinarySearchTree::finger class.
+-------------------------------------------------------------
+*/
+
 /**
-* Returns an iterator to the "smallest" item in the tree
+* Makes a finger on tree. The first lookup starts from the root.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::begin() const
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::finger::finger(const BinarySearchTree<Key, Value, Compare>& tree) :
+    tree_(&tree), node_(NULL)
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
-    return begin;
+
 }
 
 /**
-* Returns an iterator whose value means INVALID
+* Returns an iterator to the item with the given key, or end() if there is
+* none, and moves the finger next to it.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::end() const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::finger::find(const Key& key)
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
-    return end;
+    Node<Key, Value>* node = tree_->fingerLowerBound(node_, key);
+    if (node != NULL && tree_->comp_(key, node->getKey())) {
+        node = NULL;
+    }
+    return iterator(node, tree_);
 }
 
 /**
-* Returns an iterator to the item with the given key, k
-* or the end iterator if k does not exist in the tree
+* Returns an iterator to the first item whose key is not less than key, or
+* end() if there is none, and moves the finger next to it.
 */
-template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator
-BinarySearchTree<Key, Value>::find(const Key & k) const
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::finger::lower_bound(const Key& key)
 {
-    Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
-    return it;
+    return iterator(tree_->fingerLowerBound(node_, key), tree_);
 }
 
+/*
+-----------------------------------------------------------
+End implementations for the BinarySearchTree::finger class.
+-----------------------------------------------------------
+*/
+
+/*
+-----------------------------------------------------
+Begin implementations for the BinarySearchTree class.
+-----------------------------------------------------
+*/
+
 /**
- * @precondition The key exists in the map
- * Returns the value associated with the key
- */
-template<class Key, class Value>
-Value& BinarySearchTree<Key, Value>::operator[](const Key& key)
+* Default constructor for a BinarySearchTree, which sets the root to NULL.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree() 
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+    // TODO
+    root_ = nullptr; 
+    leftmost_ = nullptr; 
+    rightmost_ = nullptr; 
+    size_ = 0; 
 }
-template<class Key, class Value>
-Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
+
+/**
+* Constructor for an empty BinarySearchTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(const Compare& comp) :
+    root_(nullptr), leftmost_(nullptr), rightmost_(nullptr), size_(0), comp_(comp)
 {
-    Node<Key, Value> *curr = internalFind(key);
-    if(curr == NULL) throw std::out_of_range("Invalid key");
-    return curr->getValue();
+
 }
 
 /**
-* An insert method to insert into a Binary Search Tree.
-* The tree will not remain balanced when inserting.
-* Recall: If key is already in the tree, you should 
-* overwrite the current value with the updated value.
+* Constructs a balanced tree from the key/value pairs in [first, last).
+* See assign().
 */
-template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+BinarySearchTree<Key, Value, Compare>::BinarySearchTree(InputIt first, InputIt last, bool sorted, const Compare& comp) :
+    root_(nullptr), leftmost_(nullptr), rightmost_(nullptr), size_(0), comp_(comp)
+{
+    assign(first, last, sorted);
+}
+
+template<typename Key, typename Value, typename Compare>
+BinarySearchTree<Key, Value, Compare>::~BinarySearchTree()
 {
     // TODO
-    //what to do if our tree is empty?
-      //create new root for a new tree
-    //begin traversal at the root and keep traversing until you reach NULL
-      //compare keys of your current node and the node you are trying to insert
-        //go into left subtree if new node's key is < parent
-        //go into right subtree if new node's key is > parent
-        //if keys are the same, update the value
-    //when you end your traversal, you have found the location to insert your new node
-      //dynamically create a new node and correctly set the node's parent pointer
-      //don't forget to update the parent node's left and right child pointers
+    clear(); 
+}
 
-    //if tree is empty, create new root for a new tree
-    if (root_ == nullptr) {
-      root_ = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
+/**
+* Replaces the contents of the tree with the key/value pairs in [first, last)
+* and builds a perfectly balanced tree from them in linear time.
+*
+* If sorted is true the keys must already be in strictly increasing order.
+* Otherwise the pairs are copied and sorted first (O(n log n)), and when a key
+* appears more than once the last pair wins, just like repeated inserts.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+void BinarySearchTree<Key, Value, Compare>::assign(InputIt first, InputIt last, bool sorted)
+{
+    typedef typename std::iterator_traits<InputIt>::iterator_category Category;
+    clear(); 
+
+    //a forward range that is already sorted can be built straight from the iterators
+    if (sorted && !std::is_same<Category, std::input_iterator_tag>::value) {
+      assignSorted(first, (std::size_t)std::distance(first, last)); 
       return; 
     }
 
-    //if not empty, traverse the tree to find where to insert the new node
-    Node<Key, Value>* current = root_; 
-    //need parent node to see where to insert later
-    Node<Key, Value>* parent = nullptr; 
-    //start the traversal that ends until you find a location
-    while (current != nullptr) {
-      parent = current;
-      //if new node's key is less than current key, then go left subtree
-      if (keyValuePair.first < current->getKey()) {
-        current = current->getLeft(); 
+    //otherwise buffer the pairs so they can be counted (and sorted if asked)
+    std::vector<std::pair<Key, Value> > items(first, last); 
+    if (!sorted) {
+      std::stable_sort(items.begin(), items.end(),
+        [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return comp_(a.first, b.first); }); 
+      //drop duplicate keys, keeping the value that came last
+      std::size_t kept = 0; 
+      for (std::size_t i = 0; i < items.size(); ++i) {
+        if (kept > 0 && !comp_(items[kept - 1].first, items[i].first)) {
+          items[kept - 1].second = items[i].second; 
+        }
+        else {
+          if (kept != i) {
+            items[kept] = std::move(items[i]); 
+          }
+          ++kept; 
+        }
       }
-      //if new node's key is greater than current key, then go to right subtree
-      else if (keyValuePair.first > current->getKey()){
+      items.erase(items.begin() + kept, items.end()); 
+    }
+    assignSorted(items.begin(), items.size()); 
+}
+
+/**
+* Builds the tree from n sorted pairs starting at first. The tree must be empty.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+void BinarySearchTree<Key, Value, Compare>::assignSorted(ForwardIt first, std::size_t n)
+{
+    int height = 0; 
+    root_ = buildSubtree(first, n, nullptr, height); 
+    size_ = n; 
+    leftmost_ = getSmallestNode(); 
+    rightmost_ = root_; 
+    while (rightmost_ != nullptr && rightmost_->getRight() != nullptr) {
+      rightmost_ = rightmost_->getRight(); 
+    }
+    afterBuild(); 
+}
+
+/**
+* Builds a balanced subtree from the next n pairs of an in-order sequence and
+* advances it past them. The middle pair becomes the root, so the two halves
+* differ in size by at most one and every node comes out balanced. Nodes are
+* created in key order, which also keeps neighbours close together in the pool.
+* Returns the root of the subtree and its height through height. If making a
+* node throws, the nodes already made for the subtree are destroyed.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::buildSubtree(ForwardIt& it, std::size_t n, Node<Key, Value>* parent, int& height)
+{
+    if (n == 0) {
+      height = 0; 
+      return nullptr; 
+    }
+    //the left half comes first in order, so build it before the root
+    int leftHeight = 0; 
+    int rightHeight = 0; 
+    Node<Key, Value>* left = buildSubtree(it, n / 2, nullptr, leftHeight); 
+
+    Node<Key, Value>* node = nullptr; 
+    try {
+      node = createNode(it->first, it->second, nullptr); 
+    }
+    catch (...) {
+      clearHelper(left); 
+      throw; 
+    }
+    ++it; 
+    node->setLeft(left); 
+    if (left != nullptr) {
+      left->setParent(node); 
+    }
+
+    try {
+      node->setRight(buildSubtree(it, n - n / 2 - 1, node, rightHeight)); 
+    }
+    catch (...) {
+      clearHelper(node); 
+      throw; 
+    }
+    node->setParent(parent); 
+    initBuiltNode(node, leftHeight, rightHeight); 
+    height = 1 + std::max(leftHeight, rightHeight); 
+    return node; 
+}
+
+/**
+* Called for each node made by buildSubtree() once both of its subtrees exist,
+* with their heights. A plain BST keeps no balance information, so there is
+* nothing to do.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::initBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+
+}
+
+/**
+* Called once assignSorted() has built the whole tree, for balance schemes
+* that cannot be decided one subtree at a time.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::afterBuild()
+{
+
+}
+
+/**
+ * Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare>
+bool BinarySearchTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+ * Returns the number of items in the tree
+*/
+template<class Key, class Value, class Compare>
+std::size_t BinarySearchTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::print() const
+{
+    printRoot(root_);
+    std::cout << "\n";
+}
+
+/**
+* Returns an iterator to the "smallest" item in the tree
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::begin() const
+{
+    BinarySearchTree<Key, Value, Compare>::iterator begin(leftmost_, this);
+    return begin;
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::end() const
+{
+    BinarySearchTree<Key, Value, Compare>::iterator end(NULL, this);
+    return end;
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::cbegin() const
+{
+    return const_iterator(leftmost_, this);
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_iterator
+BinarySearchTree<Key, Value, Compare>::cend() const
+{
+    return const_iterator(NULL, this);
+}
+
+/**
+* Returns a reverse iterator to the largest item. Reverse iteration visits
+* the items from largest to smallest.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rbegin() const
+{
+    return reverse_iterator(end());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::reverse_iterator
+BinarySearchTree<Key, Value, Compare>::rend() const
+{
+    return reverse_iterator(begin());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare>::crbegin() const
+{
+    return const_reverse_iterator(cend());
+}
+
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::const_reverse_iterator
+BinarySearchTree<Key, Value, Compare>::crend() const
+{
+    return const_reverse_iterator(cbegin());
+}
+
+/**
+* Returns an iterator to the item with the smallest key, or end() if the
+* tree is empty. Same as begin().
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::min() const
+{
+    return iterator(leftmost_, this);
+}
+
+/**
+* Returns an iterator to the item with the largest key, or end() if the
+* tree is empty.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::max() const
+{
+    return iterator(rightmost_, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const Key & k) const
+{
+    Node<Key, Value> *curr = internalFind(k);
+    BinarySearchTree<Key, Value, Compare>::iterator it(curr, this);
+    return it;
+}
+
+/**
+* Looks up every key in keys, setting out[i] to find(keys[i]).
+*
+* A lone find() waits for each node it visits to arrive from memory before
+* it can pick the next one, so on a tree bigger than the cache it spends
+* most of its time stalled. Here up to BATCH_LANES lookups descend in
+* turns: each takes one step, prefetches the child it is going to next and
+* lets the others step, so the loads of many lookups are in flight at once
+* and the child has usually arrived by the time its lookup comes back
+* round. The answers are the same as calling find() on each key.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::find_batch(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    out.assign(keys.size(), end()); 
+    for (std::size_t first = 0; first < keys.size(); first += BATCH_LANES) {
+      std::size_t lanes = keys.size() - first; 
+      if (lanes > BATCH_LANES) {
+        lanes = BATCH_LANES; 
+      }
+      Node<Key, Value>* current[BATCH_LANES]; 
+      //the lanes still descending, kept at the front
+      std::size_t active[BATCH_LANES]; 
+      for (std::size_t i = 0; i < lanes; ++i) {
+        current[i] = root_; 
+        active[i] = i; 
+      }
+      std::size_t pending = lanes; 
+      while (pending > 0) {
+        for (std::size_t j = 0; j < pending; ) {
+          std::size_t lane = active[j]; 
+          Node<Key, Value>* node = current[lane]; 
+          int c = node == nullptr ? 0 : compareKeys(keys[first + lane], node->getKey()); 
+          if (c == 0) {
+            if (node != nullptr) {
+              out[first + lane] = iterator(node, this); 
+            }
+            active[j] = active[--pending]; 
+            continue; 
+          }
+          node = c < 0 ? node->getLeft() : node->getRight(); 
+#if defined(__GNUC__)
+          __builtin_prefetch(node); 
+#endif
+          current[lane] = node; 
+          ++j; 
+        }
+      }
+    }
+}
+
+/**
+* Looks up every key in keys, setting out[i] to find(keys[i]). The keys
+* should be in ascending order (repeats are fine). The whole batch then
+* descends the tree together: at each node the keys are split into those
+* that go left, those equal to the node and those that go right, so every
+* node on the union of the k search paths is visited once, O(k log(n/k))
+* nodes, and the top of the tree once per batch rather than once per key.
+* Keys in any other order are looked up one by one through a finger,
+* with the same answers.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::find_sorted_batch(const std::vector<Key>& keys, std::vector<iterator>& out) const
+{
+    out.assign(keys.size(), end()); 
+    if (std::is_sorted(keys.begin(), keys.end(), comp_)) {
+      findSortedRange(root_, keys, 0, keys.size(), out); 
+      return; 
+    }
+    finger cursor(*this); 
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      out[i] = cursor.find(keys[i]); 
+    }
+}
+
+/**
+* Heterogeneous version of find, available when Compare is transparent.
+* Looks up any k that Compare can compare against a Key without
+* converting it to a Key first.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename C, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::find(const K & k) const
+{
+    BinarySearchTree<Key, Value, Compare>::iterator it(findNode(k), this);
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return iterator(lowerBoundNode(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return iterator(upperBoundNode(key), this);
+}
+
+/**
+* Returns the range of items with a key equivalent to key: empty if key is
+* not in the tree, otherwise just that item. Only one descent is made, since
+* keys are unique and upper_bound is then the in-order successor.
+*/
+template<class Key, class Value, class Compare>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator,
+          typename BinarySearchTree<Key, Value, Compare>::iterator>
+BinarySearchTree<Key, Value, Compare>::equal_range(const Key& key) const
+{
+    iterator first(lowerBoundNode(key), this);
+    iterator last(first);
+    if (first != end() && !comp_(key, first->first)) {
+      ++last; 
+    }
+    return std::make_pair(first, last);
+}
+
+/**
+* Returns an iterator to the item with the largest key not greater than key,
+* or end() if every key is greater.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::floor(const Key& key) const
+{
+    Node<Key, Value>* current = root_; 
+    Node<Key, Value>* candidate = nullptr; 
+    while (current != nullptr) {
+      //a key <= the target is a candidate, and larger ones are to its right
+      if (!comp_(key, current->getKey())) {
+        candidate = current; 
         current = current->getRight(); 
       }
-      //if new node's key is equal to current key, we've found the location 
       else {
-        current->setValue(keyValuePair.second);
-        return; 
+        current = current->getLeft(); 
+      }
+    }
+    return iterator(candidate, this);
+}
+
+/**
+* Returns an iterator to the item with the smallest key not less than key,
+* or end() if every key is smaller. The same as lower_bound.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::ceiling(const Key& key) const
+{
+    return iterator(lowerBoundNode(key), this);
+}
+
+/**
+* Returns a view of the items with keys in [lo, hi), for use in a range-based
+* for loop. Finding the bounds costs two descents and iterating the k items
+* in the range costs O(k) more.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::range_view
+BinarySearchTree<Key, Value, Compare>::range(const Key& lo, const Key& hi) const
+{
+    if (!comp_(lo, hi)) {
+      return range_view(end(), end());
+    }
+    return range_view(iterator(lowerBoundNode(lo), this), iterator(lowerBoundNode(hi), this));
+}
+
+/**
+* Wraps a node in an iterator. The iterator constructor is only open to
+* BinarySearchTree, so derived trees go through here.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::makeIterator(Node<Key, Value>* node) const
+{
+    return iterator(node, this);
+}
+
+/**
+* Returns an immutable copy of the tree laid out for fast lookups. Later
+* changes to the tree do not show up in the copy. See FrozenTree.
+*/
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare> BinarySearchTree<Key, Value, Compare>::freeze() const
+{
+    return FrozenTree<Key, Value, Compare>(begin(), end(), comp_);
+}
+
+/**
+* Writes the tree to a binary snapshot file at path: a SnapshotHeader and
+* then every item in key order, encoded by SnapshotSerializer. Throws
+* std::runtime_error if the file cannot be written.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::save(const std::string& path) const
+{
+    SnapshotWriter out(path); 
+    SnapshotHeader header; 
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)); 
+    header.keyBytes = sizeof(Key); 
+    header.valueBytes = sizeof(Value); 
+    header.count = size_; 
+    out.write(&header, sizeof(header)); 
+    for (Node<Key, Value>* node = leftmost_; node != nullptr; node = nextNode(node)) {
+      SnapshotSerializer<Key>::write(out, node->getKey()); 
+      SnapshotSerializer<Value>::write(out, node->getValue()); 
+    }
+    out.close(); 
+}
+
+/**
+* Replaces the contents of the tree with a snapshot written by save(). The
+* items are already in key order, so the tree is built bottom-up in O(n)
+* with no comparisons or rotations, as assign() does for sorted input.
+* Throws std::runtime_error if the file cannot be read, is not a snapshot of
+* a tree with these key and value types, or is cut short or corrupt, and
+* leaves the tree as it was.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::load(const std::string& path)
+{
+    SnapshotReader in(path); 
+    SnapshotHeader header; 
+    in.read(&header, sizeof(header)); 
+    if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+        header.keyBytes != sizeof(Key) || header.valueBytes != sizeof(Value)) {
+      throw std::runtime_error(path + " is not a snapshot of this kind of tree"); 
+    }
+
+    //with fixed-size items a short file shows up in its size, so the tree
+    //can be built straight from the file without a failure halfway through
+    const std::uint64_t itemBytes = SnapshotSerializer<Key>::FIXED_BYTES + SnapshotSerializer<Value>::FIXED_BYTES; 
+    if (SnapshotSerializer<Key>::FIXED_BYTES != 0 && SnapshotSerializer<Value>::FIXED_BYTES != 0) {
+      //divide rather than multiply, since a corrupt count can overflow
+      const std::uint64_t itemsBytes = in.fileSize() - sizeof(header); 
+      if (header.count != itemsBytes / itemBytes || itemsBytes % itemBytes != 0) {
+        throw std::runtime_error("Snapshot is truncated"); 
       }
+      clear(); 
+      assignSorted(SnapshotItemReader<Key, Value>(in, header.count), (std::size_t)header.count); 
+      return; 
+    }
+
+    //otherwise decode everything first, so a bad file leaves the tree alone
+    std::vector<std::pair<Key, Value> > items; 
+    items.reserve((std::size_t)std::min<std::uint64_t>(header.count, in.fileSize())); 
+    for (std::uint64_t i = 0; i < header.count; ++i) {
+      Key key = SnapshotSerializer<Key>::read(in); 
+      items.push_back(std::pair<Key, Value>(std::move(key), SnapshotSerializer<Value>::read(in))); 
+    }
+    clear(); 
+    assignSorted(items.begin(), items.size()); 
+}
+
+/**
+* Writes the tree to a file that MappedTreeView can open and search in
+* place, with no loading step. Keys and values must be trivially copyable.
+* The new file replaces any old one at path in a single rename, so views
+* already open on the old file are not disturbed. Throws
+* std::runtime_error if the file cannot be written.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::saveMapped(const std::string& path) const
+{
+  MappedTreeView<Key, Value, Compare>::write(begin(), size_, path); 
+}
+
+/**
+* Returns a copy of the comparator that orders the keys.
+*/
+template<class Key, class Value, class Compare>
+Compare BinarySearchTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value& BinarySearchTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+template<class Key, class Value, class Compare>
+Value const & BinarySearchTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    Node<Key, Value> *curr = internalFind(key);
+    if(curr == NULL) throw std::out_of_range("Invalid key");
+    return curr->getValue();
+}
+
+/**
+* An insert method to insert into a Binary Search Tree.
+* The tree will not remain balanced when inserting.
+* Recall: If key is already in the tree, you should 
+* overwrite the current value with the updated value.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::insert(const std::pair<const Key, Value> &keyValuePair)
+{
+    // TODO
+    //what to do if our tree is empty?
+      //create new root for a new tree
+    //begin traversal at the root and keep traversing until you reach NULL
+      //compare keys of your current node and the node you are trying to insert
+        //go into left subtree if new node's key is < parent
+        //go into right subtree if new node's key is > parent
+        //if keys are the same, update the value
+    //when you end your traversal, you have found the location to insert your new node
+      //dynamically create a new node and correctly set the node's parent pointer
+      //don't forget to update the parent node's left and right child pointers
+
+    //traverse the tree to find where to insert the new node
+    //(an empty tree leaves parent as nullptr, which makes the new node the root)
+    //need parent node to see where to insert later
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(keyValuePair.first, parent, isLeft); 
+    //if new node's key is equal to an existing key, just update the value
+    if (existing != nullptr) {
+      existing->setValue(keyValuePair.second);
+      afterAccess(existing); 
+      return; 
     }
     //after finding the location to insert in the tree, we dynamically create a new node
-    Node<Key, Value>* newNode = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, parent);
+    linkNode(createNode(keyValuePair.first, keyValuePair.second, parent), parent, isLeft); 
+}
+
+/**
+* Inserts anything a pair can be built from, such as an rvalue pair, moving
+* the key and value into the new node. Like the const& insert, an existing key
+* has its value overwritten (by move). Returns an iterator to the item and
+* whether a new node was created.
+*/
+template<class Key, class Value, class Compare>
+template<typename P, typename>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert(P&& keyValuePair)
+{
+    std::pair<Key, Value> item(std::forward<P>(keyValuePair)); 
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(item.first, parent, isLeft); 
+    if (existing != nullptr) {
+      existing->setValue(std::move(item.second)); 
+      afterAccess(existing); 
+      return std::make_pair(iterator(existing, this), false); 
+    }
+    Node<Key, Value>* newNode = createNode(std::move(item.first), std::move(item.second), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return std::make_pair(iterator(newNode, this), true); 
+}
+
+/**
+* Inserts a pair using hint, an iterator to an item that is expected to be
+* next to the new key, to find the slot. When the key belongs right before or
+* right after the hint (or after the largest key when hint is end()), the node
+* is linked there without descending from the root, so sorted and nearly
+* sorted streams cost amortized O(1) per insert plus any rebalancing. A bad
+* hint only costs an ordinary insert. As with insert, an existing key has its
+* value overwritten. Returns an iterator to the item, which makes a good hint
+* for the next key of an increasing stream.
+*/
+template<class Key, class Value, class Compare>
+template<typename P, typename>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+BinarySearchTree<Key, Value, Compare>::insert(iterator hint, P&& keyValuePair)
+{
+    std::pair<Key, Value> item(std::forward<P>(keyValuePair)); 
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findHintSlot(hint.current_, item.first, parent, isLeft); 
+    if (existing != nullptr) {
+      existing->setValue(std::move(item.second)); 
+      afterAccess(existing); 
+      return iterator(existing, this); 
+    }
+    Node<Key, Value>* newNode = createNode(std::move(item.first), std::move(item.second), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return iterator(newNode, this); 
+}
+
+/**
+* Builds a pair from args and inserts it if its key is not in the tree yet.
+* An existing item is left alone. Returns an iterator to the item with that
+* key and whether the new pair was inserted.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::emplace(Args&&... args)
+{
+    std::pair<Key, Value> item(std::forward<Args>(args)...); 
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(item.first, parent, isLeft); 
+    if (existing != nullptr) {
+      afterAccess(existing); 
+      return std::make_pair(iterator(existing, this), false); 
+    }
+    Node<Key, Value>* newNode = createNode(std::move(item.first), std::move(item.second), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return std::make_pair(iterator(newNode, this), true); 
+}
+
+/**
+* If key is not in the tree, inserts it with a value constructed from args.
+* Otherwise does nothing, and in particular does not construct a value or
+* touch args. Returns an iterator to the item and whether it was inserted.
+*/
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(const Key& key, Args&&... args)
+{
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(key, parent, isLeft); 
+    if (existing != nullptr) {
+      afterAccess(existing); 
+      return std::make_pair(iterator(existing, this), false); 
+    }
+    Node<Key, Value>* newNode = createNode(Key(key), Value(std::forward<Args>(args)...), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return std::make_pair(iterator(newNode, this), true); 
+}
+
+template<class Key, class Value, class Compare>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::try_emplace(Key&& key, Args&&... args)
+{
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(key, parent, isLeft); 
+    if (existing != nullptr) {
+      afterAccess(existing); 
+      return std::make_pair(iterator(existing, this), false); 
+    }
+    Node<Key, Value>* newNode = createNode(std::move(key), Value(std::forward<Args>(args)...), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return std::make_pair(iterator(newNode, this), true); 
+}
+
+/**
+* Assigns obj to the value of key, inserting key first if it is missing.
+* Returns an iterator to the item and whether it was inserted.
+*/
+template<class Key, class Value, class Compare>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(const Key& key, M&& obj)
+{
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(key, parent, isLeft); 
+    if (existing != nullptr) {
+      existing->getValue() = std::forward<M>(obj); 
+      afterAccess(existing); 
+      return std::make_pair(iterator(existing, this), false); 
+    }
+    Node<Key, Value>* newNode = createNode(Key(key), Value(std::forward<M>(obj)), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return std::make_pair(iterator(newNode, this), true); 
+}
+
+template<class Key, class Value, class Compare>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value, Compare>::iterator, bool>
+BinarySearchTree<Key, Value, Compare>::insert_or_assign(Key&& key, M&& obj)
+{
+    Node<Key, Value>* parent = nullptr; 
+    bool isLeft = false; 
+    Node<Key, Value>* existing = findSlot(key, parent, isLeft); 
+    if (existing != nullptr) {
+      existing->getValue() = std::forward<M>(obj); 
+      afterAccess(existing); 
+      return std::make_pair(iterator(existing, this), false); 
+    }
+    Node<Key, Value>* newNode = createNode(std::move(key), Value(std::forward<M>(obj)), parent); 
+    linkNode(newNode, parent, isLeft); 
+    return std::make_pair(iterator(newNode, this), true); 
+}
+
+/**
+* Makes node the child of parent on the side given by isLeft (or the root when
+* parent is NULL) and then calls afterInsert so the tree can rebalance.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool isLeft)
+{
     //determine whether on parent node's left side or right side
-    if (keyValuePair.first < parent->getKey()) {
-      parent->setLeft(newNode); 
+    if (parent == nullptr) {
+      root_ = node; 
+      leftmost_ = node; 
+      rightmost_ = node; 
+    }
+    else if (isLeft) {
+      parent->setLeft(node); 
+      //likewise a left child of the smallest node is the new smallest node
+      if (parent == leftmost_) {
+        leftmost_ = node; 
+      }
     }
     else {
-      parent->setRight(newNode); 
+      parent->setRight(node); 
+      //a right child of the largest node is the new largest node
+      if (parent == rightmost_) {
+        rightmost_ = node; 
+      }
+    }
+    ++size_; 
+    afterInsert(node); 
+}
+
+/**
+* Called after a new node is linked into the tree. An unbalanced tree
+* has nothing to fix.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+
+}
+
+/**
+* Called when an insert finds its key already in the tree, after any update
+* to the value. Trees that keep no access history have nothing to do.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::afterAccess(Node<Key, Value>* node)
+{
+
+}
+
+/**
+* Called by remove() with the node holding the key, before it is swapped or
+* unlinked, while its neighbours in key order can still be found.
+*/
+template<class Key, class Value, class Compare>
+void BinarySearchTree<Key, Value, Compare>::beforeRemove(Node<Key, Value>* node)
+{
+    //the smallest and largest nodes have at most one child, so they are
+    //unlinked where they are and their neighbours take over the caches
+    if (node == leftmost_) {
+      leftmost_ = nextNode(node); 
     }
+    if (node == rightmost_) {
+      rightmost_ = prevNode(node); 
+    }
+}
+
+/**
+* Returns the node after node in key order, or NULL after the largest.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::nextNode(Node<Key, Value>* node) const
+{
+    return successor(node); 
+}
+
+/**
+* Returns the node before node in key order, or NULL before the smallest.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::prevNode(Node<Key, Value>* node) const
+{
+    return predecessor(node); 
 }
 
 
@@ -529,8 +1827,8 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 * Recall: The writeup specifies that if a node has 2 children you
 * should swap with the predecessor and then remove.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::remove(const Key& key)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::remove(const Key& key)
 {
     // TODO
     //Find the node with the given key using internalFind
@@ -588,6 +1886,7 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     if (nodeToDelete == nullptr) {
       return; 
     }
+    beforeRemove(nodeToDelete); 
 
     //2 child case
     if (nodeToDelete->getLeft() != nullptr && nodeToDelete->getRight() != nullptr) {
@@ -654,14 +1953,15 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
       }
     }
     //after making sure all pointers are pointing in correct place, delete the node
-    delete nodeToDelete; 
+    destroyNode(nodeToDelete); 
+    --size_; 
 }
 
 
 
-template<class Key, class Value>
+template<class Key, class Value, class Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
+BinarySearchTree<Key, Value, Compare>::predecessor(Node<Key, Value>* current)
 {
     // TODO
     //Case 1: If there is a left child 
@@ -686,58 +1986,141 @@ BinarySearchTree<Key, Value>::predecessor(Node<Key, Value>* current)
       }
 
       //case 2: if there is no left child the pred is up in the tree
-      if (current->getLeft() == nullptr) {
-        //traverse the parent chain until we find a right child pointer
-        Node<Key, Value>* parent = current; 
-        while (parent != nullptr && current == parent->getLeft()) {
-          //move to the parent
-          current = parent;
-          //update parent to the grandparent 
-          parent = parent->getParent(); 
-        }
-        //the parent node is the predecessor
-        return parent; 
+      //traverse the parent chain until we find a right child pointer
+      Node<Key, Value>* parent = current->getParent(); 
+      while (parent != nullptr && current == parent->getLeft()) {
+        //move to the parent
+        current = parent;
+        //update parent to the grandparent 
+        parent = parent->getParent(); 
       }
+      //the parent node is the predecessor
+      return parent; 
 }
 
 
+/**
+* Returns the node that follows current in key order, or NULL if current is
+* the largest node.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>*
+BinarySearchTree<Key, Value, Compare>::successor(Node<Key, Value>* current)
+{
+    //if iterator reached the end
+    if (current == nullptr) {
+      return nullptr; 
+    }
+    //if the current node has a right child, the next node to iterate to is the left most node of the right subtree
+    if (current->getRight() != nullptr) {
+      current = current->getRight(); 
+      //go to leftmost child
+      while (current->getLeft() != nullptr) {
+        current = current->getLeft(); 
+      }
+      return current; 
+    }
+    //if no right child, we go to parent that we haven't vistited yet
+    Node<Key, Value>* parent = current->getParent(); 
+    while (parent != nullptr && current == parent->getRight()) {
+      current = parent; 
+      parent = parent->getParent(); 
+    }
+    return parent; 
+}
+
 /**
 * A method to remove all contents of the tree and
 * reset the values in the tree for use again.
 */
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clear()
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clear()
 {
     // TODO
     //need to use this->root to use root, can't use root_ because no arguments passed
     //remove all nodes in the tree
       //since the children nodes need their parent pointers, we will delete the children before deleting the parent
       //Update the root node
-    clearHelper(this->root_); 
+    //if the items have no destructor to run, every node can be dropped at once by
+    //handing the slabs back to the pool instead of visiting each node, unless
+    //the pool shares its slabs with another tree
+    if (!std::is_trivially_destructible<std::pair<const Key, Value> >::value || pool_.shared()) {
+      clearHelper(this->root_); 
+    }
+    pool_.release(); 
     this->root_ = nullptr; 
+    this->leftmost_ = nullptr; 
+    this->rightmost_ = nullptr; 
+    this->size_ = 0; 
 
 }
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::clearHelper(Node<Key, Value>* node) {
-    //if empty already
-    if (node == nullptr){
-      return; 
+/**
+* Destroys every node under node, children before parents. The walk follows
+* parent pointers instead of recursing, so a tall tree (a splay tree can be a
+* single path) cannot run out of stack.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::clearHelper(Node<Key, Value>* node) {
+    while (node != nullptr) {
+      //traverse to the end of the left subtree, then the right, and start deleting
+      if (node->getLeft() != nullptr) {
+        node = node->getLeft(); 
+      }
+      else if (node->getRight() != nullptr) {
+        node = node->getRight(); 
+      }
+      else {
+        //detach the leaf from its parent so the parent becomes a leaf in turn
+        Node<Key, Value>* parent = node->getParent(); 
+        if (parent != nullptr) {
+          if (parent->getLeft() == node) {
+            parent->setLeft(nullptr); 
+          }
+          else {
+            parent->setRight(nullptr); 
+          }
+        }
+        destroyNode(node); 
+        node = parent; 
+      }
     }
-    //traverse to end of left subtree and start deleting
-    clearHelper(node->getLeft()); 
-    //traverse to end of right subtre and start deleting
-    clearHelper(node->getRight());
+}
+
+/**
+* Allocates a node from the pool. Derived trees override this to
+* create their own node type.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return pool_.template create<Node<Key, Value> >(key, value, parent);
+}
+
+/**
+* Allocates a node from the pool, moving the key and value into it.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::createNode(Key&& key, Value&& value, Node<Key, Value>* parent)
+{
+    return pool_.template create<Node<Key, Value> >(std::move(key), std::move(value), parent);
+}
 
-    delete node; 
+/**
+* Destroys a node and returns its memory to the pool.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    pool_.destroy(node);
 }
 
 /**
 * A helper function to find the smallest node in the tree.
 */
-template<typename Key, typename Value>
+template<typename Key, typename Value, typename Compare>
 Node<Key, Value>*
-BinarySearchTree<Key, Value>::getSmallestNode() const
+BinarySearchTree<Key, Value, Compare>::getSmallestNode() const
 {
     // TODO
     //Returns a pointer to the node with the smallest key, which is on the very left
@@ -757,41 +2140,376 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
 * return a pointer to it or NULL if no item with that key
 * exists
 */
-template<typename Key, typename Value>
-Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::internalFind(const Key& key) const
 {
     // TODO
     //start at root
     //compare keys and choose between right and left subtrees based on the key
     //return the node if keys match
     //return nullptr if node is not found after reaching bottom of tree
+    return findNode(key); 
+}
+
+/**
+* Finds the node whose key is equivalent to key, or returns NULL.
+* Picks the descent that suits Compare.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findNode(const K& key) const
+{
+    return findNode(key, ThreeWaySearch());
+}
+
+/**
+* Returns a negative number, zero or a positive number as a is
+* less than, equivalent to or greater than b.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+int BinarySearchTree<Key, Value, Compare>::compareKeys(const K& a, const Key& b) const
+{
+    return compareKeys(a, b, IsThreeWayCompare<Compare>());
+}
+
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+int BinarySearchTree<Key, Value, Compare>::compareKeys(const K& a, const Key& b, std::true_type) const
+{
+    return comp_.compare(a, b);
+}
 
-    //start at the root
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+int BinarySearchTree<Key, Value, Compare>::compareKeys(const K& a, const Key& b, std::false_type) const
+{
+    if (comp_(a, b)) {
+      return -1; 
+    }
+    return comp_(b, a) ? 1 : 0; 
+}
+
+/**
+* Three-way descent: classifies the key against each node, stopping
+* as soon as it is found.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findNode(const K& key, std::true_type) const
+{
     Node<Key, Value>* current = root_; 
+    while (current != nullptr) {
+      int c = compareKeys(key, current->getKey()); 
+      if (c < 0) {
+        current = current->getLeft(); 
+      }
+      else if (c > 0) {
+        current = current->getRight(); 
+      }
+      else {
+        return current; 
+      }
+    }
+    return nullptr; 
+}
 
-    //iterate through the tree, comparing keys of current and the given key
+/**
+* Descent for plain less-than comparators: one comparison per node.
+* Going left whenever the node's key is not less than key leaves the
+* last such node as the only one that can be equal to key, so a single
+* extra comparison at the bottom settles it.
+*/
+template<typename Key, typename Value, typename Compare>
+template<typename K>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findNode(const K& key, std::false_type) const
+{
+    Node<Key, Value>* current = root_; 
+    Node<Key, Value>* candidate = nullptr; 
     while (current != nullptr) {
-      //if key given is greater than the current node key, go right
-      if (current->getKey() < key) {
+      if (comp_(current->getKey(), key)) {
         current = current->getRight(); 
       }
-      //if key given is less than the current node key, go left
-      else if (current->getKey() > key) {
+      else {
+        candidate = current; 
         current = current->getLeft(); 
       }
-      //if key given is equal to the current node key, return the node
-      else {
+    }
+    if (candidate != nullptr && !comp_(key, candidate->getKey())) {
+      return candidate; 
+    }
+    return nullptr; 
+}
+
+/**
+* Finds where key belongs. Returns the node with an equivalent key if there
+* is one. Otherwise returns NULL and sets parent and isLeft to the empty child
+* slot a new node for key should go in (parent is NULL for an empty tree).
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft) const
+{
+    parent = nullptr; 
+    isLeft = false; 
+    return findSlot(key, parent, isLeft, ThreeWaySearch());
+}
+
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft, std::true_type) const
+{
+    Node<Key, Value>* current = root_; 
+    while (current != nullptr) {
+      int c = compareKeys(key, current->getKey()); 
+      if (c == 0) {
         return current; 
       }
+      parent = current; 
+      isLeft = c < 0; 
+      current = isLeft ? current->getLeft() : current->getRight(); 
+    }
+    return nullptr; 
+}
+
+/**
+* Same single-comparison descent as findNode(): an equal key can only be in
+* the last node we went left from, and if it is not, the key belongs at the
+* empty slot the descent ended on.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findSlot(const Key& key, Node<Key, Value>*& parent, bool& isLeft, std::false_type) const
+{
+    Node<Key, Value>* current = root_; 
+    Node<Key, Value>* candidate = nullptr; 
+    while (current != nullptr) {
+      parent = current; 
+      isLeft = !comp_(current->getKey(), key); 
+      if (isLeft) {
+        candidate = current; 
+        current = current->getLeft(); 
+      }
+      else {
+        current = current->getRight(); 
+      }
     }
-  return nullptr; 
+    if (candidate != nullptr && !comp_(key, candidate->getKey())) {
+      return candidate; 
+    }
+    return nullptr; 
+}
+
+/**
+* Like findSlot(), but first tries the slots next to hint (NULL meaning end()).
+* A key between the hint's predecessor and the hint goes in the hint's empty
+* left slot or, if the hint has a left child, in the empty right slot of the
+* predecessor. Keys between the hint and its successor are handled the same
+* way on the other side. Only when key is outside both gaps do we fall back to
+* a descent from the root.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::findHintSlot(Node<Key, Value>* hint, const Key& key, Node<Key, Value>*& parent, bool& isLeft) const
+{
+    if (root_ == nullptr) {
+      return findSlot(key, parent, isLeft); 
+    }
+
+    //end() as a hint: append after the largest key
+    if (hint == nullptr) {
+      if (comp_(rightmost_->getKey(), key)) {
+        parent = rightmost_; 
+        isLeft = false; 
+        return nullptr; 
+      }
+      return findSlot(key, parent, isLeft); 
+    }
+
+    //key goes somewhere before the hint
+    if (comp_(key, hint->getKey())) {
+      Node<Key, Value>* before = prevNode(hint); 
+      if (before == nullptr || comp_(before->getKey(), key)) {
+        isLeft = hint->getLeft() == nullptr; 
+        parent = isLeft ? hint : before; 
+        return nullptr; 
+      }
+      if (!comp_(key, before->getKey())) {
+        return before; 
+      }
+      return findSlot(key, parent, isLeft); 
+    }
+
+    //key goes somewhere after the hint
+    if (comp_(hint->getKey(), key)) {
+      Node<Key, Value>* after = nullptr; 
+      if (hint != rightmost_) {
+        after = nextNode(hint); 
+      }
+      if (after == nullptr || comp_(key, after->getKey())) {
+        isLeft = hint->getRight() != nullptr; 
+        parent = isLeft ? after : hint; 
+        return nullptr; 
+      }
+      if (!comp_(after->getKey(), key)) {
+        return after; 
+      }
+      return findSlot(key, parent, isLeft); 
+    }
+
+    //the hint holds the key itself
+    return hint; 
+}
+
+/**
+* Returns the node with the smallest key that is not less than key, or NULL.
+* Like findNode(), this makes one comparison per level and remembers the
+* last node the descent went left from.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::lowerBoundNode(const Key& key) const
+{
+    Node<Key, Value>* current = root_; 
+    Node<Key, Value>* candidate = nullptr; 
+    while (current != nullptr) {
+      if (!comp_(current->getKey(), key)) {
+        candidate = current; 
+        current = current->getLeft(); 
+      }
+      else {
+        current = current->getRight(); 
+      }
+    }
+    return candidate; 
+}
+
+/**
+* Returns the node with the smallest key that is not less than key, or NULL,
+* starting from finger instead of the root, and moves finger to the last
+* node the search visited (a neighbour of key in key order).
+*
+* Every key in a subtree lies between the nearest ancestors it hangs left
+* and right of. For a key after the finger, only the ancestor above (the
+* first one reached from a left child) can rule the key out, so the climb
+* stops at the first such ancestor whose key is greater, which is then
+* also the answer if the subtree below has none. A key before the finger
+* climbs the other way until an ancestor's key is smaller; the answer is
+* then in the subtree, since the finger itself is not less than key. An
+* ancestor with an equal key on the way up ends the search early.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::fingerLowerBound(Node<Key, Value>*& finger, const Key& key) const
+{
+    Node<Key, Value>* current = finger == nullptr ? root_ : finger; 
+    Node<Key, Value>* candidate = nullptr; 
+    if (current == nullptr) {
+      return nullptr; 
+    }
+    if (!comp_(key, current->getKey())) {
+      for (Node<Key, Value>* parent = current->getParent(); parent != nullptr; parent = current->getParent()) {
+        if (parent->getLeft() == current) {
+          int c = compareKeys(key, parent->getKey()); 
+          if (c < 0) {
+            candidate = parent; 
+            break; 
+          }
+          if (c == 0) {
+            finger = parent; 
+            return parent; 
+          }
+        }
+        current = parent; 
+      }
+    }
+    else {
+      for (Node<Key, Value>* parent = current->getParent(); parent != nullptr; parent = current->getParent()) {
+        if (parent->getRight() == current) {
+          int c = compareKeys(key, parent->getKey()); 
+          if (c > 0) {
+            break; 
+          }
+          if (c == 0) {
+            finger = parent; 
+            return parent; 
+          }
+        }
+        current = parent; 
+      }
+    }
+
+    //a lower-bound descent within the subtree that stops at an equal key,
+    //as find() does, rather than going on down to a leaf
+    Node<Key, Value>* last = current; 
+    while (current != nullptr) {
+      last = current; 
+      int c = compareKeys(key, current->getKey()); 
+      if (c == 0) {
+        candidate = current; 
+        break; 
+      }
+      if (c < 0) {
+        candidate = current; 
+        current = current->getLeft(); 
+      }
+      else {
+        current = current->getRight(); 
+      }
+    }
+    finger = last; 
+    return candidate; 
+}
+
+/**
+* Sets out[i] for the sorted keys[lo, hi), all of which belong in the
+* subtree rooted at node. The side with fewer keys is handled by recursion
+* and the other by the loop, so the stack is O(log k) deep however
+* unbalanced the tree is.
+*/
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::findSortedRange(Node<Key, Value>* node, const std::vector<Key>& keys, std::size_t lo, std::size_t hi, std::vector<iterator>& out) const
+{
+    while (node != nullptr && lo < hi) {
+      //keys[lo, mid) go left, keys[mid, after) match node, keys[after, hi) go right
+      typename std::vector<Key>::const_iterator first = keys.begin(); 
+      std::size_t mid = std::lower_bound(first + lo, first + hi, node->getKey(), comp_) - first; 
+      std::size_t after = std::upper_bound(first + mid, first + hi, node->getKey(), comp_) - first; 
+      for (std::size_t i = mid; i < after; ++i) {
+        out[i] = iterator(node, this); 
+      }
+      if (mid - lo < hi - after) {
+        findSortedRange(node->getLeft(), keys, lo, mid, out); 
+        node = node->getRight(); 
+        lo = after; 
+      }
+      else {
+        findSortedRange(node->getRight(), keys, after, hi, out); 
+        node = node->getLeft(); 
+        hi = mid; 
+      }
+    }
+}
+
+/**
+* Returns the node with the smallest key greater than key, or NULL.
+*/
+template<typename Key, typename Value, typename Compare>
+Node<Key, Value>* BinarySearchTree<Key, Value, Compare>::upperBoundNode(const Key& key) const
+{
+    Node<Key, Value>* current = root_; 
+    Node<Key, Value>* candidate = nullptr; 
+    while (current != nullptr) {
+      if (comp_(key, current->getKey())) {
+        candidate = current; 
+        current = current->getLeft(); 
+      }
+      else {
+        current = current->getRight(); 
+      }
+    }
+    return candidate; 
 }
 
 /**
  * Return true iff the BST is balanced.
  */
-template<typename Key, typename Value>
-bool BinarySearchTree<Key, Value>::isBalanced() const
+template<typename Key, typename Value, typename Compare>
+bool BinarySearchTree<Key, Value, Compare>::isBalanced() const
 {
     // TODO
     //to check if a node is balanced, we need to compare heights of its subtrees
@@ -806,8 +2524,8 @@ bool BinarySearchTree<Key, Value>::isBalanced() const
 
 }
 
-template<typename Key, typename Value> 
-int BinarySearchTree<Key, Value>::balanceHelper(Node<Key, Value>* node) const {
+template<typename Key, typename Value, typename Compare> 
+int BinarySearchTree<Key, Value, Compare>::balanceHelper(Node<Key, Value>* node) const {
   //empty but it means it is balanced
   if (node == nullptr) {
     return 0; 
@@ -825,8 +2543,8 @@ int BinarySearchTree<Key, Value>::balanceHelper(Node<Key, Value>* node) const {
     return -1; 
   }
 
-  //if heights differ by 1, tree is not balanced -> return and propagate false to top recursive call
-  if (abs(leftHeight - rightHeight) != 0) {
+  //if heights differ by more than 1, tree is not balanced -> return and propagate false to top recursive call
+  if (abs(leftHeight - rightHeight) > 1) {
     return -1; 
   }
 
@@ -838,8 +2556,8 @@ int BinarySearchTree<Key, Value>::balanceHelper(Node<Key, Value>* node) const {
 
 
 
-template<typename Key, typename Value>
-void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
+template<typename Key, typename Value, typename Compare>
+void BinarySearchTree<Key, Value, Compare>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2)
 {
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
@@ -0,0 +1,949 @@
+#ifndef BTREE_MAP_H
+#define BTREE_MAP_H
+
+#include <cstddef>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "bst.h"
+
+/*
+  ---------------------------------------------
+  Begin key search within a B-tree node.
+  ---------------------------------------------
+*/
+
+/**
+* Counts the keys in keys[0, n) that are not greater than key, which is the
+* index of the child to descend into. The general version binary searches.
+*/
+template<typename Key, typename Compare, bool Cheap = IsCheapCompare<Compare, Key>::value>
+struct BTreeKeySearch
+{
+    static unsigned countNotGreater(const Key* keys, unsigned n, const Key& key, const Compare& comp)
+    {
+        return (unsigned)(std::upper_bound(keys, keys + n, key, comp) - keys);
+    }
+};
+
+/**
+* For cheap comparisons a node is scanned from end to end without branching
+* on the keys, which beats a binary search over a few dozen keys that are
+* already in cache.
+*/
+template<typename Key, typename Compare>
+struct BTreeKeySearch<Key, Compare, true>
+{
+    static unsigned countNotGreater(const Key* keys, unsigned n, const Key& key, const Compare& comp)
+    {
+        unsigned count = 0;
+        for (unsigned i = 0; i < n; ++i) {
+            count += !comp(key, keys[i]);
+        }
+        return count;
+    }
+};
+
+#if defined(__SSE2__)
+/**
+* int keys ordered by std::less are compared four at a time with SSE2.
+*/
+template<>
+struct BTreeKeySearch<int, std::less<int>, true>
+{
+    static unsigned countNotGreater(const int* keys, unsigned n, const int& key, const std::less<int>&)
+    {
+        const __m128i target = _mm_set1_epi32(key);
+        unsigned greater = 0;
+        unsigned i = 0;
+        for (; i + 4 <= n; i += 4) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(block, target)));
+            greater += (unsigned)__builtin_popcount(mask);
+        }
+        for (; i < n; ++i) {
+            greater += keys[i] > key;
+        }
+        return n - greater;
+    }
+};
+#endif
+
+/*
+  ---------------------------------------------
+  End key search within a B-tree node.
+  ---------------------------------------------
+*/
+
+/**
+* A sorted map stored as a B+ tree, with the same interface as
+* BinarySearchTree for insert, remove, find, operator[] and iteration.
+*
+* Every item lives in a leaf. Leaves hold up to LEAF_SLOTS items side by side
+* and are linked in key order, so iteration walks arrays instead of chasing a
+* pointer per item. Inner nodes hold up to INNER_SLOTS separator keys in one
+* array plus the child pointers. Both kinds of node are sized to about
+* NODE_BYTES, a few cache lines, so a lookup touches a handful of lines per
+* level and the tree is only a few levels deep. Nodes come from a NodePool,
+* like the binary trees' nodes.
+*
+* The separator between two children is a copy of the smallest key in the
+* right child at the time it was set, so every key to the left is smaller
+* and every key to the right is not. Removes can leave a separator that is
+* no longer in any leaf, which is harmless.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class BTreeMap
+{
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    static const std::size_t NODE_BYTES = 256;
+    static const unsigned LEAF_SLOTS = (NODE_BYTES - 4 * sizeof(void*)) / sizeof(Item) < 4 ?
+        4 : (unsigned)((NODE_BYTES - 4 * sizeof(void*)) / sizeof(Item));
+    static const unsigned INNER_SLOTS = (NODE_BYTES - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(void*)) < 4 ?
+        4 : (unsigned)((NODE_BYTES - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(void*)));
+
+    struct NodeBase
+    {
+        bool isLeaf;
+        unsigned count;     // items in a leaf, keys in an inner node
+    };
+
+    // Each node has room for one item or key over its limit, so an insert
+    // can go in first and the node is split afterwards.
+    struct LeafNode : NodeBase
+    {
+        LeafNode* prev;
+        LeafNode* next;
+        typename std::aligned_storage<sizeof(Item), alignof(Item)>::type slots[LEAF_SLOTS + 1];
+
+        LeafNode() : prev(NULL), next(NULL) { this->isLeaf = true; this->count = 0; }
+        Item& item(unsigned i) { return *reinterpret_cast<Item*>(&slots[i]); }
+        const Item& item(unsigned i) const { return *reinterpret_cast<const Item*>(&slots[i]); }
+    };
+
+    struct InnerNode : NodeBase
+    {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type slots[INNER_SLOTS + 1];
+        NodeBase* children[INNER_SLOTS + 2];
+
+        InnerNode() { this->isLeaf = false; this->count = 0; }
+        Key* keys() { return reinterpret_cast<Key*>(slots); }
+        const Key* keys() const { return reinterpret_cast<const Key*>(slots); }
+    };
+
+public:
+    BTreeMap();
+    explicit BTreeMap(const Compare& comp);
+    ~BTreeMap();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+    * A bidirectional iterator over the items in key order.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BTreeMap<Key, Value, Compare>;
+        iterator(LeafNode* leaf, unsigned pos, const BTreeMap<Key, Value, Compare>* tree);
+        LeafNode* leaf_;
+        unsigned pos_;
+        const BTreeMap<Key, Value, Compare>* tree_;
+    };
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    Compare key_comp() const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    // Searches within a node
+    unsigned childIndex(const InnerNode* node, const Key& key) const;
+    unsigned leafLowerBound(const LeafNode* leaf, const Key& key) const;
+    LeafNode* findLeaf(const Key& key) const;
+
+    // Insertion
+    NodeBase* insertInto(NodeBase* node, const Item& keyValuePair);
+    LeafNode* splitLeaf(LeafNode* leaf);
+    InnerNode* splitInner(InnerNode* node);
+    void addChild(InnerNode* parent, unsigned index, NodeBase* left, NodeBase* right);
+
+    // Removal
+    bool removeFrom(NodeBase* node, const Key& key);
+    void fixChild(InnerNode* parent, unsigned index);
+    void mergeLeaves(InnerNode* parent, unsigned index);
+    void mergeInner(InnerNode* parent, unsigned index);
+
+    // Moving items and keys around inside the raw node storage
+    static void insertItem(LeafNode* leaf, unsigned pos, const Item& item);
+    static void moveItem(LeafNode* from, unsigned fromPos, LeafNode* to, unsigned toPos);
+    static void eraseItem(LeafNode* leaf, unsigned pos);
+    static void insertKey(InnerNode* node, unsigned pos, const Key& key);
+    static void eraseKey(InnerNode* node, unsigned pos);
+
+    void destroySubtree(NodeBase* node);
+
+protected:
+    NodeBase* root_;
+    LeafNode* firstLeaf_;
+    LeafNode* lastLeaf_;
+    std::size_t size_;
+    NodePool pool_;
+    Compare comp_;
+};
+
+/*
+--------------------------------------------------------
+Begin implementations for the BTreeMap::iterator class.
+--------------------------------------------------------
+*/
+
+/**
+* A default constructor that initializes the iterator to end().
+*/
+template<class Key, class Value, class Compare>
+BTreeMap<Key, Value, Compare>::iterator::iterator() : leaf_(NULL), pos_(0), tree_(NULL)
+{
+
+}
+
+/**
+* Explicit constructor for an iterator at item pos of leaf.
+*/
+template<class Key, class Value, class Compare>
+BTreeMap<Key, Value, Compare>::iterator::iterator(LeafNode* leaf, unsigned pos, const BTreeMap<Key, Value, Compare>* tree) :
+    leaf_(leaf), pos_(pos), tree_(tree)
+{
+
+}
+
+/**
+* Provides access to the item.
+*/
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> &
+BTreeMap<Key, Value, Compare>::iterator::operator*() const
+{
+    return leaf_->item(pos_);
+}
+
+/**
+* Provides access to the address of the item.
+*/
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> *
+BTreeMap<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(leaf_->item(pos_));
+}
+
+template<class Key, class Value, class Compare>
+bool BTreeMap<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && pos_ == rhs.pos_;
+}
+
+template<class Key, class Value, class Compare>
+bool BTreeMap<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Moves to the next item, continuing into the next leaf at the end of this one.
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator&
+BTreeMap<Key, Value, Compare>::iterator::operator++()
+{
+    if (leaf_ == NULL) {
+        return *this;
+    }
+    if (++pos_ == leaf_->count) {
+        leaf_ = leaf_->next;
+        pos_ = 0;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator
+BTreeMap<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves to the previous item. Decrementing end() moves to the largest item.
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator&
+BTreeMap<Key, Value, Compare>::iterator::operator--()
+{
+    if (leaf_ == NULL) {
+        leaf_ = tree_->lastLeaf_;
+        pos_ = leaf_ == NULL ? 0 : leaf_->count - 1;
+    }
+    else if (pos_ == 0) {
+        leaf_ = leaf_->prev;
+        pos_ = leaf_ == NULL ? 0 : leaf_->count - 1;
+    }
+    else {
+        --pos_;
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator
+BTreeMap<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+------------------------------------------------------
+End implementations for the BTreeMap::iterator class.
+------------------------------------------------------
+*/
+
+/*
+----------------------------------------------
+Begin implementations for the BTreeMap class.
+----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty BTreeMap.
+*/
+template<class Key, class Value, class Compare>
+BTreeMap<Key, Value, Compare>::BTreeMap() :
+    root_(NULL), firstLeaf_(NULL), lastLeaf_(NULL), size_(0), pool_(), comp_()
+{
+
+}
+
+/**
+* Constructor for an empty BTreeMap ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+BTreeMap<Key, Value, Compare>::BTreeMap(const Compare& comp) :
+    root_(NULL), firstLeaf_(NULL), lastLeaf_(NULL), size_(0), pool_(), comp_(comp)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+BTreeMap<Key, Value, Compare>::~BTreeMap()
+{
+    clear();
+}
+
+/**
+* Returns true if the map is empty
+*/
+template<class Key, class Value, class Compare>
+bool BTreeMap<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+* Returns the number of items in the map
+*/
+template<class Key, class Value, class Compare>
+std::size_t BTreeMap<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Returns a copy of the comparator that orders the keys.
+*/
+template<class Key, class Value, class Compare>
+Compare BTreeMap<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Returns an iterator to the "smallest" item in the map
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator
+BTreeMap<Key, Value, Compare>::begin() const
+{
+    return iterator(firstLeaf_, 0, this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator
+BTreeMap<Key, Value, Compare>::end() const
+{
+    return iterator(NULL, 0, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the map
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::iterator
+BTreeMap<Key, Value, Compare>::find(const Key& key) const
+{
+    LeafNode* leaf = findLeaf(key);
+    if (leaf == NULL) {
+        return end();
+    }
+    unsigned pos = leafLowerBound(leaf, key);
+    if (pos == leaf->count || comp_(key, leaf->item(pos).first)) {
+        return end();
+    }
+    return iterator(leaf, pos, this);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value& BTreeMap<Key, Value, Compare>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+template<class Key, class Value, class Compare>
+Value const & BTreeMap<Key, Value, Compare>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+/**
+* Returns the index of the child of node whose subtree would hold key.
+*/
+template<class Key, class Value, class Compare>
+unsigned BTreeMap<Key, Value, Compare>::childIndex(const InnerNode* node, const Key& key) const
+{
+    return BTreeKeySearch<Key, Compare>::countNotGreater(node->keys(), node->count, key, comp_);
+}
+
+/**
+* Returns the position of the first item in leaf whose key is not less than
+* key (leaf->count if there is none).
+*/
+template<class Key, class Value, class Compare>
+unsigned BTreeMap<Key, Value, Compare>::leafLowerBound(const LeafNode* leaf, const Key& key) const
+{
+    if (IsCheapCompare<Compare, Key>::value) {
+        unsigned count = 0;
+        for (unsigned i = 0; i < leaf->count; ++i) {
+            count += comp_(leaf->item(i).first, key);
+        }
+        return count;
+    }
+    unsigned lo = 0;
+    unsigned hi = leaf->count;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        if (comp_(leaf->item(mid).first, key)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/**
+* Descends to the leaf whose range covers key, or returns NULL for an empty map.
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::LeafNode*
+BTreeMap<Key, Value, Compare>::findLeaf(const Key& key) const
+{
+    NodeBase* node = root_;
+    if (node == NULL) {
+        return NULL;
+    }
+    while (!node->isLeaf) {
+        const InnerNode* inner = static_cast<const InnerNode*>(node);
+        node = inner->children[childIndex(inner, key)];
+    }
+    return static_cast<LeafNode*>(node);
+}
+
+/**
+* An insert method to insert into the map. If key is already in the
+* map, the current value is overwritten with the new value.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    //an empty map starts with a single leaf
+    if (root_ == NULL) {
+        LeafNode* leaf = pool_.template create<LeafNode>();
+        insertItem(leaf, 0, keyValuePair);
+        root_ = leaf;
+        firstLeaf_ = leaf;
+        lastLeaf_ = leaf;
+        ++size_;
+        return;
+    }
+    //if the root split, the tree grows a level
+    NodeBase* right = insertInto(root_, keyValuePair);
+    if (right != NULL) {
+        InnerNode* newRoot = pool_.template create<InnerNode>();
+        newRoot->children[0] = root_;
+        addChild(newRoot, 0, root_, right);
+        root_ = newRoot;
+    }
+}
+
+/**
+* Inserts into the subtree rooted at node. If node overflowed and was split,
+* returns the new right half for the caller to add next to it, else NULL.
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::NodeBase*
+BTreeMap<Key, Value, Compare>::insertInto(NodeBase* node, const Item& keyValuePair)
+{
+    if (node->isLeaf) {
+        LeafNode* leaf = static_cast<LeafNode*>(node);
+        unsigned pos = leafLowerBound(leaf, keyValuePair.first);
+        //if the key is already here, just update the value
+        if (pos < leaf->count && !comp_(keyValuePair.first, leaf->item(pos).first)) {
+            leaf->item(pos).second = keyValuePair.second;
+            return NULL;
+        }
+        insertItem(leaf, pos, keyValuePair);
+        ++size_;
+        return leaf->count > LEAF_SLOTS ? splitLeaf(leaf) : NULL;
+    }
+
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    unsigned index = childIndex(inner, keyValuePair.first);
+    NodeBase* right = insertInto(inner->children[index], keyValuePair);
+    if (right == NULL) {
+        return NULL;
+    }
+    addChild(inner, index, inner->children[index], right);
+    return inner->count > INNER_SLOTS ? splitInner(inner) : NULL;
+}
+
+/**
+* Moves the upper half of an overfull leaf into a new leaf that follows it.
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::LeafNode*
+BTreeMap<Key, Value, Compare>::splitLeaf(LeafNode* leaf)
+{
+    LeafNode* right = pool_.template create<LeafNode>();
+    unsigned keep = leaf->count / 2;
+    for (unsigned i = keep; i < leaf->count; ++i) {
+        moveItem(leaf, i, right, i - keep);
+    }
+    right->count = leaf->count - keep;
+    leaf->count = keep;
+
+    //link the new leaf into the list
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next != NULL) {
+        leaf->next->prev = right;
+    }
+    else {
+        lastLeaf_ = right;
+    }
+    leaf->next = right;
+    return right;
+}
+
+/**
+* Moves the keys and children above the middle key of an overfull inner node
+* into a new node. The middle key moves up to the parent, so it is left
+* constructed just past the end of node for addChild() to take.
+*/
+template<class Key, class Value, class Compare>
+typename BTreeMap<Key, Value, Compare>::InnerNode*
+BTreeMap<Key, Value, Compare>::splitInner(InnerNode* node)
+{
+    InnerNode* right = pool_.template create<InnerNode>();
+    unsigned middle = node->count / 2;
+    for (unsigned i = middle + 1; i < node->count; ++i) {
+        new (&right->keys()[i - middle - 1]) Key(std::move(node->keys()[i]));
+        node->keys()[i].~Key();
+    }
+    for (unsigned i = middle + 1; i <= node->count; ++i) {
+        right->children[i - middle - 1] = node->children[i];
+    }
+    right->count = node->count - middle - 1;
+    node->count = middle;
+    return right;
+}
+
+/**
+* Adds right as child index + 1 of parent, just after its left half, along
+* with the separator between them. A split leaf's separator is a copy of the
+* first key in right; a split inner node's is its middle key, which
+* splitInner() left past the end of left.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::addChild(InnerNode* parent, unsigned index, NodeBase* left, NodeBase* right)
+{
+    if (right->isLeaf) {
+        insertKey(parent, index, static_cast<LeafNode*>(right)->item(0).first);
+    }
+    else {
+        Key* middle = &static_cast<InnerNode*>(left)->keys()[left->count];
+        insertKey(parent, index, *middle);
+        middle->~Key();
+    }
+    for (unsigned i = parent->count; i > index + 1; --i) {
+        parent->children[i] = parent->children[i - 1];
+    }
+    parent->children[index + 1] = right;
+}
+
+/**
+* A remove method to remove a specific key from the map.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::remove(const Key& key)
+{
+    if (root_ == NULL || !removeFrom(root_, key)) {
+        return;
+    }
+    //shrink the tree when the root runs out of keys
+    if (root_->isLeaf) {
+        if (root_->count == 0) {
+            pool_.destroy(static_cast<LeafNode*>(root_));
+            root_ = NULL;
+            firstLeaf_ = NULL;
+            lastLeaf_ = NULL;
+        }
+    }
+    else if (root_->count == 0) {
+        InnerNode* oldRoot = static_cast<InnerNode*>(root_);
+        root_ = oldRoot->children[0];
+        pool_.destroy(oldRoot);
+    }
+}
+
+/**
+* Removes key from the subtree rooted at node and returns whether it was
+* there. Children left with too few items are topped up or merged on the way
+* back up, so only the root can end up under the minimum.
+*/
+template<class Key, class Value, class Compare>
+bool BTreeMap<Key, Value, Compare>::removeFrom(NodeBase* node, const Key& key)
+{
+    if (node->isLeaf) {
+        LeafNode* leaf = static_cast<LeafNode*>(node);
+        unsigned pos = leafLowerBound(leaf, key);
+        if (pos == leaf->count || comp_(key, leaf->item(pos).first)) {
+            return false;
+        }
+        eraseItem(leaf, pos);
+        --size_;
+        return true;
+    }
+
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    unsigned index = childIndex(inner, key);
+    if (!removeFrom(inner->children[index], key)) {
+        return false;
+    }
+    NodeBase* child = inner->children[index];
+    unsigned minimum = child->isLeaf ? LEAF_SLOTS / 2 : INNER_SLOTS / 2;
+    if (child->count < minimum) {
+        fixChild(inner, index);
+    }
+    return true;
+}
+
+/**
+* Tops up child index of parent, which is one under the minimum, by borrowing
+* from a sibling that can spare an item or key. If neither can, merges it
+* with a sibling.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::fixChild(InnerNode* parent, unsigned index)
+{
+    NodeBase* child = parent->children[index];
+    NodeBase* left = index > 0 ? parent->children[index - 1] : NULL;
+    NodeBase* right = index < parent->count ? parent->children[index + 1] : NULL;
+    unsigned minimum = child->isLeaf ? LEAF_SLOTS / 2 : INNER_SLOTS / 2;
+
+    if (child->isLeaf) {
+        LeafNode* leaf = static_cast<LeafNode*>(child);
+        //borrow the largest item of the left sibling
+        if (left != NULL && left->count > minimum) {
+            LeafNode* from = static_cast<LeafNode*>(left);
+            insertItem(leaf, 0, from->item(from->count - 1));
+            eraseItem(from, from->count - 1);
+            parent->keys()[index - 1] = leaf->item(0).first;
+        }
+        //borrow the smallest item of the right sibling
+        else if (right != NULL && right->count > minimum) {
+            LeafNode* from = static_cast<LeafNode*>(right);
+            insertItem(leaf, leaf->count, from->item(0));
+            eraseItem(from, 0);
+            parent->keys()[index] = from->item(0).first;
+        }
+        else {
+            mergeLeaves(parent, left != NULL ? index - 1 : index);
+        }
+        return;
+    }
+
+    InnerNode* inner = static_cast<InnerNode*>(child);
+    //rotate a key and child in from the left sibling through the parent
+    if (left != NULL && left->count > minimum) {
+        InnerNode* from = static_cast<InnerNode*>(left);
+        insertKey(inner, 0, parent->keys()[index - 1]);
+        for (unsigned i = inner->count; i > 0; --i) {
+            inner->children[i] = inner->children[i - 1];
+        }
+        inner->children[0] = from->children[from->count];
+        parent->keys()[index - 1] = from->keys()[from->count - 1];
+        eraseKey(from, from->count - 1);
+    }
+    //likewise from the right sibling
+    else if (right != NULL && right->count > minimum) {
+        InnerNode* from = static_cast<InnerNode*>(right);
+        insertKey(inner, inner->count, parent->keys()[index]);
+        inner->children[inner->count] = from->children[0];
+        parent->keys()[index] = from->keys()[0];
+        for (unsigned i = 0; i < from->count; ++i) {
+            from->children[i] = from->children[i + 1];
+        }
+        eraseKey(from, 0);
+    }
+    else {
+        mergeInner(parent, left != NULL ? index - 1 : index);
+    }
+}
+
+/**
+* Moves every item of leaf index + 1 of parent into leaf index, then drops
+* the emptied leaf and the separator between them.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::mergeLeaves(InnerNode* parent, unsigned index)
+{
+    LeafNode* left = static_cast<LeafNode*>(parent->children[index]);
+    LeafNode* right = static_cast<LeafNode*>(parent->children[index + 1]);
+    for (unsigned i = 0; i < right->count; ++i) {
+        moveItem(right, i, left, left->count + i);
+    }
+    left->count += right->count;
+    right->count = 0;
+
+    left->next = right->next;
+    if (right->next != NULL) {
+        right->next->prev = left;
+    }
+    else {
+        lastLeaf_ = left;
+    }
+
+    eraseKey(parent, index);
+    for (unsigned i = index + 1; i <= parent->count; ++i) {
+        parent->children[i] = parent->children[i + 1];
+    }
+    pool_.destroy(right);
+}
+
+/**
+* Pulls the separator down from parent and appends it and everything in
+* inner node index + 1 to inner node index, then drops the emptied node.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::mergeInner(InnerNode* parent, unsigned index)
+{
+    InnerNode* left = static_cast<InnerNode*>(parent->children[index]);
+    InnerNode* right = static_cast<InnerNode*>(parent->children[index + 1]);
+    insertKey(left, left->count, parent->keys()[index]);
+    for (unsigned i = 0; i < right->count; ++i) {
+        insertKey(left, left->count, right->keys()[i]);
+        left->children[left->count - 1] = right->children[i];
+    }
+    left->children[left->count] = right->children[right->count];
+    while (right->count > 0) {
+        eraseKey(right, right->count - 1);
+    }
+
+    eraseKey(parent, index);
+    for (unsigned i = index + 1; i <= parent->count; ++i) {
+        parent->children[i] = parent->children[i + 1];
+    }
+    pool_.destroy(right);
+}
+
+/**
+* Copies item into position pos of leaf, shifting the items after it.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::insertItem(LeafNode* leaf, unsigned pos, const Item& item)
+{
+    //the key is const, so items are moved by constructing and destroying
+    for (unsigned i = leaf->count; i > pos; --i) {
+        moveItem(leaf, i - 1, leaf, i);
+    }
+    new (&leaf->slots[pos]) Item(item);
+    ++leaf->count;
+}
+
+/**
+* Moves the item in from at fromPos to the empty slot toPos of to.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::moveItem(LeafNode* from, unsigned fromPos, LeafNode* to, unsigned toPos)
+{
+    new (&to->slots[toPos]) Item(std::move(from->item(fromPos)));
+    from->item(fromPos).~Item();
+}
+
+/**
+* Destroys the item at pos in leaf, shifting the items after it down.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::eraseItem(LeafNode* leaf, unsigned pos)
+{
+    leaf->item(pos).~Item();
+    for (unsigned i = pos + 1; i < leaf->count; ++i) {
+        moveItem(leaf, i, leaf, i - 1);
+    }
+    --leaf->count;
+}
+
+/**
+* Copies key into position pos of node, shifting the keys after it. Children
+* are left for the caller to shift.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::insertKey(InnerNode* node, unsigned pos, const Key& key)
+{
+    Key* keys = node->keys();
+    if (pos == node->count) {
+        new (&keys[pos]) Key(key);
+    }
+    else {
+        new (&keys[node->count]) Key(std::move(keys[node->count - 1]));
+        for (unsigned i = node->count - 1; i > pos; --i) {
+            keys[i] = std::move(keys[i - 1]);
+        }
+        keys[pos] = key;
+    }
+    ++node->count;
+}
+
+/**
+* Removes the key at pos from node, shifting the keys after it down.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::eraseKey(InnerNode* node, unsigned pos)
+{
+    Key* keys = node->keys();
+    for (unsigned i = pos + 1; i < node->count; ++i) {
+        keys[i - 1] = std::move(keys[i]);
+    }
+    keys[node->count - 1].~Key();
+    --node->count;
+}
+
+/**
+* A method to remove all contents of the map and
+* reset the values in the map for use again.
+*/
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::clear()
+{
+    //as with the binary trees, trivially destructible contents are dropped
+    //with the pool's slabs instead of node by node
+    if (!std::is_trivially_destructible<Item>::value || !std::is_trivially_destructible<Key>::value) {
+        destroySubtree(root_);
+    }
+    pool_.release();
+    root_ = NULL;
+    firstLeaf_ = NULL;
+    lastLeaf_ = NULL;
+    size_ = 0;
+}
+
+template<class Key, class Value, class Compare>
+void BTreeMap<Key, Value, Compare>::destroySubtree(NodeBase* node)
+{
+    if (node == NULL) {
+        return;
+    }
+    if (node->isLeaf) {
+        LeafNode* leaf = static_cast<LeafNode*>(node);
+        for (unsigned i = 0; i < leaf->count; ++i) {
+            leaf->item(i).~Item();
+        }
+        pool_.destroy(leaf);
+        return;
+    }
+    InnerNode* inner = static_cast<InnerNode*>(node);
+    for (unsigned i = 0; i <= inner->count; ++i) {
+        destroySubtree(inner->children[i]);
+    }
+    for (unsigned i = 0; i < inner->count; ++i) {
+        inner->keys()[i].~Key();
+    }
+    pool_.destroy(inner);
+}
+
+/*
+--------------------------------------------
+End implementations for the BTreeMap class.
+--------------------------------------------
+*/
+
+#endif
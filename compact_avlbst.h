@@ -0,0 +1,1147 @@
+#ifndef COMPACT_AVLBST_H
+#define COMPACT_AVLBST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+* An AVL tree with AVLTree's map interface whose nodes take about half the
+* memory, for very large maps of small keys and values.
+*
+* The nodes live in large blocks of slots and link to each other by 32-bit
+* slot index instead of by pointer. The parent index and the balance share
+* one word (30 bits for the index, 2 for the balance), and the subtree size
+* for the order statistics is 32 bits as well, so a node is the item plus 16
+* bytes. For 8-byte keys and values that is 32 bytes, against 64 for an
+* AVLNode once the pool has rounded it up. The tree holds at most 2^30 - 1
+* items.
+*
+* Blocks are never moved, so references and iterators to items stay valid
+* until the item is removed, as they do in AVLTree. Removed slots go on a free
+* list and are reused by later inserts.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class CompactAVLTree
+{
+protected:
+    typedef std::pair<const Key, Value> Item;
+    typedef std::uint32_t Index;
+
+    // Index 0 is the null link, so slot 0 is never used.
+    static const Index NIL = 0;
+    static const Index MAX_NODES = (Index(1) << 30) - 1;
+    static const unsigned BLOCK_BITS = 16;
+    static const Index BLOCK_SLOTS = Index(1) << BLOCK_BITS;
+
+    struct Slot
+    {
+        typename std::aligned_storage<sizeof(Item), alignof(Item)>::type storage;
+        Index left;     // also the next free slot while the slot is free
+        Index right;
+        Index parentBalance;    // parent index << 2 | (balance + 1)
+        Index size;     // nodes in the subtree rooted here
+
+        Item& item() { return *reinterpret_cast<Item*>(&storage); }
+        Index parent() const { return parentBalance >> 2; }
+        void setParent(Index parent) { parentBalance = (parent << 2) | (parentBalance & 3); }
+        int balance() const { return (int)(parentBalance & 3) - 1; }
+        void setBalance(int balance) { parentBalance = (parentBalance & ~Index(3)) | Index(balance + 1); }
+    };
+
+public:
+    CompactAVLTree();
+    explicit CompactAVLTree(const Compare& comp);
+    template<typename InputIt>
+    CompactAVLTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
+    ~CompactAVLTree();
+
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last, bool sorted = true);
+    void reserve(std::size_t n);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+    * A bidirectional iterator over the items in key order.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class CompactAVLTree<Key, Value, Compare>;
+        iterator(Index node, const CompactAVLTree<Key, Value, Compare>* tree);
+        Index node_;
+        const CompactAVLTree<Key, Value, Compare>* tree_;
+    };
+
+    template<typename P, typename = typename std::enable_if<
+        std::is_constructible<std::pair<Key, Value>, P&&>::value>::type>
+    std::pair<iterator, bool> insert(P&& keyValuePair);
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Compare key_comp() const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+    // Order statistics, all O(log n)
+    iterator select(std::size_t k) const;
+    std::size_t rank(const Key& key) const;
+    std::size_t count_range(const Key& lo, const Key& hi) const;
+
+protected:
+    // Slot storage
+    Slot& slot(Index node) const;
+    Index allocateSlot();
+    void freeSlot(Index node);
+    Index subtreeSize(Index node) const;
+    void updateSize(Index node);
+
+    // Searches and in-order steps
+    Index findIndex(const Key& key) const;
+    Index findSlot(const Key& key, Index& parent, bool& isLeft) const;
+    Index lowerBoundIndex(const Key& key) const;
+    Index upperBoundIndex(const Key& key) const;
+    Index leftmost(Index node) const;
+    Index rightmost(Index node) const;
+    Index successor(Index node) const;
+    Index predecessor(Index node) const;
+
+    // Updates
+    void linkSlot(Index node, Index parent, bool isLeft);
+    void replaceChild(Index parent, Index oldChild, Index newChild);
+    void insertFix(Index parent, Index child);
+    void removeFix(Index node, bool leftShorter);
+    Index rebalance(Index node, int balance);
+    void rotateRight(Index node);
+    void rotateLeft(Index node);
+    template<typename ForwardIt>
+    Index buildSubtree(ForwardIt& it, std::size_t n, Index parent, int& height);
+    int balanceHelper(Index node) const;
+
+private:
+    CompactAVLTree(const CompactAVLTree&);
+    CompactAVLTree& operator=(const CompactAVLTree&);
+
+protected:
+    std::vector<Slot*> blocks_;
+    Index root_;
+    // slots below used_ have been handed out at least once
+    Index used_;
+    Index freeHead_;
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the CompactAVLTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty CompactAVLTree.
+*/
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree() :
+    blocks_(), root_(NIL), used_(1), freeHead_(NIL), size_(0), comp_()
+{
+
+}
+
+/**
+* Constructor for an empty CompactAVLTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(const Compare& comp) :
+    blocks_(), root_(NIL), used_(1), freeHead_(NIL), size_(0), comp_(comp)
+{
+
+}
+
+/**
+* Constructs a balanced CompactAVLTree from the key/value pairs in
+* [first, last) in linear time. See assign().
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+CompactAVLTree<Key, Value, Compare>::CompactAVLTree(InputIt first, InputIt last, bool sorted, const Compare& comp) :
+    blocks_(), root_(NIL), used_(1), freeHead_(NIL), size_(0), comp_(comp)
+{
+    assign(first, last, sorted);
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::~CompactAVLTree()
+{
+    clear();
+}
+
+/**
+* Replaces the contents of the tree with the key/value pairs in [first, last)
+* and builds a perfectly balanced tree from them in linear time, with the
+* items in consecutive slots in key order.
+*
+* If sorted is true the keys must already be in strictly increasing order.
+* Otherwise the pairs are copied and sorted first (O(n log n)), and when a key
+* appears more than once the last pair wins, just like repeated inserts.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+void CompactAVLTree<Key, Value, Compare>::assign(InputIt first, InputIt last, bool sorted)
+{
+    typedef typename std::iterator_traits<InputIt>::iterator_category Category;
+    clear();
+    int height = 0;
+
+    //a forward range that is already sorted can be built straight from the iterators
+    if (sorted && !std::is_same<Category, std::input_iterator_tag>::value) {
+        std::size_t n = (std::size_t)std::distance(first, last);
+        reserve(n);
+        root_ = buildSubtree(first, n, NIL, height);
+        size_ = n;
+        return;
+    }
+
+    //otherwise buffer the pairs so they can be counted (and sorted if asked)
+    std::vector<std::pair<Key, Value> > items(first, last);
+    if (!sorted) {
+        std::stable_sort(items.begin(), items.end(),
+            [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return comp_(a.first, b.first); });
+        //drop duplicate keys, keeping the value that came last
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (kept > 0 && !comp_(items[kept - 1].first, items[i].first)) {
+                items[kept - 1].second = items[i].second;
+            }
+            else {
+                if (kept != i) {
+                    items[kept] = std::move(items[i]);
+                }
+                ++kept;
+            }
+        }
+        items.erase(items.begin() + kept, items.end());
+    }
+    reserve(items.size());
+    typename std::vector<std::pair<Key, Value> >::iterator it = items.begin();
+    root_ = buildSubtree(it, items.size(), NIL, height);
+    size_ = items.size();
+}
+
+/**
+* Builds a balanced subtree from the next n pairs of an in-order sequence, as
+* BinarySearchTree::buildSubtree() does. Returns the root and its height.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::buildSubtree(ForwardIt& it, std::size_t n, Index parent, int& height)
+{
+    if (n == 0) {
+        height = 0;
+        return NIL;
+    }
+    //the left half comes first in order, so build it before the root
+    int leftHeight = 0;
+    int rightHeight = 0;
+    Index left = buildSubtree(it, n / 2, NIL, leftHeight);
+
+    Index node = allocateSlot();
+    Slot& s = slot(node);
+    new (&s.storage) Item(it->first, it->second);
+    ++it;
+    s.left = left;
+    if (left != NIL) {
+        slot(left).setParent(node);
+    }
+    s.parentBalance = parent << 2;
+    s.right = buildSubtree(it, n - n / 2 - 1, node, rightHeight);
+    s.setBalance(rightHeight - leftHeight);
+    updateSize(node);
+    height = 1 + std::max(leftHeight, rightHeight);
+    return node;
+}
+
+/**
+* Allocates enough blocks up front for the tree to hold n items without
+* allocating again.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::reserve(std::size_t n)
+{
+    if (n > MAX_NODES) {
+        throw std::length_error("CompactAVLTree is limited to 2^30 - 1 items");
+    }
+    //slot 0 is never used, hence the + 1
+    while (blocks_.size() * BLOCK_SLOTS < n + 1) {
+        blocks_.push_back(static_cast<Slot*>(::operator new(sizeof(Slot) * BLOCK_SLOTS)));
+    }
+}
+
+/**
+* Returns the slot with the given index.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Slot&
+CompactAVLTree<Key, Value, Compare>::slot(Index node) const
+{
+    return blocks_[node >> BLOCK_BITS][node & (BLOCK_SLOTS - 1)];
+}
+
+/**
+* Takes a slot from the free list, or the next slot never used, adding a
+* block when the last one is full.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::allocateSlot()
+{
+    if (freeHead_ != NIL) {
+        Index node = freeHead_;
+        freeHead_ = slot(node).left;
+        return node;
+    }
+    if (used_ > MAX_NODES) {
+        throw std::length_error("CompactAVLTree is limited to 2^30 - 1 items");
+    }
+    if ((used_ >> BLOCK_BITS) == blocks_.size()) {
+        blocks_.push_back(static_cast<Slot*>(::operator new(sizeof(Slot) * BLOCK_SLOTS)));
+    }
+    return used_++;
+}
+
+/**
+* Destroys the item in a slot and puts the slot on the free list.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::freeSlot(Index node)
+{
+    Slot& s = slot(node);
+    s.item().~Item();
+    s.left = freeHead_;
+    freeHead_ = node;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::subtreeSize(Index node) const
+{
+    return node == NIL ? 0 : slot(node).size;
+}
+
+/**
+* Recomputes the subtree size of node from the sizes of its children.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::updateSize(Index node)
+{
+    Slot& s = slot(node);
+    s.size = 1 + subtreeSize(s.left) + subtreeSize(s.right);
+}
+
+/**
+* Removes every item and hands the blocks back.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::clear()
+{
+    if (!std::is_trivially_destructible<Item>::value) {
+        for (Index node = leftmost(root_); node != NIL; node = successor(node)) {
+            //the links are not part of the item, so the walk can go on
+            slot(node).item().~Item();
+        }
+    }
+    for (std::size_t i = 0; i < blocks_.size(); ++i) {
+        ::operator delete(blocks_[i]);
+    }
+    blocks_.clear();
+    root_ = NIL;
+    used_ = 1;
+    freeHead_ = NIL;
+    size_ = 0;
+}
+
+/**
+* Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NIL;
+}
+
+/**
+* Returns the number of items in the tree
+*/
+template<class Key, class Value, class Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Return true iff the tree is height-balanced.
+*/
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return balanceHelper(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree at node, or -1 if it is not balanced.
+*/
+template<class Key, class Value, class Compare>
+int CompactAVLTree<Key, Value, Compare>::balanceHelper(Index node) const
+{
+    if (node == NIL) {
+        return 0;
+    }
+    int left = balanceHelper(slot(node).left);
+    int right = balanceHelper(slot(node).right);
+    if (left == -1 || right == -1 || left - right > 1 || right - left > 1) {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+/**
+* Returns the slot holding key, or NIL.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::findIndex(const Key& key) const
+{
+    Index current = root_;
+    while (current != NIL) {
+        Slot& s = slot(current);
+        if (comp_(key, s.item().first)) {
+            current = s.left;
+        }
+        else if (comp_(s.item().first, key)) {
+            current = s.right;
+        }
+        else {
+            return current;
+        }
+    }
+    return NIL;
+}
+
+/**
+* Returns the slot holding key if there is one. Otherwise returns NIL and
+* sets parent and isLeft to where a new node for key would be linked.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::findSlot(const Key& key, Index& parent, bool& isLeft) const
+{
+    Index current = root_;
+    while (current != NIL) {
+        Slot& s = slot(current);
+        parent = current;
+        if (comp_(key, s.item().first)) {
+            isLeft = true;
+            current = s.left;
+        }
+        else if (comp_(s.item().first, key)) {
+            isLeft = false;
+            current = s.right;
+        }
+        else {
+            return current;
+        }
+    }
+    return NIL;
+}
+
+/**
+* Returns the slot with the smallest key not less than key, or NIL.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::lowerBoundIndex(const Key& key) const
+{
+    Index best = NIL;
+    Index current = root_;
+    while (current != NIL) {
+        Slot& s = slot(current);
+        if (comp_(s.item().first, key)) {
+            current = s.right;
+        }
+        else {
+            best = current;
+            current = s.left;
+        }
+    }
+    return best;
+}
+
+/**
+* Returns the slot with the smallest key greater than key, or NIL.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::upperBoundIndex(const Key& key) const
+{
+    Index best = NIL;
+    Index current = root_;
+    while (current != NIL) {
+        Slot& s = slot(current);
+        if (comp_(key, s.item().first)) {
+            best = current;
+            current = s.left;
+        }
+        else {
+            current = s.right;
+        }
+    }
+    return best;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::leftmost(Index node) const
+{
+    if (node == NIL) {
+        return NIL;
+    }
+    while (slot(node).left != NIL) {
+        node = slot(node).left;
+    }
+    return node;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::rightmost(Index node) const
+{
+    if (node == NIL) {
+        return NIL;
+    }
+    while (slot(node).right != NIL) {
+        node = slot(node).right;
+    }
+    return node;
+}
+
+/**
+* Returns the slot after node in key order, or NIL.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::successor(Index node) const
+{
+    if (slot(node).right != NIL) {
+        return leftmost(slot(node).right);
+    }
+    //climb until we come up from a left child
+    Index parent = slot(node).parent();
+    while (parent != NIL && slot(parent).right == node) {
+        node = parent;
+        parent = slot(node).parent();
+    }
+    return parent;
+}
+
+/**
+* Returns the slot before node in key order, or NIL.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::predecessor(Index node) const
+{
+    if (slot(node).left != NIL) {
+        return rightmost(slot(node).left);
+    }
+    Index parent = slot(node).parent();
+    while (parent != NIL && slot(parent).left == node) {
+        node = parent;
+        parent = slot(node).parent();
+    }
+    return parent;
+}
+
+/**
+* An insert method to insert into the tree. If key is already in the tree,
+* its value is overwritten.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    Index parent = NIL;
+    bool isLeft = false;
+    Index existing = findSlot(keyValuePair.first, parent, isLeft);
+    if (existing != NIL) {
+        slot(existing).item().second = keyValuePair.second;
+        return;
+    }
+    Index node = allocateSlot();
+    new (&slot(node).storage) Item(keyValuePair.first, keyValuePair.second);
+    linkSlot(node, parent, isLeft);
+}
+
+/**
+* Inserts anything a pair can be built from, moving the key and value into
+* the new node. An existing key has its value overwritten (by move). Returns
+* an iterator to the item and whether a new node was created.
+*/
+template<class Key, class Value, class Compare>
+template<typename P, typename>
+std::pair<typename CompactAVLTree<Key, Value, Compare>::iterator, bool>
+CompactAVLTree<Key, Value, Compare>::insert(P&& keyValuePair)
+{
+    std::pair<Key, Value> item(std::forward<P>(keyValuePair));
+    Index parent = NIL;
+    bool isLeft = false;
+    Index existing = findSlot(item.first, parent, isLeft);
+    if (existing != NIL) {
+        slot(existing).item().second = std::move(item.second);
+        return std::make_pair(iterator(existing, this), false);
+    }
+    Index node = allocateSlot();
+    new (&slot(node).storage) Item(std::move(item.first), std::move(item.second));
+    linkSlot(node, parent, isLeft);
+    return std::make_pair(iterator(node, this), true);
+}
+
+/**
+* Makes a new node the child of parent on the side given by isLeft (or the
+* root when parent is NIL), counts it in the sizes of its ancestors and
+* rebalances.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::linkSlot(Index node, Index parent, bool isLeft)
+{
+    Slot& s = slot(node);
+    s.left = NIL;
+    s.right = NIL;
+    s.parentBalance = parent << 2;
+    s.setBalance(0);
+    s.size = 1;
+    if (parent == NIL) {
+        root_ = node;
+    }
+    else if (isLeft) {
+        slot(parent).left = node;
+    }
+    else {
+        slot(parent).right = node;
+    }
+    for (Index ancestor = parent; ancestor != NIL; ancestor = slot(ancestor).parent()) {
+        ++slot(ancestor).size;
+    }
+    ++size_;
+    insertFix(parent, node);
+}
+
+/**
+* Walks up from a subtree (child) that just grew taller. A parent that was
+* leaning the other way is now level and we are done; a level parent leans
+* and grows taller too, so we go on up; a parent that was already leaning
+* this way is rotated, which restores its old height.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::insertFix(Index parent, Index child)
+{
+    while (parent != NIL) {
+        Slot& p = slot(parent);
+        int balance = p.balance() + (p.left == child ? -1 : 1);
+        if (balance == 0) {
+            p.setBalance(0);
+            return;
+        }
+        if (balance == -1 || balance == 1) {
+            p.setBalance(balance);
+            child = parent;
+            parent = p.parent();
+            continue;
+        }
+        rebalance(parent, balance);
+        return;
+    }
+}
+
+/**
+* Walks up from node, one of whose subtrees (the left one if leftShorter)
+* just got shorter. A level node now leans and keeps its height, so we are
+* done; a leaning node levels out and got shorter, so we go on up; a node
+* that leaned the other way is rotated, which only keeps its height when the
+* taller child was level.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::removeFix(Index node, bool leftShorter)
+{
+    while (node != NIL) {
+        Slot& n = slot(node);
+        Index parent = n.parent();
+        bool nodeIsLeft = parent != NIL && slot(parent).left == node;
+        int balance = n.balance() + (leftShorter ? 1 : -1);
+        if (balance == -1 || balance == 1) {
+            n.setBalance(balance);
+            return;
+        }
+        if (balance == 0) {
+            n.setBalance(0);
+        }
+        else if (slot(rebalance(node, balance)).balance() != 0) {
+            return;
+        }
+        leftShorter = nodeIsLeft;
+        node = parent;
+    }
+}
+
+/**
+* Rotates node, whose balance has reached balance (-2 or 2), and returns the
+* node that took its place. The two balance bits cannot hold +-2, so the
+* balance is passed in rather than stored.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::Index
+CompactAVLTree<Key, Value, Compare>::rebalance(Index node, int balance)
+{
+    Slot& n = slot(node);
+    if (balance == -2) {
+        Index child = n.left;
+        Slot& c = slot(child);
+        int childBalance = c.balance();
+        //zig-zig case
+        if (childBalance <= 0) {
+            rotateRight(node);
+            n.setBalance(childBalance == 0 ? -1 : 0);
+            c.setBalance(childBalance == 0 ? 1 : 0);
+            return child;
+        }
+        //zig-zag case
+        Index grandchild = c.right;
+        Slot& g = slot(grandchild);
+        int grandchildBalance = g.balance();
+        rotateLeft(child);
+        rotateRight(node);
+        n.setBalance(grandchildBalance == -1 ? 1 : 0);
+        c.setBalance(grandchildBalance == 1 ? -1 : 0);
+        g.setBalance(0);
+        return grandchild;
+    }
+    else {
+        Index child = n.right;
+        Slot& c = slot(child);
+        int childBalance = c.balance();
+        //zig-zig case
+        if (childBalance >= 0) {
+            rotateLeft(node);
+            n.setBalance(childBalance == 0 ? 1 : 0);
+            c.setBalance(childBalance == 0 ? -1 : 0);
+            return child;
+        }
+        //zig-zag case
+        Index grandchild = c.left;
+        Slot& g = slot(grandchild);
+        int grandchildBalance = g.balance();
+        rotateRight(child);
+        rotateLeft(node);
+        n.setBalance(grandchildBalance == 1 ? -1 : 0);
+        c.setBalance(grandchildBalance == -1 ? 1 : 0);
+        g.setBalance(0);
+        return grandchild;
+    }
+}
+
+/**
+* Makes the left child of node its parent.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::rotateRight(Index node)
+{
+    Slot& n = slot(node);
+    Index child = n.left;
+    Slot& c = slot(child);
+
+    //child's right subtree moves across to node
+    n.left = c.right;
+    if (c.right != NIL) {
+        slot(c.right).setParent(node);
+    }
+    replaceChild(n.parent(), node, child);
+    c.right = node;
+    n.setParent(child);
+    updateSize(node);
+    updateSize(child);
+}
+
+/**
+* Makes the right child of node its parent.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::rotateLeft(Index node)
+{
+    Slot& n = slot(node);
+    Index child = n.right;
+    Slot& c = slot(child);
+
+    n.right = c.left;
+    if (c.left != NIL) {
+        slot(c.left).setParent(node);
+    }
+    replaceChild(n.parent(), node, child);
+    c.left = node;
+    n.setParent(child);
+    updateSize(node);
+    updateSize(child);
+}
+
+/**
+* Puts newChild (which may be NIL) where oldChild hangs from parent, or makes
+* it the root when parent is NIL.
+*/
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::replaceChild(Index parent, Index oldChild, Index newChild)
+{
+    if (parent == NIL) {
+        root_ = newChild;
+    }
+    else if (slot(parent).left == oldChild) {
+        slot(parent).left = newChild;
+    }
+    else {
+        slot(parent).right = newChild;
+    }
+    if (newChild != NIL) {
+        slot(newChild).setParent(parent);
+    }
+}
+
+/*
+ * If the node has 2 children it is replaced by its predecessor, which is
+ * unlinked from its own spot first. Slots are moved rather than items, so
+ * iterators to the predecessor stay valid.
+ */
+template<class Key, class Value, class Compare>
+void CompactAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    Index node = findIndex(key);
+    if (node == NIL) {
+        return;
+    }
+    Slot& n = slot(node);
+    //where the tree got shorter, and on which side
+    Index start;
+    bool leftShorter;
+
+    if (n.left != NIL && n.right != NIL) {
+        Index pred = rightmost(n.left);
+        Slot& p = slot(pred);
+        //unlink the predecessor, which has no right child
+        start = p.parent();
+        leftShorter = start == node;
+        replaceChild(start, pred, p.left);
+        //then give it node's place, links, balance and size
+        p.left = n.left;
+        p.right = n.right;
+        if (p.left != NIL) {
+            slot(p.left).setParent(pred);
+        }
+        slot(p.right).setParent(pred);
+        p.parentBalance = n.parentBalance;
+        p.size = n.size;
+        replaceChild(n.parent(), node, pred);
+        if (start == node) {
+            start = pred;
+        }
+    }
+    else {
+        Index child = n.left != NIL ? n.left : n.right;
+        start = n.parent();
+        leftShorter = start != NIL && slot(start).left == node;
+        replaceChild(start, node, child);
+    }
+
+    //every ancestor of the unlinked spot lost a node; rotations below recompute sizes from these
+    for (Index ancestor = start; ancestor != NIL; ancestor = slot(ancestor).parent()) {
+        --slot(ancestor).size;
+    }
+    removeFix(start, leftShorter);
+    freeSlot(node);
+    --size_;
+}
+
+/**
+* Returns an iterator to the item with the k-th smallest key (counting from
+* 0), or end() if the tree has k items or fewer.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::select(std::size_t k) const
+{
+    Index current = root_;
+    while (current != NIL) {
+        std::size_t leftSize = subtreeSize(slot(current).left);
+        if (k == leftSize) {
+            break;
+        }
+        if (k < leftSize) {
+            current = slot(current).left;
+        }
+        else {
+            //skip the left subtree and this node
+            k -= leftSize + 1;
+            current = slot(current).right;
+        }
+    }
+    return iterator(current, this);
+}
+
+/**
+* Returns the number of keys in the tree that are less than key.
+*/
+template<class Key, class Value, class Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::rank(const Key& key) const
+{
+    std::size_t less = 0;
+    Index current = root_;
+    while (current != NIL) {
+        Slot& s = slot(current);
+        if (comp_(s.item().first, key)) {
+            //this node and its whole left subtree come before key
+            less += subtreeSize(s.left) + 1;
+            current = s.right;
+        }
+        else {
+            current = s.left;
+        }
+    }
+    return less;
+}
+
+/**
+* Returns the number of keys k with lo <= k < hi.
+*/
+template<class Key, class Value, class Compare>
+std::size_t CompactAVLTree<Key, Value, Compare>::count_range(const Key& lo, const Key& hi) const
+{
+    if (!comp_(lo, hi)) {
+        return 0;
+    }
+    return rank(hi) - rank(lo);
+}
+
+/**
+* Returns an iterator to the first item in the tree.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::begin() const
+{
+    return iterator(leftmost(root_), this);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator(NIL, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    return iterator(findIndex(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return iterator(lowerBoundIndex(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return iterator(upperBoundIndex(key), this);
+}
+
+/**
+* Returns the comparator the tree is ordered by.
+*/
+template<class Key, class Value, class Compare>
+Compare CompactAVLTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value& CompactAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    Index node = findIndex(key);
+    if(node == NIL) throw std::out_of_range("Invalid key");
+    return slot(node).item().second;
+}
+template<class Key, class Value, class Compare>
+Value const & CompactAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    Index node = findIndex(key);
+    if(node == NIL) throw std::out_of_range("Invalid key");
+    return slot(node).item().second;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CompactAVLTree class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the CompactAVLTree::iterator class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator() : node_(NIL), tree_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+CompactAVLTree<Key, Value, Compare>::iterator::iterator(Index node, const CompactAVLTree<Key, Value, Compare>* tree) :
+    node_(node), tree_(tree)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> &
+CompactAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return tree_->slot(node_).item();
+}
+
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> *
+CompactAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(tree_->slot(node_).item());
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return node_ == rhs.node_;
+}
+
+template<class Key, class Value, class Compare>
+bool CompactAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return node_ != rhs.node_;
+}
+
+/**
+* Advances the iterator to the next item in key order.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    node_ = tree_->successor(node_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++*this;
+    return old;
+}
+
+/**
+* Moves the iterator to the previous item; end() moves to the largest.
+*/
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator&
+CompactAVLTree<Key, Value, Compare>::iterator::operator--()
+{
+    if (node_ == NIL) {
+        node_ = tree_->rightmost(tree_->root_);
+    }
+    else {
+        node_ = tree_->predecessor(node_);
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename CompactAVLTree<Key, Value, Compare>::iterator
+CompactAVLTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the CompactAVLTree::iterator class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,1161 @@
+#ifndef CONCURRENT_AVLBST_H
+#define CONCURRENT_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include "epoch_domain.h"
+
+/**
+* An ordered map for many reader threads and a few writers, after Bronson,
+* Casper, Chafi and Olukotun, "A Practical Concurrent Binary Search Tree"
+* (PPoPP 2010).
+*
+* Readers take no locks. Each node has a version that a rotation bumps
+* before and after it moves the node down, which is the only way a node can
+* lose keys from its subtree. A reader walks down hand over hand: it reads
+* a child and the child's version, then checks that the parent's version
+* has not changed since the parent was reached. If it has, the reader backs
+* up one level and tries again, instead of restarting from the root.
+*
+* Writers lock only the nodes they change, always parent before child:
+*   - insert links a new leaf under its locked parent, or replaces the
+*     value of a node that already has the key.
+*   - remove clears the value. A node with at most one child is then
+*     spliced out; one with two children stays as a routing node without
+*     a value until a later rotation leaves it with one child.
+*   - Heights are fixed on the way back up. A node out of balance is
+*     rotated with the same single and double AVL rotations that AVLTree
+*     uses, with the nodes involved locked.
+* Balance is relaxed while writes are in flight. Once they finish, the
+* tree is an AVL tree again.
+*
+* Unlinked nodes and replaced values are retired to an EpochDomain, which
+* frees them once no reader can still hold them. A value is kept in its
+* own immutable box, so readers can copy it while a writer swaps in
+* another. That is why find() and lower_bound() copy results out rather
+* than return iterators.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class ConcurrentAVLMap
+{
+public:
+    ConcurrentAVLMap();
+    explicit ConcurrentAVLMap(const Compare& comp);
+    ~ConcurrentAVLMap();
+
+    bool insert(const std::pair<const Key, Value>& keyValuePair);
+    bool remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    bool lower_bound(const Key& key, std::pair<Key, Value>& item) const;
+    std::size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+    Compare key_comp() const;
+
+protected:
+    struct ValueBox
+    {
+        Value value;
+
+        explicit ValueBox(const Value& v) : value(v) { }
+    };
+
+    struct TreeNode
+    {
+        // The key is raw storage, as the root holder has none
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keyStorage;
+        // NULL for a routing node, whose key is not in the map
+        std::atomic<const ValueBox*> value;
+        std::atomic<TreeNode*> parent;
+        std::atomic<TreeNode*> left;
+        std::atomic<TreeNode*> right;
+        std::atomic<int> height;
+        std::atomic<std::uint64_t> version;
+        std::atomic<bool> locked;
+        bool hasKey;
+
+        TreeNode();
+        TreeNode(const Key& key, const ValueBox* box, TreeNode* parentNode);
+        ~TreeNode();
+
+        const Key& key() const;
+        std::atomic<TreeNode*>& child(int dir);
+        void lock();
+        void unlock();
+    };
+
+    /**
+    * Holds a node's lock for its lifetime.
+    */
+    class NodeLock
+    {
+    public:
+        explicit NodeLock(TreeNode* node) : node_(node) { node_->lock(); }
+        ~NodeLock() { node_->unlock(); }
+
+    private:
+        NodeLock(const NodeLock&);
+        NodeLock& operator=(const NodeLock&);
+
+        TreeNode* node_;
+    };
+
+    // Versions: the low bit marks a node that has been unlinked, the next
+    // one a rotation in progress, and the rest count rotations
+    static const std::uint64_t UNLINKED = 1;
+    static const std::uint64_t SHRINKING = 2;
+
+    // Results of one attempt
+    enum { RETRY, FOUND, NOT_FOUND };
+    // What nodeCondition() reports other than a new height
+    enum { UNLINK_REQUIRED = -1, REBALANCE_REQUIRED = -2, NOTHING_REQUIRED = -3 };
+
+    static bool isChanging(std::uint64_t version);
+    static bool isUnlinked(std::uint64_t version);
+    static std::uint64_t beginChange(std::uint64_t version);
+    static std::uint64_t endChange(std::uint64_t version);
+    static void waitUntilChanged(TreeNode* node, std::uint64_t version);
+    static int height(TreeNode* node);
+
+    int findIn(TreeNode* node, std::uint64_t version, int dir, const Key& key, const ValueBox*& box) const;
+    int lowerBoundAt(TreeNode* node, std::uint64_t version, const Key& key, std::pair<Key, Value>& item) const;
+    int lowerBoundIn(TreeNode* node, std::uint64_t version, int dir, const Key& key, std::pair<Key, Value>& item) const;
+    int updateAt(TreeNode* parent, TreeNode* node, std::uint64_t version, const Key& key, const ValueBox* box, bool& changed);
+    int updateIn(TreeNode* node, std::uint64_t version, int dir, const Key& key, const ValueBox* box, bool& changed);
+    int updateNode(TreeNode* parent, TreeNode* node, const ValueBox* box, bool& changed);
+    bool unlinkLocked(TreeNode* parent, TreeNode* node);
+    int nodeCondition(TreeNode* node);
+    void fixHeightAndRebalance(TreeNode* node);
+    TreeNode* fixHeightLocked(TreeNode* node);
+    TreeNode* rebalanceLocked(TreeNode* parent, TreeNode* node);
+    TreeNode* rebalanceToRightLocked(TreeNode* parent, TreeNode* node, TreeNode* left, int rightHeight);
+    TreeNode* rebalanceToLeftLocked(TreeNode* parent, TreeNode* node, TreeNode* right, int leftHeight);
+    TreeNode* rotateRightLocked(TreeNode* parent, TreeNode* node, TreeNode* left, int rightHeight, int leftLeftHeight, TreeNode* leftRight, int leftRightHeight);
+    TreeNode* rotateLeftLocked(TreeNode* parent, TreeNode* node, TreeNode* right, int leftHeight, int rightRightHeight, TreeNode* rightLeft, int rightLeftHeight);
+    TreeNode* rotateRightOverLeftLocked(TreeNode* parent, TreeNode* node, TreeNode* left, int rightHeight, int leftLeftHeight, TreeNode* leftRight, int leftRightLeftHeight);
+    TreeNode* rotateLeftOverRightLocked(TreeNode* parent, TreeNode* node, TreeNode* right, int leftHeight, int rightRightHeight, TreeNode* rightLeft, int rightLeftRightHeight);
+    int compare(const Key& a, const Key& b) const;
+    void clearHelper(TreeNode* node);
+    int balanceHelper(TreeNode* node) const;
+
+private:
+    ConcurrentAVLMap(const ConcurrentAVLMap&);
+    ConcurrentAVLMap& operator=(const ConcurrentAVLMap&);
+
+protected:
+    // Its right child is the root. It never moves, so its version never
+    // changes and walks can start from it like from any other node.
+    TreeNode* holder_;
+    std::atomic<std::size_t> size_;
+    Compare comp_;
+    mutable EpochDomain epochs_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ConcurrentAVLMap::TreeNode class.
+  -----------------------------------------------
+*/
+
+/**
+* The root holder, which has no key.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLMap<Key, Value, Compare>::TreeNode::TreeNode() :
+    value(NULL), parent(NULL), left(NULL), right(NULL), height(1), version(0), locked(false), hasKey(false)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+ConcurrentAVLMap<Key, Value, Compare>::TreeNode::TreeNode(const Key& key, const ValueBox* box, TreeNode* parentNode) :
+    value(box), parent(parentNode), left(NULL), right(NULL), height(1), version(0), locked(false), hasKey(true)
+{
+    new (&keyStorage) Key(key);
+}
+
+/**
+* Destroys the key. The value box belongs to whoever took it out.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLMap<Key, Value, Compare>::TreeNode::~TreeNode()
+{
+    if (hasKey) {
+        reinterpret_cast<Key*>(&keyStorage)->~Key();
+    }
+}
+
+template<class Key, class Value, class Compare>
+const Key& ConcurrentAVLMap<Key, Value, Compare>::TreeNode::key() const
+{
+    return *reinterpret_cast<const Key*>(&keyStorage);
+}
+
+/**
+* Returns the left link for a negative dir and the right one otherwise.
+*/
+template<class Key, class Value, class Compare>
+std::atomic<typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*>&
+ConcurrentAVLMap<Key, Value, Compare>::TreeNode::child(int dir)
+{
+    return dir < 0 ? left : right;
+}
+
+/**
+* A spin lock, as node locks are held only for a few loads and stores.
+* It yields while it waits so that it also behaves with more threads than
+* cores.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLMap<Key, Value, Compare>::TreeNode::lock()
+{
+    while (locked.exchange(true, std::memory_order_acquire)) {
+        while (locked.load(std::memory_order_relaxed)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+template<class Key, class Value, class Compare>
+void ConcurrentAVLMap<Key, Value, Compare>::TreeNode::unlock()
+{
+    locked.store(false, std::memory_order_release);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ConcurrentAVLMap::TreeNode class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ConcurrentAVLMap class.
+  -----------------------------------------------
+*/
+
+/**
+* Default constructor for an empty ConcurrentAVLMap.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLMap<Key, Value, Compare>::ConcurrentAVLMap() : holder_(new TreeNode()), size_(0), comp_()
+{
+
+}
+
+/**
+* Constructor for an empty ConcurrentAVLMap ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLMap<Key, Value, Compare>::ConcurrentAVLMap(const Compare& comp) :
+    holder_(new TreeNode()), size_(0), comp_(comp)
+{
+
+}
+
+/**
+* Frees every node and value. No other thread may be using the map.
+* Retired ones are freed by the EpochDomain.
+*/
+template<class Key, class Value, class Compare>
+ConcurrentAVLMap<Key, Value, Compare>::~ConcurrentAVLMap()
+{
+    clearHelper(holder_->right.load());
+    delete holder_;
+}
+
+template<class Key, class Value, class Compare>
+void ConcurrentAVLMap<Key, Value, Compare>::clearHelper(TreeNode* node)
+{
+    if (node == NULL) {
+        return;
+    }
+    clearHelper(node->left.load());
+    clearHelper(node->right.load());
+    delete node->value.load();
+    delete node;
+}
+
+/**
+* Returns the number of items in the map. With writers running it may be
+* behind by the writes in flight.
+*/
+template<class Key, class Value, class Compare>
+std::size_t ConcurrentAVLMap<Key, Value, Compare>::size() const
+{
+    return size_.load();
+}
+
+/**
+* Returns true if the map is empty
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::empty() const
+{
+    return size() == 0;
+}
+
+/**
+* Returns the comparator the map is ordered by.
+*/
+template<class Key, class Value, class Compare>
+Compare ConcurrentAVLMap<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+* Return true iff the tree is height-balanced. Only meaningful while no
+* thread is writing.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::isBalanced() const
+{
+    return balanceHelper(holder_->right.load()) != -1;
+}
+
+/**
+* Returns the height of the subtree at node, or -1 if it is not balanced,
+* a stored height is wrong, or a routing node could have been spliced out.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::balanceHelper(TreeNode* node) const
+{
+    if (node == NULL) {
+        return 0;
+    }
+    int left = balanceHelper(node->left.load());
+    int right = balanceHelper(node->right.load());
+    if (left == -1 || right == -1 || left - right > 1 || right - left > 1 ||
+        node->height.load() != 1 + std::max(left, right) ||
+        (node->value.load() == NULL && (left == 0 || right == 0))) {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::compare(const Key& a, const Key& b) const
+{
+    return comp_(a, b) ? -1 : (comp_(b, a) ? 1 : 0);
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::isChanging(std::uint64_t version)
+{
+    return (version & (UNLINKED | SHRINKING)) != 0;
+}
+
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::isUnlinked(std::uint64_t version)
+{
+    return version == UNLINKED;
+}
+
+template<class Key, class Value, class Compare>
+std::uint64_t ConcurrentAVLMap<Key, Value, Compare>::beginChange(std::uint64_t version)
+{
+    return version | SHRINKING;
+}
+
+/**
+* Clears SHRINKING and counts the rotation, so a reader that saw the old
+* version can tell the node has moved.
+*/
+template<class Key, class Value, class Compare>
+std::uint64_t ConcurrentAVLMap<Key, Value, Compare>::endChange(std::uint64_t version)
+{
+    return (version | SHRINKING) + SHRINKING;
+}
+
+/**
+* Waits out a rotation of node that was in progress at version.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLMap<Key, Value, Compare>::waitUntilChanged(TreeNode* node, std::uint64_t version)
+{
+    if (isUnlinked(version)) {
+        return;
+    }
+    while (node->version.load() == version) {
+        std::this_thread::yield();
+    }
+}
+
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::height(TreeNode* node)
+{
+    return node == NULL ? 0 : node->height.load();
+}
+
+/**
+* Copies the value for key into value and returns true, or returns false if
+* key is not in the map. Takes no locks.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::find(const Key& key, Value& value) const
+{
+    EpochDomain::Guard guard(epochs_);
+    const ValueBox* box = NULL;
+    while (findIn(holder_, 0, 1, key, box) == RETRY) {
+
+    }
+    if (box == NULL) {
+        return false;
+    }
+    value = box->value;
+    return true;
+}
+
+/**
+* Returns true if key is in the map. Takes no locks.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::contains(const Key& key) const
+{
+    EpochDomain::Guard guard(epochs_);
+    const ValueBox* box = NULL;
+    while (findIn(holder_, 0, 1, key, box) == RETRY) {
+
+    }
+    return box != NULL;
+}
+
+/**
+* Looks for key below node, which was reached at version, on the side dir.
+* Sets box to the value found (NULL if there is none) or returns RETRY if
+* node has been rotated since, so the caller must go back a level.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::findIn(TreeNode* node, std::uint64_t version, int dir, const Key& key, const ValueBox*& box) const
+{
+    while (true) {
+        TreeNode* child = node->child(dir).load();
+        if (child == NULL) {
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+            box = NULL;
+            return NOT_FOUND;
+        }
+        int order = compare(key, child->key());
+        if (order == 0) {
+            //removing the key clears the value before anything else, so
+            //what is read here was the value at some point during the call
+            box = child->value.load();
+            return FOUND;
+        }
+        std::uint64_t childVersion = child->version.load();
+        if (isChanging(childVersion)) {
+            waitUntilChanged(child, childVersion);
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+        }
+        else if (child != node->child(dir).load()) {
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+        }
+        else {
+            //child was node's child while node was still where we found it
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+            if (findIn(child, childVersion, order, key, box) != RETRY) {
+                return box == NULL ? NOT_FOUND : FOUND;
+            }
+        }
+    }
+}
+
+/**
+* Copies the item with the smallest key not less than key into item and
+* returns true, or returns false if there is none. Takes no locks. Each
+* subtree is checked as for find(), but items added or removed in other
+* parts of the map during the call may or may not be seen.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::lower_bound(const Key& key, std::pair<Key, Value>& item) const
+{
+    EpochDomain::Guard guard(epochs_);
+    int result = RETRY;
+    do {
+        result = lowerBoundIn(holder_, 0, 1, key, item);
+    } while (result == RETRY);
+    return result == FOUND;
+}
+
+/**
+* The lower bound of key within the subtree at node, which was reached at
+* version: the left subtree first if node's key is not less than key, then
+* node itself if it holds a value, then the right subtree.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::lowerBoundAt(TreeNode* node, std::uint64_t version, const Key& key, std::pair<Key, Value>& item) const
+{
+    if (comp_(node->key(), key)) {
+        return lowerBoundIn(node, version, 1, key, item);
+    }
+    int result = lowerBoundIn(node, version, -1, key, item);
+    if (result != NOT_FOUND) {
+        return result;
+    }
+    const ValueBox* box = node->value.load();
+    if (box != NULL) {
+        item = std::pair<Key, Value>(node->key(), box->value);
+        return FOUND;
+    }
+    return lowerBoundIn(node, version, 1, key, item);
+}
+
+/**
+* Descends from node, which was reached at version, to its child on the
+* side dir with the same checks as findIn().
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::lowerBoundIn(TreeNode* node, std::uint64_t version, int dir, const Key& key, std::pair<Key, Value>& item) const
+{
+    while (true) {
+        TreeNode* child = node->child(dir).load();
+        if (child == NULL) {
+            return node->version.load() != version ? RETRY : NOT_FOUND;
+        }
+        std::uint64_t childVersion = child->version.load();
+        if (isChanging(childVersion)) {
+            waitUntilChanged(child, childVersion);
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+        }
+        else if (child != node->child(dir).load()) {
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+        }
+        else {
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+            int result = lowerBoundAt(child, childVersion, key, item);
+            if (result != RETRY) {
+                return result;
+            }
+        }
+    }
+}
+
+/**
+* An insert method to insert into the map. If key is already in the map,
+* its value is replaced. Returns true if the key is new.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    EpochDomain::Guard guard(epochs_);
+    const ValueBox* box = new ValueBox(keyValuePair.second);
+    bool changed = false;
+    while (updateIn(holder_, 0, 1, keyValuePair.first, box, changed) == RETRY) {
+
+    }
+    if (changed) {
+        ++size_;
+    }
+    return changed;
+}
+
+/**
+* Removes the item with the specified key, returning true if it was there.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::remove(const Key& key)
+{
+    EpochDomain::Guard guard(epochs_);
+    bool changed = false;
+    while (updateIn(holder_, 0, 1, key, NULL, changed) == RETRY) {
+
+    }
+    if (changed) {
+        --size_;
+    }
+    return changed;
+}
+
+/**
+* Updates key at or below node, which was reached from parent at version.
+* A NULL box removes the key; otherwise box becomes its value.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::updateAt(TreeNode* parent, TreeNode* node, std::uint64_t version, const Key& key, const ValueBox* box, bool& changed)
+{
+    int order = compare(key, node->key());
+    if (order == 0) {
+        return updateNode(parent, node, box, changed);
+    }
+    return updateIn(node, version, order, key, box, changed);
+}
+
+/**
+* Walks from node, which was reached at version, to the side dir, as
+* findIn() does. If the key is not there, a new leaf is linked under node
+* while it is locked.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::updateIn(TreeNode* node, std::uint64_t version, int dir, const Key& key, const ValueBox* box, bool& changed)
+{
+    while (true) {
+        TreeNode* child = node->child(dir).load();
+        if (node->version.load() != version) {
+            return RETRY;
+        }
+        if (child == NULL) {
+            if (box == NULL) {
+                //nothing to remove
+                changed = false;
+                return FOUND;
+            }
+            TreeNode* damaged = NULL;
+            {
+                NodeLock lock(node);
+                //with node locked no rotation can move it any more
+                if (node->version.load() != version) {
+                    return RETRY;
+                }
+                if (node->child(dir).load() == NULL) {
+                    node->child(dir).store(new TreeNode(key, box, node));
+                    changed = true;
+                    damaged = fixHeightLocked(node);
+                }
+            }
+            if (changed) {
+                fixHeightAndRebalance(damaged);
+                return FOUND;
+            }
+            //lost a race with another insert here, so look again
+            continue;
+        }
+        std::uint64_t childVersion = child->version.load();
+        if (isChanging(childVersion)) {
+            waitUntilChanged(child, childVersion);
+        }
+        else if (child == node->child(dir).load()) {
+            if (node->version.load() != version) {
+                return RETRY;
+            }
+            if (updateAt(node, child, childVersion, key, box, changed) != RETRY) {
+                return FOUND;
+            }
+        }
+    }
+}
+
+/**
+* Replaces or clears the value of node, which holds the key and was
+* reached from parent. A node left with no value and at most one child is
+* spliced out, which needs parent locked as well.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::updateNode(TreeNode* parent, TreeNode* node, const ValueBox* box, bool& changed)
+{
+    if (box == NULL && node->value.load() == NULL) {
+        changed = false;
+        return FOUND;
+    }
+    if (box == NULL && (node->left.load() == NULL || node->right.load() == NULL)) {
+        TreeNode* damaged = NULL;
+        const ValueBox* old = NULL;
+        {
+            NodeLock parentLock(parent);
+            if (isUnlinked(parent->version.load()) || node->parent.load() != parent) {
+                return RETRY;
+            }
+            NodeLock nodeLock(node);
+            old = node->value.load();
+            if (old == NULL) {
+                changed = false;
+                return FOUND;
+            }
+            if (!unlinkLocked(parent, node)) {
+                return RETRY;
+            }
+            damaged = fixHeightLocked(parent);
+        }
+        changed = true;
+        epochs_.retire(const_cast<ValueBox*>(old));
+        fixHeightAndRebalance(damaged);
+        return FOUND;
+    }
+
+    const ValueBox* old = NULL;
+    {
+        NodeLock nodeLock(node);
+        if (isUnlinked(node->version.load())) {
+            return RETRY;
+        }
+        //a remove that can now splice the node out goes round again
+        if (box == NULL && (node->left.load() == NULL || node->right.load() == NULL)) {
+            return RETRY;
+        }
+        old = node->value.load();
+        node->value.store(box);
+    }
+    changed = box != NULL ? old == NULL : old != NULL;
+    if (old != NULL) {
+        epochs_.retire(const_cast<ValueBox*>(old));
+    }
+    return FOUND;
+}
+
+/**
+* Splices node, which has at most one child and no value, or whose value
+* the caller is removing, out from under parent. Both are locked. Returns
+* false if the tree has changed so that it cannot be done. The node is
+* retired, with its value cleared.
+*/
+template<class Key, class Value, class Compare>
+bool ConcurrentAVLMap<Key, Value, Compare>::unlinkLocked(TreeNode* parent, TreeNode* node)
+{
+    TreeNode* parentLeft = parent->left.load();
+    TreeNode* parentRight = parent->right.load();
+    if (parentLeft != node && parentRight != node) {
+        return false;
+    }
+    TreeNode* left = node->left.load();
+    TreeNode* right = node->right.load();
+    if (left != NULL && right != NULL) {
+        return false;
+    }
+    TreeNode* splice = left != NULL ? left : right;
+    node->value.store(NULL);
+    if (parentLeft == node) {
+        parent->left.store(splice);
+    }
+    else {
+        parent->right.store(splice);
+    }
+    if (splice != NULL) {
+        splice->parent.store(parent);
+    }
+    node->version.store(UNLINKED);
+    epochs_.retire(node);
+    return true;
+}
+
+/**
+* Returns what node needs: UNLINK_REQUIRED for a routing node with at most
+* one child, REBALANCE_REQUIRED if its children differ in height by more
+* than one, its correct height if the stored one is wrong, or else
+* NOTHING_REQUIRED. It reads without locks, so the answer may be stale.
+*/
+template<class Key, class Value, class Compare>
+int ConcurrentAVLMap<Key, Value, Compare>::nodeCondition(TreeNode* node)
+{
+    TreeNode* left = node->left.load();
+    TreeNode* right = node->right.load();
+    if ((left == NULL || right == NULL) && node->value.load() == NULL) {
+        return UNLINK_REQUIRED;
+    }
+    int nodeHeight = node->height.load();
+    int leftHeight = height(left);
+    int rightHeight = height(right);
+    int newHeight = 1 + std::max(leftHeight, rightHeight);
+    int balance = leftHeight - rightHeight;
+    if (balance < -1 || balance > 1) {
+        return REBALANCE_REQUIRED;
+    }
+    return nodeHeight != newHeight ? newHeight : NOTHING_REQUIRED;
+}
+
+/**
+* Repairs node and the nodes above it, taking the locks each step needs,
+* until a step leaves nothing for this thread to fix.
+*/
+template<class Key, class Value, class Compare>
+void ConcurrentAVLMap<Key, Value, Compare>::fixHeightAndRebalance(TreeNode* node)
+{
+    while (node != NULL && node->parent.load() != NULL) {
+        int condition = nodeCondition(node);
+        if (condition == NOTHING_REQUIRED || isUnlinked(node->version.load())) {
+            return;
+        }
+        if (condition != UNLINK_REQUIRED && condition != REBALANCE_REQUIRED) {
+            NodeLock lock(node);
+            node = fixHeightLocked(node);
+        }
+        else {
+            TreeNode* parent = node->parent.load();
+            NodeLock parentLock(parent);
+            if (!isUnlinked(parent->version.load()) && node->parent.load() == parent) {
+                NodeLock nodeLock(node);
+                node = rebalanceLocked(parent, node);
+            }
+            //else the parent changed under us, so look at node again
+        }
+    }
+}
+
+/**
+* Fixes the height of node, which is locked, and returns the next node that
+* may need fixing (its parent, or node itself if it needs a rotation or an
+* unlink), or NULL if nothing above has changed.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::fixHeightLocked(TreeNode* node)
+{
+    int condition = nodeCondition(node);
+    if (condition == REBALANCE_REQUIRED || condition == UNLINK_REQUIRED) {
+        return node;
+    }
+    if (condition == NOTHING_REQUIRED) {
+        return NULL;
+    }
+    node->height.store(condition);
+    return node->parent.load();
+}
+
+/**
+* Splices out, rotates or fixes the height of node under parent, both
+* locked. Returns the next node that needs work, or NULL.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rebalanceLocked(TreeNode* parent, TreeNode* node)
+{
+    TreeNode* left = node->left.load();
+    TreeNode* right = node->right.load();
+    if ((left == NULL || right == NULL) && node->value.load() == NULL) {
+        if (unlinkLocked(parent, node)) {
+            return fixHeightLocked(parent);
+        }
+        return node;
+    }
+    int nodeHeight = node->height.load();
+    int leftHeight = height(left);
+    int rightHeight = height(right);
+    int newHeight = 1 + std::max(leftHeight, rightHeight);
+    int balance = leftHeight - rightHeight;
+    if (balance > 1) {
+        return rebalanceToRightLocked(parent, node, left, rightHeight);
+    }
+    if (balance < -1) {
+        return rebalanceToLeftLocked(parent, node, right, leftHeight);
+    }
+    if (newHeight != nodeHeight) {
+        node->height.store(newHeight);
+        return fixHeightLocked(parent);
+    }
+    return NULL;
+}
+
+/**
+* node's left subtree is too tall: rotate right, first rotating left at the
+* left child if its inner subtree is the taller. The left child (and its
+* right child for a double rotation) are locked too.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rebalanceToRightLocked(TreeNode* parent, TreeNode* node, TreeNode* left, int rightHeight)
+{
+    NodeLock leftLock(left);
+    int leftHeight = left->height.load();
+    if (leftHeight - rightHeight <= 1) {
+        return node;
+    }
+    TreeNode* leftRight = left->right.load();
+    int leftLeftHeight = height(left->left.load());
+    int leftRightHeight = height(leftRight);
+    if (leftLeftHeight >= leftRightHeight) {
+        return rotateRightLocked(parent, node, left, rightHeight, leftLeftHeight, leftRight, leftRightHeight);
+    }
+    {
+        NodeLock leftRightLock(leftRight);
+        leftRightHeight = leftRight->height.load();
+        if (leftLeftHeight >= leftRightHeight) {
+            return rotateRightLocked(parent, node, left, rightHeight, leftLeftHeight, leftRight, leftRightHeight);
+        }
+        TreeNode* leftRightLeft = leftRight->left.load();
+        int leftRightLeftHeight = height(leftRightLeft);
+        int balance = leftLeftHeight - leftRightLeftHeight;
+        if (balance >= -1 && balance <= 1) {
+            if (!((leftLeftHeight == 0 || leftRightLeftHeight == 0) && left->value.load() == NULL)) {
+                return rotateRightOverLeftLocked(parent, node, left, rightHeight, leftLeftHeight, leftRight, leftRightLeftHeight);
+            }
+            //the double rotation would leave the left child a routing node
+            //short of a child, so only do its first half, which leaves it
+            //the same way but below leftRight, ready to be spliced out
+            return rotateLeftLocked(node, left, leftRight, leftLeftHeight, height(leftRight->right.load()), leftRightLeft, leftRightLeftHeight);
+        }
+    }
+    //fix the left child on its own first; node is rebalanced later
+    return rebalanceToLeftLocked(node, left, leftRight, leftLeftHeight);
+}
+
+/**
+* The mirror image of rebalanceToRightLocked().
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rebalanceToLeftLocked(TreeNode* parent, TreeNode* node, TreeNode* right, int leftHeight)
+{
+    NodeLock rightLock(right);
+    int rightHeight = right->height.load();
+    if (leftHeight - rightHeight >= -1) {
+        return node;
+    }
+    TreeNode* rightLeft = right->left.load();
+    int rightRightHeight = height(right->right.load());
+    int rightLeftHeight = height(rightLeft);
+    if (rightRightHeight >= rightLeftHeight) {
+        return rotateLeftLocked(parent, node, right, leftHeight, rightRightHeight, rightLeft, rightLeftHeight);
+    }
+    {
+        NodeLock rightLeftLock(rightLeft);
+        rightLeftHeight = rightLeft->height.load();
+        if (rightRightHeight >= rightLeftHeight) {
+            return rotateLeftLocked(parent, node, right, leftHeight, rightRightHeight, rightLeft, rightLeftHeight);
+        }
+        TreeNode* rightLeftRight = rightLeft->right.load();
+        int rightLeftRightHeight = height(rightLeftRight);
+        int balance = rightRightHeight - rightLeftRightHeight;
+        if (balance >= -1 && balance <= 1) {
+            if (!((rightRightHeight == 0 || rightLeftRightHeight == 0) && right->value.load() == NULL)) {
+                return rotateLeftOverRightLocked(parent, node, right, leftHeight, rightRightHeight, rightLeft, rightLeftRightHeight);
+            }
+            return rotateRightLocked(node, right, rightLeft, rightRightHeight, height(rightLeft->left.load()), rightLeftRight, rightLeftRightHeight);
+        }
+    }
+    return rebalanceToRightLocked(node, right, rightLeft, rightRightHeight);
+}
+
+/**
+* Rotates left up into node's place under parent. node's version is marked
+* for the whole change, as node is the one that moves down. Returns the
+* deepest node still damaged, fixing parent's height if nothing else is.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rotateRightLocked(TreeNode* parent, TreeNode* node, TreeNode* left, int rightHeight, int leftLeftHeight, TreeNode* leftRight, int leftRightHeight)
+{
+    std::uint64_t version = node->version.load();
+    int oldHeight = node->height.load();
+    TreeNode* parentLeft = parent->left.load();
+    node->version.store(beginChange(version));
+
+    node->left.store(leftRight);
+    if (leftRight != NULL) {
+        leftRight->parent.store(node);
+    }
+    left->right.store(node);
+    node->parent.store(left);
+    if (parentLeft == node) {
+        parent->left.store(left);
+    }
+    else {
+        parent->right.store(left);
+    }
+    left->parent.store(parent);
+
+    int nodeHeight = 1 + std::max(leftRightHeight, rightHeight);
+    node->height.store(nodeHeight);
+    int nodeBalance = leftRightHeight - rightHeight;
+    bool nodeDamaged = nodeBalance < -1 || nodeBalance > 1 ||
+        ((leftRight == NULL || rightHeight == 0) && node->value.load() == NULL);
+    //while node still needs work, left keeps the height parent has seen;
+    //repairing node reaches left and carries the change on up from there
+    left->height.store(nodeDamaged ? oldHeight : 1 + std::max(leftLeftHeight, nodeHeight));
+    node->version.store(endChange(version));
+
+    if (nodeDamaged) {
+        return node;
+    }
+    int leftBalance = leftLeftHeight - nodeHeight;
+    if (leftBalance < -1 || leftBalance > 1) {
+        return left;
+    }
+    if (leftLeftHeight == 0 && left->value.load() == NULL) {
+        return left;
+    }
+    return fixHeightLocked(parent);
+}
+
+/**
+* The mirror image of rotateRightLocked().
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rotateLeftLocked(TreeNode* parent, TreeNode* node, TreeNode* right, int leftHeight, int rightRightHeight, TreeNode* rightLeft, int rightLeftHeight)
+{
+    std::uint64_t version = node->version.load();
+    int oldHeight = node->height.load();
+    TreeNode* parentLeft = parent->left.load();
+    node->version.store(beginChange(version));
+
+    node->right.store(rightLeft);
+    if (rightLeft != NULL) {
+        rightLeft->parent.store(node);
+    }
+    right->left.store(node);
+    node->parent.store(right);
+    if (parentLeft == node) {
+        parent->left.store(right);
+    }
+    else {
+        parent->right.store(right);
+    }
+    right->parent.store(parent);
+
+    int nodeHeight = 1 + std::max(leftHeight, rightLeftHeight);
+    node->height.store(nodeHeight);
+    int nodeBalance = rightLeftHeight - leftHeight;
+    bool nodeDamaged = nodeBalance < -1 || nodeBalance > 1 ||
+        ((rightLeft == NULL || leftHeight == 0) && node->value.load() == NULL);
+    right->height.store(nodeDamaged ? oldHeight : 1 + std::max(nodeHeight, rightRightHeight));
+    node->version.store(endChange(version));
+
+    if (nodeDamaged) {
+        return node;
+    }
+    int rightBalance = rightRightHeight - nodeHeight;
+    if (rightBalance < -1 || rightBalance > 1) {
+        return right;
+    }
+    if (rightRightHeight == 0 && right->value.load() == NULL) {
+        return right;
+    }
+    return fixHeightLocked(parent);
+}
+
+/**
+* A double rotation: leftRight comes up into node's place, with left and
+* node as its children. Both left and node move down, so both versions are
+* marked.
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rotateRightOverLeftLocked(TreeNode* parent, TreeNode* node, TreeNode* left, int rightHeight, int leftLeftHeight, TreeNode* leftRight, int leftRightLeftHeight)
+{
+    std::uint64_t version = node->version.load();
+    std::uint64_t leftVersion = left->version.load();
+    int oldHeight = node->height.load();
+    TreeNode* parentLeft = parent->left.load();
+    TreeNode* leftRightLeft = leftRight->left.load();
+    TreeNode* leftRightRight = leftRight->right.load();
+    int leftRightRightHeight = height(leftRightRight);
+    node->version.store(beginChange(version));
+    left->version.store(beginChange(leftVersion));
+
+    left->right.store(leftRightLeft);
+    if (leftRightLeft != NULL) {
+        leftRightLeft->parent.store(left);
+    }
+    node->left.store(leftRightRight);
+    if (leftRightRight != NULL) {
+        leftRightRight->parent.store(node);
+    }
+    leftRight->right.store(node);
+    node->parent.store(leftRight);
+    leftRight->left.store(left);
+    left->parent.store(leftRight);
+    if (parentLeft == node) {
+        parent->left.store(leftRight);
+    }
+    else {
+        parent->right.store(leftRight);
+    }
+    leftRight->parent.store(parent);
+
+    int nodeHeight = 1 + std::max(leftRightRightHeight, rightHeight);
+    node->height.store(nodeHeight);
+    int leftNewHeight = 1 + std::max(leftLeftHeight, leftRightLeftHeight);
+    left->height.store(leftNewHeight);
+    int nodeBalance = leftRightRightHeight - rightHeight;
+    bool nodeDamaged = nodeBalance < -1 || nodeBalance > 1 ||
+        ((leftRightRight == NULL || rightHeight == 0) && node->value.load() == NULL);
+    leftRight->height.store(nodeDamaged ? oldHeight : 1 + std::max(leftNewHeight, nodeHeight));
+    node->version.store(endChange(version));
+    left->version.store(endChange(leftVersion));
+
+    if (nodeDamaged) {
+        return node;
+    }
+    int topBalance = leftNewHeight - nodeHeight;
+    if (topBalance < -1 || topBalance > 1) {
+        return leftRight;
+    }
+    return fixHeightLocked(parent);
+}
+
+/**
+* The mirror image of rotateRightOverLeftLocked().
+*/
+template<class Key, class Value, class Compare>
+typename ConcurrentAVLMap<Key, Value, Compare>::TreeNode*
+ConcurrentAVLMap<Key, Value, Compare>::rotateLeftOverRightLocked(TreeNode* parent, TreeNode* node, TreeNode* right, int leftHeight, int rightRightHeight, TreeNode* rightLeft, int rightLeftRightHeight)
+{
+    std::uint64_t version = node->version.load();
+    std::uint64_t rightVersion = right->version.load();
+    int oldHeight = node->height.load();
+    TreeNode* parentLeft = parent->left.load();
+    TreeNode* rightLeftLeft = rightLeft->left.load();
+    TreeNode* rightLeftRight = rightLeft->right.load();
+    int rightLeftLeftHeight = height(rightLeftLeft);
+    node->version.store(beginChange(version));
+    right->version.store(beginChange(rightVersion));
+
+    node->right.store(rightLeftLeft);
+    if (rightLeftLeft != NULL) {
+        rightLeftLeft->parent.store(node);
+    }
+    right->left.store(rightLeftRight);
+    if (rightLeftRight != NULL) {
+        rightLeftRight->parent.store(right);
+    }
+    rightLeft->right.store(right);
+    right->parent.store(rightLeft);
+    rightLeft->left.store(node);
+    node->parent.store(rightLeft);
+    if (parentLeft == node) {
+        parent->left.store(rightLeft);
+    }
+    else {
+        parent->right.store(rightLeft);
+    }
+    rightLeft->parent.store(parent);
+
+    int nodeHeight = 1 + std::max(leftHeight, rightLeftLeftHeight);
+    node->height.store(nodeHeight);
+    int rightNewHeight = 1 + std::max(rightLeftRightHeight, rightRightHeight);
+    right->height.store(rightNewHeight);
+    int nodeBalance = rightLeftLeftHeight - leftHeight;
+    bool nodeDamaged = nodeBalance < -1 || nodeBalance > 1 ||
+        ((rightLeftLeft == NULL || leftHeight == 0) && node->value.load() == NULL);
+    rightLeft->height.store(nodeDamaged ? oldHeight : 1 + std::max(nodeHeight, rightNewHeight));
+    node->version.store(endChange(version));
+    right->version.store(endChange(rightVersion));
+
+    if (nodeDamaged) {
+        return node;
+    }
+    int topBalance = rightNewHeight - nodeHeight;
+    if (topBalance < -1 || topBalance > 1) {
+        return rightLeft;
+    }
+    return fixHeightLocked(parent);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ConcurrentAVLMap class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,232 @@
+#ifndef EPOCH_DOMAIN_H
+#define EPOCH_DOMAIN_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* Epoch-based reclamation, for structures that readers walk without taking
+* locks, such as ConcurrentAVLMap. A writer that unlinks an object cannot
+* free it at once, because a reader may still be looking at it. So it
+* retires the object instead, and the object is freed once every thread
+* that might have seen it has moved on.
+*
+* Every operation on the structure runs inside a Guard. The guard claims a
+* slot and shows the global epoch in it for as long as it lives. The epoch
+* only advances when every claimed slot shows the current one. Objects
+* retired in epoch e are freed once the epoch reaches e + 2: by then every
+* guard that was alive when they were unlinked has ended.
+*
+* Guards are cheap (one compare-and-swap in and one store out) and may be
+* held by any number of threads at once. Retiring takes a mutex, which is
+* meant for structures with few writers.
+*/
+class EpochDomain
+{
+public:
+    EpochDomain();
+    ~EpochDomain();
+
+    /**
+    * Marks the calling thread as inside the structure for its lifetime.
+    */
+    class Guard
+    {
+    public:
+        explicit Guard(EpochDomain& domain);
+        ~Guard();
+
+    private:
+        Guard(const Guard&);
+        Guard& operator=(const Guard&);
+
+        EpochDomain& domain_;
+        std::size_t slot_;
+    };
+
+    template<typename T>
+    void retire(T* object);
+
+private:
+    EpochDomain(const EpochDomain&);
+    EpochDomain& operator=(const EpochDomain&);
+
+    struct Retired
+    {
+        void* object;
+        void (*destroy)(void*);
+        std::uint64_t epoch;
+    };
+
+    // One per cache line, so that threads entering and leaving do not
+    // slow each other down; 0 means the slot is free
+    struct Slot
+    {
+        std::atomic<std::uint64_t> epoch;
+        char padding[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+    template<typename T>
+    static void destroyObject(void* object);
+    std::size_t enter();
+    void leave(std::size_t slot);
+    void retireObject(void* object, void (*destroy)(void*));
+    void reclaim();
+
+    static const std::size_t SLOTS = 128;
+    // Retirements between attempts to advance the epoch and free objects
+    static const std::size_t RECLAIM_EVERY = 64;
+
+    Slot slots_[SLOTS];
+    // Starts at 2, so that epoch - 2 never wraps
+    std::atomic<std::uint64_t> epoch_;
+    std::mutex mutex_;
+    std::vector<Retired> retired_;
+    std::size_t sinceReclaim_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the EpochDomain class.
+  -----------------------------------------------
+*/
+
+inline EpochDomain::EpochDomain() : epoch_(2), sinceReclaim_(0)
+{
+    for (std::size_t i = 0; i < SLOTS; ++i) {
+        slots_[i].epoch.store(0);
+    }
+}
+
+/**
+* Frees everything still retired. No guard may be alive by now.
+*/
+inline EpochDomain::~EpochDomain()
+{
+    for (std::size_t i = 0; i < retired_.size(); ++i) {
+        retired_[i].destroy(retired_[i].object);
+    }
+}
+
+/**
+* Hands object, which must already be unreachable for new readers, over to
+* be deleted once no reader can still hold it.
+*/
+template<typename T>
+void EpochDomain::retire(T* object)
+{
+    retireObject(object, &EpochDomain::destroyObject<T>);
+}
+
+template<typename T>
+void EpochDomain::destroyObject(void* object)
+{
+    delete static_cast<T*>(object);
+}
+
+inline void EpochDomain::retireObject(void* object, void (*destroy)(void*))
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Retired retired = { object, destroy, epoch_.load() };
+    retired_.push_back(retired);
+    if (++sinceReclaim_ >= RECLAIM_EVERY) {
+        sinceReclaim_ = 0;
+        reclaim();
+    }
+}
+
+/**
+* Advances the epoch if every guard has seen the current one, then frees
+* what was retired two or more epochs ago. Called with the mutex held, so
+* only one thread ever advances the epoch.
+*/
+inline void EpochDomain::reclaim()
+{
+    std::uint64_t epoch = epoch_.load();
+    bool behind = false;
+    for (std::size_t i = 0; i < SLOTS && !behind; ++i) {
+        std::uint64_t seen = slots_[i].epoch.load();
+        behind = seen != 0 && seen != epoch;
+    }
+    if (!behind) {
+        epoch_.store(++epoch);
+    }
+
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < retired_.size(); ++i) {
+        if (retired_[i].epoch + 2 <= epoch) {
+            retired_[i].destroy(retired_[i].object);
+        }
+        else {
+            retired_[kept++] = retired_[i];
+        }
+    }
+    retired_.resize(kept);
+}
+
+/**
+* Claims a free slot, starting from one picked by the thread's id, and
+* shows the current epoch in it. The epoch may move on between reading it
+* and publishing it, so it is read again until the slot is up to date.
+*/
+inline std::size_t EpochDomain::enter()
+{
+    std::size_t start = std::hash<std::thread::id>()(std::this_thread::get_id());
+    for (std::size_t i = 0; ; ++i) {
+        std::size_t slot = (start + i) % SLOTS;
+        std::uint64_t epoch = epoch_.load();
+        std::uint64_t free = 0;
+        if (slots_[slot].epoch.load(std::memory_order_relaxed) == 0 &&
+            slots_[slot].epoch.compare_exchange_strong(free, epoch)) {
+            for (std::uint64_t now = epoch_.load(); now != epoch; now = epoch_.load()) {
+                epoch = now;
+                slots_[slot].epoch.store(epoch);
+            }
+            return slot;
+        }
+        //every slot is taken, so let another thread finish
+        if (i % SLOTS == SLOTS - 1) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+inline void EpochDomain::leave(std::size_t slot)
+{
+    slots_[slot].epoch.store(0, std::memory_order_release);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the EpochDomain class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the EpochDomain::Guard class.
+  -----------------------------------------------
+*/
+
+inline EpochDomain::Guard::Guard(EpochDomain& domain) : domain_(domain), slot_(domain.enter())
+{
+
+}
+
+inline EpochDomain::Guard::~Guard()
+{
+    domain_.leave(slot_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the EpochDomain::Guard class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,280 @@
+#ifndef FROZEN_BST_H
+#define FROZEN_BST_H
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+* Index arithmetic for a complete binary tree stored in Eytzinger (BFS)
+* order, shared by FrozenTree and MappedTreeView. Indices are 1-based: the
+* root is 1 and the children of k are 2k and 2k + 1. Index 0 stands for "no
+* item" and is where iteration ends.
+*/
+
+/**
+* Returns the index of the smallest of n keys, the bottom of the left spine.
+*/
+inline std::size_t eytzingerFirst(std::size_t n)
+{
+    if (n == 0) {
+        return 0;
+    }
+    std::size_t k = 1;
+    while (2 * k <= n) {
+        k = 2 * k;
+    }
+    return k;
+}
+
+/**
+* Returns the index of the largest of n keys, the bottom of the right spine.
+*/
+inline std::size_t eytzingerLast(std::size_t n)
+{
+    if (n == 0) {
+        return 0;
+    }
+    std::size_t k = 1;
+    while (2 * k + 1 <= n) {
+        k = 2 * k + 1;
+    }
+    return k;
+}
+
+/**
+* Returns the index that follows k in key order, or 0 after the largest.
+* Like a successor in a linked tree: the leftmost node of the right subtree
+* if there is one, otherwise the first ancestor reached from its left side.
+*/
+inline std::size_t eytzingerNext(std::size_t k, std::size_t n)
+{
+    if (2 * k + 1 <= n) {
+        k = 2 * k + 1;
+        while (2 * k <= n) {
+            k = 2 * k;
+        }
+        return k;
+    }
+    //climb past the ancestors k is a right descendant of
+    while (k & 1) {
+        k >>= 1;
+    }
+    return k >> 1;
+}
+
+/**
+* Returns the index that comes before k in key order, or 0 before the
+* smallest. Passing 0 gives the largest, so end() can be decremented.
+*/
+inline std::size_t eytzingerPrev(std::size_t k, std::size_t n)
+{
+    if (k == 0) {
+        return eytzingerLast(n);
+    }
+    if (2 * k <= n) {
+        k = 2 * k;
+        while (2 * k + 1 <= n) {
+            k = 2 * k + 1;
+        }
+        return k;
+    }
+    //climb past the ancestors k is a left descendant of
+    while (k != 0 && (k & 1) == 0) {
+        k >>= 1;
+    }
+    return k >> 1;
+}
+
+/**
+* Returns the Eytzinger index of the smallest of the n keys (keys[k - 1]
+* holds index k) that is not less than key, or 0 if every key is smaller.
+*
+* The loop goes right (2k + 1) past keys smaller than the target and left
+* (2k) otherwise, until it falls off the bottom. The answer is the last node
+* it went left from. Going left appends a 0 bit to k and going right a 1, so
+* that node is found by dropping the trailing 1 bits and then the 0 bit
+* above them. The 16 descendants four levels down from k are contiguous, so
+* they are prefetched while the levels in between are compared.
+*/
+template<typename Key, typename Compare>
+std::size_t eytzingerLowerBound(const Key* keys, std::size_t n, const Key& key, const Compare& comp)
+{
+    const Key* base = keys - 1;
+    std::size_t k = 1;
+    while (k <= n) {
+#if defined(__GNUC__)
+        __builtin_prefetch(base + 16 * k);
+#endif
+        k = 2 * k + (std::size_t)comp(base[k], key);
+    }
+    //drop the trailing 1 bits and the 0 bit above them
+#if defined(__GNUC__)
+    return k >> (__builtin_ctzll(~(unsigned long long)k) + 1);
+#else
+    while (k & 1) {
+        k >>= 1;
+    }
+    return k >> 1;
+#endif
+}
+
+/**
+* An immutable snapshot of a search tree, made by BinarySearchTree::freeze().
+*
+* The keys are stored in one contiguous array in Eytzinger (BFS) order: the
+* root is at index 1 and the children of index k are at 2k and 2k + 1. The
+* values live in a parallel array, so a search only touches keys. The first
+* few levels of every search share the same few cache lines, and the
+* descendants four levels down from index k sit in one 16-key block, which
+* the search prefetches while it works on the levels in between.
+*
+* Searches do not branch on the comparisons: each level turns the result of
+* one Compare call into the next index. With std::less on integers that is a
+* compare and an add per level.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class FrozenTree
+{
+public:
+    FrozenTree();
+    template<typename InputIt>
+    FrozenTree(InputIt first, InputIt last, const Compare& comp = Compare());
+
+    std::size_t size() const;
+    bool empty() const;
+    const Value* find(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    std::size_t lowerBoundIndex(const Key& key) const;
+    void placeInOrder(std::vector<std::size_t>& slots, std::size_t k, std::size_t& next) const;
+
+protected:
+    // keys_[k - 1] and values_[k - 1] hold Eytzinger index k
+    std::vector<Key> keys_;
+    std::vector<Value> values_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the FrozenTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty snapshot.
+*/
+template<class Key, class Value, class Compare>
+FrozenTree<Key, Value, Compare>::FrozenTree() : keys_(), values_(), comp_()
+{
+
+}
+
+/**
+* Builds a snapshot from the key/value pairs in [first, last), which must be
+* sorted by comp with no repeated keys (as an in-order walk of a tree is).
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+FrozenTree<Key, Value, Compare>::FrozenTree(InputIt first, InputIt last, const Compare& comp) :
+    keys_(), values_(), comp_(comp)
+{
+    std::vector<const typename std::iterator_traits<InputIt>::value_type*> items;
+    for (; first != last; ++first) {
+        items.push_back(&*first);
+    }
+
+    //slots[k - 1] is the in-order position that goes at Eytzinger index k
+    std::vector<std::size_t> slots(items.size());
+    std::size_t next = 0;
+    placeInOrder(slots, 1, next);
+
+    keys_.reserve(items.size());
+    values_.reserve(items.size());
+    for (std::size_t k = 0; k < slots.size(); ++k) {
+        keys_.push_back(items[slots[k]]->first);
+        values_.push_back(items[slots[k]]->second);
+    }
+}
+
+/**
+* Walks the implicit tree in order, numbering the indices it visits, so that
+* the i-th smallest key is stored at the i-th index visited.
+*/
+template<class Key, class Value, class Compare>
+void FrozenTree<Key, Value, Compare>::placeInOrder(std::vector<std::size_t>& slots, std::size_t k, std::size_t& next) const
+{
+    if (k > slots.size()) {
+        return;
+    }
+    placeInOrder(slots, 2 * k, next);
+    slots[k - 1] = next++;
+    placeInOrder(slots, 2 * k + 1, next);
+}
+
+/**
+* Returns the number of items in the snapshot.
+*/
+template<class Key, class Value, class Compare>
+std::size_t FrozenTree<Key, Value, Compare>::size() const
+{
+    return keys_.size();
+}
+
+/**
+* Returns true if the snapshot is empty.
+*/
+template<class Key, class Value, class Compare>
+bool FrozenTree<Key, Value, Compare>::empty() const
+{
+    return keys_.empty();
+}
+
+/**
+* Returns the Eytzinger index of the smallest key not less than key, or 0 if
+* every key is smaller. See eytzingerLowerBound().
+*/
+template<class Key, class Value, class Compare>
+std::size_t FrozenTree<Key, Value, Compare>::lowerBoundIndex(const Key& key) const
+{
+    return eytzingerLowerBound(keys_.data(), keys_.size(), key, comp_);
+}
+
+/**
+* Returns a pointer to the value for key, or NULL if key is not in the
+* snapshot.
+*/
+template<class Key, class Value, class Compare>
+const Value* FrozenTree<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t k = lowerBoundIndex(key);
+    if (k == 0 || comp_(key, keys_[k - 1])) {
+        return NULL;
+    }
+    return &values_[k - 1];
+}
+
+/**
+ * @precondition The key exists in the snapshot
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value const & FrozenTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    const Value* value = find(key);
+    if(value == NULL) throw std::out_of_range("Invalid key");
+    return *value;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the FrozenTree class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,506 @@
+#ifndef MAPPED_TREE_H
+#define MAPPED_TREE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "frozen_bst.h"
+
+/**
+* The first bytes of a mapped tree file. The keys follow at keysOffset and
+* the values at valuesOffset, each as count raw objects in Eytzinger order
+* and each starting on a 64-byte boundary. Everything is in the byte order
+* of the machine that wrote it.
+*/
+struct MappedTreeHeader
+{
+    char magic[8];
+    // sizeof(Key) and sizeof(Value) of the writer, to catch opening the
+    // file as a view of a different type
+    std::uint32_t keyBytes;
+    std::uint32_t valueBytes;
+    std::uint64_t count;
+    std::uint64_t keysOffset;
+    std::uint64_t valuesOffset;
+};
+
+static const char MAPPED_TREE_MAGIC[8] = { 'B', 'S', 'T', 'M', 'A', 'P', 'D', '1' };
+
+/**
+* A read-only ordered map over a file written by
+* BinarySearchTree::saveMapped(), used in place through mmap().
+*
+* The file has the same layout as a FrozenTree: the keys in one array in
+* Eytzinger (BFS) order and the values in a parallel array. Opening a view
+* only checks the header and maps the file, so it takes the same time for
+* any size and allocates nothing; pages are read in by the first searches
+* that touch them. The mapping is shared, so every process that opens the
+* same file uses one copy of it in the page cache.
+*
+* Keys and values are stored as raw bytes, so both must be trivially
+* copyable, and a view must use the same Compare the tree was ordered by.
+*
+* Iterators walk the items in key order. They dereference to a pair of
+* references into the mapping rather than to a stored pair, and stay valid
+* until the view is closed.
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class MappedTreeView
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+        "a mapped tree stores its keys and values as raw bytes");
+
+public:
+    MappedTreeView();
+    explicit MappedTreeView(const std::string& path, const Compare& comp = Compare());
+    ~MappedTreeView();
+
+    void open(const std::string& path);
+    void close();
+    bool isOpen() const;
+
+    template<typename InputIt>
+    static void write(InputIt first, std::size_t count, const std::string& path);
+
+    /**
+    * An iterator over the items in key order. It holds an Eytzinger index;
+    * end() is index 0.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef std::pair<const Key&, const Value&> reference;
+
+        /**
+        * What -> points at: the pair of references, kept alive for the
+        * duration of the member access.
+        */
+        struct pointer
+        {
+            reference item;
+            const reference* operator->() const { return &item; }
+        };
+
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        friend class MappedTreeView<Key, Value, Compare>;
+        const_iterator(std::size_t index, const MappedTreeView<Key, Value, Compare>* view);
+        std::size_t index_;
+        const MappedTreeView<Key, Value, Compare>* view_;
+    };
+    typedef const_iterator iterator;
+
+    std::size_t size() const;
+    bool empty() const;
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lower_bound(const Key& key) const;
+    const_iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+    Compare key_comp() const;
+
+private:
+    MappedTreeView(const MappedTreeView&);
+    MappedTreeView& operator=(const MappedTreeView&);
+
+    static std::uint64_t roundUp(std::uint64_t offset);
+
+    void* data_;
+    std::size_t bytes_;
+    // keys_[k - 1] and values_[k - 1] hold Eytzinger index k
+    const Key* keys_;
+    const Value* values_;
+    std::size_t count_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------------
+  Begin implementations for the MappedTreeView class.
+  -------------------------------------------------------
+*/
+
+/**
+* Default constructor for a view that is not open and looks empty.
+*/
+template<class Key, class Value, class Compare>
+MappedTreeView<Key, Value, Compare>::MappedTreeView() :
+    data_(NULL), bytes_(0), keys_(NULL), values_(NULL), count_(0), comp_()
+{
+
+}
+
+/**
+* Opens the mapped tree file at path. See open().
+*/
+template<class Key, class Value, class Compare>
+MappedTreeView<Key, Value, Compare>::MappedTreeView(const std::string& path, const Compare& comp) :
+    data_(NULL), bytes_(0), keys_(NULL), values_(NULL), count_(0), comp_(comp)
+{
+    open(path);
+}
+
+template<class Key, class Value, class Compare>
+MappedTreeView<Key, Value, Compare>::~MappedTreeView()
+{
+    close();
+}
+
+/**
+* Maps the file at path read-only, closing any file that was open before.
+* Throws std::runtime_error if the file cannot be mapped or was not written
+* for this Key and Value, leaving the view closed.
+*/
+template<class Key, class Value, class Compare>
+void MappedTreeView<Key, Value, Compare>::open(const std::string& path)
+{
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + " for reading");
+    }
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || (std::uint64_t)info.st_size < sizeof(MappedTreeHeader)) {
+        ::close(fd);
+        throw std::runtime_error("Not a mapped tree file: " + path);
+    }
+    std::size_t bytes = (std::size_t)info.st_size;
+    void* data = ::mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    //the mapping keeps the file open by itself
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+
+    const MappedTreeHeader* header = static_cast<const MappedTreeHeader*>(data);
+    const char* error = NULL;
+    if (std::memcmp(header->magic, MAPPED_TREE_MAGIC, sizeof(header->magic)) != 0) {
+        error = "Not a mapped tree file: ";
+    }
+    else if (header->keyBytes != sizeof(Key) || header->valueBytes != sizeof(Value)) {
+        error = "Mapped tree was written with other key or value types: ";
+    }
+    else if (header->keysOffset != roundUp(sizeof(MappedTreeHeader)) ||
+             header->keysOffset > bytes ||
+             header->count > (bytes - header->keysOffset) / sizeof(Key) ||
+             header->valuesOffset != roundUp(header->keysOffset + header->count * sizeof(Key)) ||
+             header->valuesOffset > bytes ||
+             header->count > (bytes - header->valuesOffset) / sizeof(Value)) {
+        error = "Mapped tree is truncated: ";
+    }
+    if (error != NULL) {
+        ::munmap(data, bytes);
+        throw std::runtime_error(error + path);
+    }
+
+    data_ = data;
+    bytes_ = bytes;
+    count_ = (std::size_t)header->count;
+    keys_ = reinterpret_cast<const Key*>(static_cast<const char*>(data) + header->keysOffset);
+    values_ = reinterpret_cast<const Value*>(static_cast<const char*>(data) + header->valuesOffset);
+}
+
+/**
+* Unmaps the file, if one is open. Iterators into the view become invalid.
+*/
+template<class Key, class Value, class Compare>
+void MappedTreeView<Key, Value, Compare>::close()
+{
+    if (data_ != NULL) {
+        ::munmap(data_, bytes_);
+    }
+    data_ = NULL;
+    bytes_ = 0;
+    keys_ = NULL;
+    values_ = NULL;
+    count_ = 0;
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTreeView<Key, Value, Compare>::isOpen() const
+{
+    return data_ != NULL;
+}
+
+/**
+* Writes count items, read from first in key order with no repeated keys,
+* to a mapped tree file at path. The file is sized up front and filled
+* through a writable mapping, so nothing but the file itself is allocated.
+* It is written under a temporary name in the same directory and then
+* renamed over path, so views that other processes have open on the old
+* file keep reading it, and a reader never sees a half-written file.
+* Throws std::runtime_error if the file cannot be written, leaving any
+* file already at path as it was.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+void MappedTreeView<Key, Value, Compare>::write(InputIt first, std::size_t count, const std::string& path)
+{
+    MappedTreeHeader header;
+    std::memcpy(header.magic, MAPPED_TREE_MAGIC, sizeof(header.magic));
+    header.keyBytes = sizeof(Key);
+    header.valueBytes = sizeof(Value);
+    header.count = count;
+    header.keysOffset = roundUp(sizeof(MappedTreeHeader));
+    header.valuesOffset = roundUp(header.keysOffset + count * sizeof(Key));
+    std::size_t bytes = (std::size_t)(header.valuesOffset + count * sizeof(Value));
+
+    std::string tempPath = path + ".XXXXXX";
+    int fd = ::mkstemp(&tempPath[0]);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + " for writing");
+    }
+    if (::fchmod(fd, 0644) != 0 || ::ftruncate(fd, (off_t)bytes) != 0) {
+        ::close(fd);
+        ::unlink(tempPath.c_str());
+        throw std::runtime_error("Mapped tree write failed");
+    }
+    void* data = ::mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        ::unlink(tempPath.c_str());
+        throw std::runtime_error("Mapped tree write failed");
+    }
+
+    char* base = static_cast<char*>(data);
+    Key* keys = reinterpret_cast<Key*>(base + header.keysOffset);
+    Value* values = reinterpret_cast<Value*>(base + header.valuesOffset);
+    //the i-th item in key order goes to the i-th index of an in-order walk
+    std::size_t k = eytzingerFirst(count);
+    for (std::size_t i = 0; i < count; ++i, ++first) {
+        std::memcpy(&keys[k - 1], &first->first, sizeof(Key));
+        std::memcpy(&values[k - 1], &first->second, sizeof(Value));
+        k = eytzingerNext(k, count);
+    }
+    //the header goes in last, so a file cut short by a crash does not open
+    std::memcpy(base, &header, sizeof(header));
+    int synced = ::msync(data, bytes, MS_SYNC);
+    ::munmap(data, bytes);
+    //the new file only takes the name once it is all on disk
+    if (synced != 0 || ::rename(tempPath.c_str(), path.c_str()) != 0) {
+        ::unlink(tempPath.c_str());
+        throw std::runtime_error("Mapped tree write failed");
+    }
+}
+
+/**
+* Returns offset rounded up to a multiple of the cache line size.
+*/
+template<class Key, class Value, class Compare>
+std::uint64_t MappedTreeView<Key, Value, Compare>::roundUp(std::uint64_t offset)
+{
+    return (offset + 63) & ~(std::uint64_t)63;
+}
+
+/**
+* Returns the number of items in the view, or 0 if it is not open.
+*/
+template<class Key, class Value, class Compare>
+std::size_t MappedTreeView<Key, Value, Compare>::size() const
+{
+    return count_;
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTreeView<Key, Value, Compare>::empty() const
+{
+    return count_ == 0;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::begin() const
+{
+    return const_iterator(eytzingerFirst(count_), this);
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::end() const
+{
+    return const_iterator(0, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if there is
+* none.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::find(const Key& key) const
+{
+    std::size_t k = eytzingerLowerBound(keys_, count_, key, comp_);
+    if (k == 0 || comp_(key, keys_[k - 1])) {
+        return end();
+    }
+    return const_iterator(k, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return const_iterator(eytzingerLowerBound(keys_, count_, key, comp_), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    std::size_t k = eytzingerLowerBound(keys_, count_, key, comp_);
+    if (k != 0 && !comp_(key, keys_[k - 1])) {
+        k = eytzingerNext(k, count_);
+    }
+    return const_iterator(k, this);
+}
+
+/**
+ * @precondition The key exists in the view
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value const & MappedTreeView<Key, Value, Compare>::operator[](const Key& key) const
+{
+    const_iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return values_[it.index_ - 1];
+}
+
+template<class Key, class Value, class Compare>
+Compare MappedTreeView<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/*
+  -----------------------------------------------------
+  End implementations for the MappedTreeView class.
+  -----------------------------------------------------
+*/
+
+/*
+  -------------------------------------------------------------------
+  Begin implementations for the MappedTreeView::const_iterator class.
+  -------------------------------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+MappedTreeView<Key, Value, Compare>::const_iterator::const_iterator() : index_(0), view_(NULL)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+MappedTreeView<Key, Value, Compare>::const_iterator::const_iterator(std::size_t index, const MappedTreeView<Key, Value, Compare>* view) :
+    index_(index), view_(view)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator::reference
+MappedTreeView<Key, Value, Compare>::const_iterator::operator*() const
+{
+    return reference(view_->keys_[index_ - 1], view_->values_[index_ - 1]);
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator::pointer
+MappedTreeView<Key, Value, Compare>::const_iterator::operator->() const
+{
+    pointer p = { **this };
+    return p;
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTreeView<Key, Value, Compare>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return index_ == rhs.index_;
+}
+
+template<class Key, class Value, class Compare>
+bool MappedTreeView<Key, Value, Compare>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return index_ != rhs.index_;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator&
+MappedTreeView<Key, Value, Compare>::const_iterator::operator++()
+{
+    index_ = eytzingerNext(index_, view_->count_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Steps back one item. Decrementing end() gives the largest item.
+*/
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator&
+MappedTreeView<Key, Value, Compare>::const_iterator::operator--()
+{
+    index_ = eytzingerPrev(index_, view_->count_);
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename MappedTreeView<Key, Value, Compare>::const_iterator
+MappedTreeView<Key, Value, Compare>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+  -----------------------------------------------------------------
+  End implementations for the MappedTreeView::const_iterator class.
+  -----------------------------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,327 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * A slab allocator for the nodes of a search tree.
+ *
+ * Requests are rounded up to a size class (a multiple of ALIGN bytes) and
+ * carved out of large slabs. Freed blocks are pushed onto an intrusive free
+ * list for their size class, so a remove followed by an insert reuses the
+ * same memory without going back to malloc. release() hands every slab back
+ * at once, which lets a tree drop all of its nodes without walking them.
+ */
+class NodePool
+{
+public:
+    NodePool();
+    ~NodePool();
+
+    void* allocate(std::size_t bytes);
+    void deallocate(void* p, std::size_t bytes);
+    void release();
+    void share(NodePool& other);
+    bool shared() const;
+    bool sharesWith(const NodePool& other) const;
+    void swap(NodePool& other);
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args);
+    template<typename T>
+    void destroy(T* p);
+
+private:
+    NodePool(const NodePool&);
+    NodePool& operator=(const NodePool&);
+
+    static const std::size_t ALIGN = 16;
+    static const std::size_t SLAB_BYTES = 64 * 1024;
+    static const std::size_t MIN_BLOCKS_PER_SLAB = 16;
+
+    // A free block stores the link to the next free block in its own storage.
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    struct SizeClass
+    {
+        FreeBlock* freeList;
+        FreeBlock* tail;    // last free block, valid while freeList is not NULL
+        char* cursor;       // next unused byte of the current slab
+        char* limit;        // end of the current slab
+    };
+
+    // The slabs and free lists, kept in the pool itself until it is shared
+    struct State
+    {
+        std::vector<SizeClass> classes;
+        std::vector<void*> slabs;
+        // the pools using a shared state; empty for a pool's own state
+        std::vector<NodePool*> users;
+    };
+
+    static std::size_t classIndex(std::size_t bytes);
+    void freeSlabs();
+    void moveToHeap();
+
+    State own_;
+    State* state_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the NodePool class.
+  -----------------------------------------------
+*/
+
+inline NodePool::NodePool() : own_(), state_(&own_)
+{
+
+}
+
+/**
+* Frees the slabs, unless other pools still share them.
+*/
+inline NodePool::~NodePool()
+{
+    if(state_ == &own_) {
+        freeSlabs();
+        return;
+    }
+    std::vector<NodePool*>& users = state_->users;
+    for(std::size_t i = 0; i < users.size(); ++i) {
+        if(users[i] == this) {
+            users[i] = users.back();
+            users.pop_back();
+            break;
+        }
+    }
+    if(users.empty()) {
+        freeSlabs();
+        delete state_;
+    }
+}
+
+/**
+* Maps a block size to its size class. Index 0 is unused so that
+* a size of n * ALIGN lives in class n.
+*/
+inline std::size_t NodePool::classIndex(std::size_t bytes)
+{
+    return (bytes + ALIGN - 1) / ALIGN;
+}
+
+/**
+* Returns a block of at least the given number of bytes. Blocks come from
+* the free list of the size class first, then from the current slab, and a
+* new slab is started when the current one runs out.
+*/
+inline void* NodePool::allocate(std::size_t bytes)
+{
+    std::size_t idx = classIndex(bytes);
+    std::vector<SizeClass>& classes = state_->classes;
+    if(idx >= classes.size()) {
+        SizeClass empty = { NULL, NULL, NULL, NULL };
+        classes.resize(idx + 1, empty);
+    }
+    SizeClass& sc = classes[idx];
+
+    //reuse a freed block if there is one
+    if(sc.freeList != NULL) {
+        FreeBlock* block = sc.freeList;
+        sc.freeList = block->next;
+        return block;
+    }
+
+    //otherwise bump allocate, starting a new slab when this one is full
+    std::size_t blockBytes = idx * ALIGN;
+    if(sc.cursor == NULL || sc.cursor + blockBytes > sc.limit) {
+        std::size_t slabBytes = SLAB_BYTES;
+        if(slabBytes < blockBytes * MIN_BLOCKS_PER_SLAB) {
+            slabBytes = blockBytes * MIN_BLOCKS_PER_SLAB;
+        }
+        std::vector<void*>& slabs = state_->slabs;
+        slabs.reserve(slabs.size() + 1);
+        char* slab = static_cast<char*>(::operator new(slabBytes));
+        slabs.push_back(slab);
+        sc.cursor = slab;
+        sc.limit = slab + slabBytes;
+    }
+    void* p = sc.cursor;
+    sc.cursor += blockBytes;
+    return p;
+}
+
+/**
+* Returns a block to the free list of its size class. The size must be the
+* same one that was passed to allocate().
+*/
+inline void NodePool::deallocate(void* p, std::size_t bytes)
+{
+    if(p == NULL) {
+        return;
+    }
+    std::size_t idx = classIndex(bytes);
+    SizeClass& sc = state_->classes[idx];
+    FreeBlock* block = static_cast<FreeBlock*>(p);
+    if(sc.freeList == NULL) {
+        sc.tail = block;
+    }
+    block->next = sc.freeList;
+    sc.freeList = block;
+}
+
+/**
+* Frees every slab owned by the pool. Any object still living in a slab must
+* already have been destroyed (or be trivially destructible). A shared pool
+* keeps its slabs, since other pools' objects live in them too; its own
+* objects must have been destroyed one by one.
+*/
+inline void NodePool::release()
+{
+    if(shared()) {
+        return;
+    }
+    freeSlabs();
+}
+
+inline void NodePool::freeSlabs()
+{
+    std::vector<void*>& slabs = state_->slabs;
+    for(std::size_t i = 0; i < slabs.size(); ++i) {
+        ::operator delete(slabs[i]);
+    }
+    slabs.clear();
+    state_->classes.clear();
+}
+
+/**
+* Returns true if other pools allocate from this pool's slabs.
+*/
+inline bool NodePool::shared() const
+{
+    return state_->users.size() > 1;
+}
+
+/**
+* Returns true if this pool and other allocate from the same slabs, so that
+* objects can move between them.
+*/
+inline bool NodePool::sharesWith(const NodePool& other) const
+{
+    return state_ == other.state_;
+}
+
+/**
+* Exchanges the slabs and free lists of two pools that share with no other
+* pool, so that each one owns what the other did. Takes O(1).
+*/
+inline void NodePool::swap(NodePool& other)
+{
+    if(shared() || other.shared()) {
+        throw std::logic_error("Only unshared pools can be swapped");
+    }
+    state_->classes.swap(other.state_->classes);
+    state_->slabs.swap(other.state_->slabs);
+}
+
+/**
+* Merges this pool with other (and with every pool either already shares
+* with), so that objects allocated by one may be destroyed by another. The
+* free lists are spliced in O(1) per size class. Merged pools stay merged
+* until they are all destroyed, and they must not be used from different
+* threads at once.
+*/
+inline void NodePool::share(NodePool& other)
+{
+    if(state_ == other.state_) {
+        return;
+    }
+    moveToHeap();
+    other.moveToHeap();
+    State* from = other.state_;
+
+    std::vector<SizeClass>& classes = state_->classes;
+    if(classes.size() < from->classes.size()) {
+        SizeClass empty = { NULL, NULL, NULL, NULL };
+        classes.resize(from->classes.size(), empty);
+    }
+    for(std::size_t i = 0; i < from->classes.size(); ++i) {
+        //the rest of the other pool's current slab is left unused
+        SizeClass& to = classes[i];
+        const SizeClass& fromClass = from->classes[i];
+        if(fromClass.freeList == NULL) {
+            continue;
+        }
+        if(to.freeList == NULL) {
+            to.tail = fromClass.tail;
+        }
+        fromClass.tail->next = to.freeList;
+        to.freeList = fromClass.freeList;
+    }
+    state_->slabs.insert(state_->slabs.end(), from->slabs.begin(), from->slabs.end());
+    for(std::size_t i = 0; i < from->users.size(); ++i) {
+        from->users[i]->state_ = state_;
+        state_->users.push_back(from->users[i]);
+    }
+    delete from;
+}
+
+/**
+* Moves the pool's own state to the heap, where pools sharing it can find it
+* whichever of them goes first.
+*/
+inline void NodePool::moveToHeap()
+{
+    if(state_ != &own_) {
+        return;
+    }
+    State* state = new State();
+    state->classes.swap(own_.classes);
+    state->slabs.swap(own_.slabs);
+    state->users.push_back(this);
+    state_ = state;
+}
+
+/**
+* Allocates a block for a T and constructs it in place.
+*/
+template<typename T, typename... Args>
+T* NodePool::create(Args&&... args)
+{
+    void* p = allocate(sizeof(T));
+    try {
+        return new (p) T(std::forward<Args>(args)...);
+    }
+    catch(...) {
+        deallocate(p, sizeof(T));
+        throw;
+    }
+}
+
+/**
+* Destroys a T created by create() and returns its block to the pool.
+*/
+template<typename T>
+void NodePool::destroy(T* p)
+{
+    if(p == NULL) {
+        return;
+    }
+    p->~T();
+    deallocate(p, sizeof(T));
+}
+
+/*
+  ---------------------------------------------
+  End implementations for the NodePool class.
+  ---------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,902 @@
+#ifndef PARENTLESS_AVLBST_H
+#define PARENTLESS_AVLBST_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "node_pool.h"
+
+/**
+* An AVL tree whose nodes have no parent pointer, for maps where memory per
+* item matters more than stable iterators.
+*
+* Nothing in the tree ever needs to walk up:
+*   - insert follows Knuth's top-down scheme. On the way down it remembers
+*     the deepest node that was not level. Only that node can end up out of
+*     balance, and the nodes below it just lean towards the new leaf. One
+*     rotation at that node finishes the insert.
+*   - remove records the links it follows on a fixed-size stack and walks
+*     back up the stack to rebalance.
+*   - iterators carry the path from the root to their item.
+* Rotations only rewrite child links.
+*
+* A node is the item, two child pointers and a balance byte. That is 33
+* bytes for 8-byte keys and values, which the pool rounds to 48, against 64
+* for an AVLNode. Unlike AVLTree, there are no order statistics, and any
+* insert or remove invalidates iterators (references to items stay valid).
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class ParentlessAVLTree
+{
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    // An AVL tree this tall has at least F(66) - 1 > 2^44 nodes, far more
+    // than fit in memory, so no path is ever longer.
+    static const int MAX_HEIGHT = 64;
+
+    struct TreeNode
+    {
+        Item item;
+        TreeNode* left;
+        TreeNode* right;
+        int8_t balance;
+
+        template<typename K, typename V>
+        TreeNode(K&& key, V&& value) :
+            item(std::forward<K>(key), std::forward<V>(value)), left(NULL), right(NULL), balance(0) { }
+    };
+
+public:
+    ParentlessAVLTree();
+    explicit ParentlessAVLTree(const Compare& comp);
+    template<typename InputIt>
+    ParentlessAVLTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
+    ~ParentlessAVLTree();
+
+    template<typename InputIt>
+    void assign(InputIt first, InputIt last, bool sorted = true);
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+    * A bidirectional iterator over the items in key order. It holds the path
+    * from the root to its item, so it is invalidated by any insert or remove.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+        iterator(const iterator& other);
+        iterator& operator=(const iterator& other);
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class ParentlessAVLTree<Key, Value, Compare>;
+        explicit iterator(const ParentlessAVLTree<Key, Value, Compare>* tree);
+        TreeNode* current() const;
+        void pushLeftSpine(TreeNode* node);
+        void pushRightSpine(TreeNode* node);
+
+        const ParentlessAVLTree<Key, Value, Compare>* tree_;
+        // path_[0] is the root and path_[depth_ - 1] the item; end() is empty
+        int depth_;
+        TreeNode* path_[MAX_HEIGHT];
+    };
+
+    template<typename P, typename = typename std::enable_if<
+        std::is_constructible<std::pair<Key, Value>, P&&>::value>::type>
+    std::pair<iterator, bool> insert(P&& keyValuePair);
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Compare key_comp() const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    TreeNode* findNode(const Key& key) const;
+    template<typename K, typename V>
+    TreeNode* insertNode(K&& key, V&& value, bool& inserted);
+    TreeNode* rebalance(TreeNode* node);
+    static TreeNode* rotateRight(TreeNode* node);
+    static TreeNode* rotateLeft(TreeNode* node);
+    template<typename ForwardIt>
+    TreeNode* buildSubtree(ForwardIt& it, std::size_t n, int& height);
+    void clearHelper(TreeNode* node);
+    int balanceHelper(TreeNode* node) const;
+
+private:
+    ParentlessAVLTree(const ParentlessAVLTree&);
+    ParentlessAVLTree& operator=(const ParentlessAVLTree&);
+
+protected:
+    TreeNode* root_;
+    std::size_t size_;
+    NodePool pool_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the ParentlessAVLTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty ParentlessAVLTree.
+*/
+template<class Key, class Value, class Compare>
+ParentlessAVLTree<Key, Value, Compare>::ParentlessAVLTree() : root_(NULL), size_(0), pool_(), comp_()
+{
+
+}
+
+/**
+* Constructor for an empty ParentlessAVLTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+ParentlessAVLTree<Key, Value, Compare>::ParentlessAVLTree(const Compare& comp) :
+    root_(NULL), size_(0), pool_(), comp_(comp)
+{
+
+}
+
+/**
+* Constructs a balanced ParentlessAVLTree from the key/value pairs in
+* [first, last) in linear time. See assign().
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+ParentlessAVLTree<Key, Value, Compare>::ParentlessAVLTree(InputIt first, InputIt last, bool sorted, const Compare& comp) :
+    root_(NULL), size_(0), pool_(), comp_(comp)
+{
+    assign(first, last, sorted);
+}
+
+template<class Key, class Value, class Compare>
+ParentlessAVLTree<Key, Value, Compare>::~ParentlessAVLTree()
+{
+    clear();
+}
+
+/**
+* Replaces the contents of the tree with the key/value pairs in [first, last)
+* and builds a perfectly balanced tree from them in linear time.
+*
+* If sorted is true the keys must already be in strictly increasing order.
+* Otherwise the pairs are copied and sorted first (O(n log n)), and when a key
+* appears more than once the last pair wins, just like repeated inserts.
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+void ParentlessAVLTree<Key, Value, Compare>::assign(InputIt first, InputIt last, bool sorted)
+{
+    typedef typename std::iterator_traits<InputIt>::iterator_category Category;
+    clear();
+    int height = 0;
+
+    //a forward range that is already sorted can be built straight from the iterators
+    if (sorted && !std::is_same<Category, std::input_iterator_tag>::value) {
+        std::size_t n = (std::size_t)std::distance(first, last);
+        root_ = buildSubtree(first, n, height);
+        size_ = n;
+        return;
+    }
+
+    //otherwise buffer the pairs so they can be counted (and sorted if asked)
+    std::vector<std::pair<Key, Value> > items(first, last);
+    if (!sorted) {
+        std::stable_sort(items.begin(), items.end(),
+            [this](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b) { return comp_(a.first, b.first); });
+        //drop duplicate keys, keeping the value that came last
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            if (kept > 0 && !comp_(items[kept - 1].first, items[i].first)) {
+                items[kept - 1].second = items[i].second;
+            }
+            else {
+                if (kept != i) {
+                    items[kept] = std::move(items[i]);
+                }
+                ++kept;
+            }
+        }
+        items.erase(items.begin() + kept, items.end());
+    }
+    typename std::vector<std::pair<Key, Value> >::iterator it = items.begin();
+    root_ = buildSubtree(it, items.size(), height);
+    size_ = items.size();
+}
+
+/**
+* Builds a balanced subtree from the next n pairs of an in-order sequence, as
+* BinarySearchTree::buildSubtree() does. Returns the root and its height.
+*/
+template<class Key, class Value, class Compare>
+template<typename ForwardIt>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::buildSubtree(ForwardIt& it, std::size_t n, int& height)
+{
+    if (n == 0) {
+        height = 0;
+        return NULL;
+    }
+    int leftHeight = 0;
+    int rightHeight = 0;
+    TreeNode* left = buildSubtree(it, n / 2, leftHeight);
+    TreeNode* node = pool_.template create<TreeNode>(it->first, it->second);
+    ++it;
+    node->left = left;
+    node->right = buildSubtree(it, n - n / 2 - 1, rightHeight);
+    node->balance = (int8_t)(rightHeight - leftHeight);
+    height = 1 + std::max(leftHeight, rightHeight);
+    return node;
+}
+
+/**
+* A method to remove all contents of the tree and
+* reset the values in the tree for use again.
+*/
+template<class Key, class Value, class Compare>
+void ParentlessAVLTree<Key, Value, Compare>::clear()
+{
+    //as in BinarySearchTree::clear(), trivial items are dropped with the pool
+    if (!std::is_trivially_destructible<Item>::value) {
+        clearHelper(root_);
+    }
+    pool_.release();
+    root_ = NULL;
+    size_ = 0;
+}
+
+/**
+* Destroys the nodes under node. The tree is balanced, so the recursion is
+* only as deep as its height.
+*/
+template<class Key, class Value, class Compare>
+void ParentlessAVLTree<Key, Value, Compare>::clearHelper(TreeNode* node)
+{
+    if (node == NULL) {
+        return;
+    }
+    clearHelper(node->left);
+    clearHelper(node->right);
+    pool_.destroy(node);
+}
+
+/**
+* Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare>
+bool ParentlessAVLTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+* Returns the number of items in the tree
+*/
+template<class Key, class Value, class Compare>
+std::size_t ParentlessAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Return true iff the tree is height-balanced.
+*/
+template<class Key, class Value, class Compare>
+bool ParentlessAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return balanceHelper(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree at node, or -1 if it is not balanced or
+* its stored balance is wrong.
+*/
+template<class Key, class Value, class Compare>
+int ParentlessAVLTree<Key, Value, Compare>::balanceHelper(TreeNode* node) const
+{
+    if (node == NULL) {
+        return 0;
+    }
+    int left = balanceHelper(node->left);
+    int right = balanceHelper(node->right);
+    if (left == -1 || right == -1 || left - right > 1 || right - left > 1 || right - left != node->balance) {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+/**
+* Returns the node holding key, or NULL.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::findNode(const Key& key) const
+{
+    TreeNode* current = root_;
+    while (current != NULL) {
+        if (comp_(key, current->item.first)) {
+            current = current->left;
+        }
+        else if (comp_(current->item.first, key)) {
+            current = current->right;
+        }
+        else {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+/**
+* An insert method to insert into the tree. If key is already in the tree,
+* its value is overwritten.
+*/
+template<class Key, class Value, class Compare>
+void ParentlessAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool inserted = false;
+    TreeNode* node = insertNode(keyValuePair.first, keyValuePair.second, inserted);
+    if (!inserted) {
+        node->item.second = keyValuePair.second;
+    }
+}
+
+/**
+* Inserts anything a pair can be built from, moving the key and value into
+* the new node. An existing key has its value overwritten (by move). Returns
+* an iterator to the item and whether a new node was created.
+*/
+template<class Key, class Value, class Compare>
+template<typename P, typename>
+std::pair<typename ParentlessAVLTree<Key, Value, Compare>::iterator, bool>
+ParentlessAVLTree<Key, Value, Compare>::insert(P&& keyValuePair)
+{
+    std::pair<Key, Value> item(std::forward<P>(keyValuePair));
+    bool inserted = false;
+    TreeNode* node = insertNode(std::move(item.first), std::move(item.second), inserted);
+    if (!inserted) {
+        node->item.second = std::move(item.second);
+    }
+    //the path to the new node was not kept, so look it up again for the iterator
+    return std::make_pair(find(node->item.first), inserted);
+}
+
+/**
+* Links a new leaf for key, or returns the node that already holds it with
+* inserted set to false.
+*
+* On the way down, top is the link to the deepest node that was not level
+* (or the root). Every node below it on the path was level, so they all lean
+* towards the new leaf afterwards and got one taller. top itself either
+* levels out, leans, or reaches +-2 and is rotated back to its old height.
+* Either way nothing above it changes.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename V>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::insertNode(K&& key, V&& value, bool& inserted)
+{
+    TreeNode** link = &root_;
+    TreeNode** top = &root_;
+    while (*link != NULL) {
+        TreeNode* current = *link;
+        if (current->balance != 0) {
+            top = link;
+        }
+        if (comp_(key, current->item.first)) {
+            link = &current->left;
+        }
+        else if (comp_(current->item.first, key)) {
+            link = &current->right;
+        }
+        else {
+            inserted = false;
+            return current;
+        }
+    }
+    TreeNode* node = pool_.template create<TreeNode>(std::forward<K>(key), std::forward<V>(value));
+    *link = node;
+    ++size_;
+    inserted = true;
+
+    //walk down again from top, tilting each node towards the new leaf
+    for (TreeNode* current = *top; current != node; ) {
+        if (comp_(node->item.first, current->item.first)) {
+            --current->balance;
+            current = current->left;
+        }
+        else {
+            ++current->balance;
+            current = current->right;
+        }
+    }
+    if ((*top)->balance == 2 || (*top)->balance == -2) {
+        *top = rebalance(*top);
+    }
+    return node;
+}
+
+/*
+ * If the node has 2 children it is replaced by its predecessor, which is
+ * unlinked from its own spot first. Nodes are moved rather than items, so
+ * references to the predecessor's item stay valid.
+ */
+template<class Key, class Value, class Compare>
+void ParentlessAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    //links[i] points at the i-th node on the path, and dirs[i] is the side
+    //(-1 left, +1 right) the path leaves it by
+    TreeNode** links[MAX_HEIGHT];
+    int dirs[MAX_HEIGHT];
+    int depth = 0;
+
+    TreeNode** link = &root_;
+    while (*link != NULL) {
+        TreeNode* current = *link;
+        links[depth] = link;
+        if (comp_(key, current->item.first)) {
+            dirs[depth++] = -1;
+            link = &current->left;
+        }
+        else if (comp_(current->item.first, key)) {
+            dirs[depth++] = 1;
+            link = &current->right;
+        }
+        else {
+            break;
+        }
+    }
+    TreeNode* node = *link;
+    if (node == NULL) {
+        return;
+    }
+
+    //the node at depth - 1 lost height on side dirs[depth - 1]
+    if (node->left != NULL && node->right != NULL) {
+        int nodeDepth = depth;
+        dirs[depth++] = -1;
+        TreeNode** predLink = &node->left;
+        while ((*predLink)->right != NULL) {
+            links[depth] = predLink;
+            dirs[depth++] = 1;
+            predLink = &(*predLink)->right;
+        }
+        TreeNode* pred = *predLink;
+        //unlink the predecessor, which has no right child
+        *predLink = pred->left;
+        //then give it node's place, children and balance
+        pred->left = node->left;
+        pred->right = node->right;
+        pred->balance = node->balance;
+        *link = pred;
+        //the path below node ran through node->left, which now lives in pred
+        if (depth > nodeDepth + 1) {
+            links[nodeDepth + 1] = &pred->left;
+        }
+    }
+    else {
+        *link = node->left != NULL ? node->left : node->right;
+    }
+    pool_.destroy(node);
+    --size_;
+
+    //walk back up while the subtree keeps getting shorter
+    while (depth > 0) {
+        --depth;
+        TreeNode* current = *links[depth];
+        current->balance = (int8_t)(current->balance - dirs[depth]);
+        if (current->balance == 1 || current->balance == -1) {
+            return;
+        }
+        if (current->balance != 0) {
+            current = rebalance(current);
+            *links[depth] = current;
+            //rotating around a level child leaves the height unchanged
+            if (current->balance != 0) {
+                return;
+            }
+        }
+    }
+}
+
+/**
+* Rotates node, whose balance is -2 or 2, and returns the node that took
+* its place.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::rebalance(TreeNode* node)
+{
+    if (node->balance == -2) {
+        TreeNode* child = node->left;
+        //zig-zig case
+        if (child->balance <= 0) {
+            int8_t childBalance = child->balance;
+            rotateRight(node);
+            node->balance = childBalance == 0 ? -1 : 0;
+            child->balance = childBalance == 0 ? 1 : 0;
+            return child;
+        }
+        //zig-zag case
+        TreeNode* grandchild = child->right;
+        node->left = rotateLeft(child);
+        rotateRight(node);
+        node->balance = grandchild->balance == -1 ? 1 : 0;
+        child->balance = grandchild->balance == 1 ? -1 : 0;
+        grandchild->balance = 0;
+        return grandchild;
+    }
+    else {
+        TreeNode* child = node->right;
+        //zig-zig case
+        if (child->balance >= 0) {
+            int8_t childBalance = child->balance;
+            rotateLeft(node);
+            node->balance = childBalance == 0 ? 1 : 0;
+            child->balance = childBalance == 0 ? -1 : 0;
+            return child;
+        }
+        //zig-zag case
+        TreeNode* grandchild = child->left;
+        node->right = rotateRight(child);
+        rotateLeft(node);
+        node->balance = grandchild->balance == 1 ? -1 : 0;
+        child->balance = grandchild->balance == -1 ? 1 : 0;
+        grandchild->balance = 0;
+        return grandchild;
+    }
+}
+
+/**
+* Makes the left child of node the root of the subtree and returns it. The
+* caller relinks it to node's old parent.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::rotateRight(TreeNode* node)
+{
+    TreeNode* child = node->left;
+    node->left = child->right;
+    child->right = node;
+    return child;
+}
+
+/**
+* Makes the right child of node the root of the subtree and returns it.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::rotateLeft(TreeNode* node)
+{
+    TreeNode* child = node->right;
+    node->right = child->left;
+    child->left = node;
+    return child;
+}
+
+/**
+* Returns an iterator to the first item in the tree.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::begin() const
+{
+    iterator it(this);
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator(this);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    iterator it(this);
+    TreeNode* current = root_;
+    while (current != NULL) {
+        it.path_[it.depth_++] = current;
+        if (comp_(key, current->item.first)) {
+            current = current->left;
+        }
+        else if (comp_(current->item.first, key)) {
+            current = current->right;
+        }
+        else {
+            return it;
+        }
+    }
+    return end();
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    //the answer is the last node the path goes left from, so cut it there
+    iterator it(this);
+    int bestDepth = 0;
+    TreeNode* current = root_;
+    while (current != NULL) {
+        it.path_[it.depth_++] = current;
+        if (comp_(current->item.first, key)) {
+            current = current->right;
+        }
+        else {
+            bestDepth = it.depth_;
+            current = current->left;
+        }
+    }
+    it.depth_ = bestDepth;
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    iterator it(this);
+    int bestDepth = 0;
+    TreeNode* current = root_;
+    while (current != NULL) {
+        it.path_[it.depth_++] = current;
+        if (comp_(key, current->item.first)) {
+            bestDepth = it.depth_;
+            current = current->left;
+        }
+        else {
+            current = current->right;
+        }
+    }
+    it.depth_ = bestDepth;
+    return it;
+}
+
+/**
+* Returns the comparator the tree is ordered by.
+*/
+template<class Key, class Value, class Compare>
+Compare ParentlessAVLTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value& ParentlessAVLTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    TreeNode* node = findNode(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+template<class Key, class Value, class Compare>
+Value const & ParentlessAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    TreeNode* node = findNode(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ParentlessAVLTree class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the ParentlessAVLTree::iterator class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+ParentlessAVLTree<Key, Value, Compare>::iterator::iterator() : tree_(NULL), depth_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+ParentlessAVLTree<Key, Value, Compare>::iterator::iterator(const ParentlessAVLTree<Key, Value, Compare>* tree) :
+    tree_(tree), depth_(0)
+{
+
+}
+
+/**
+* Copies only the used part of the path.
+*/
+template<class Key, class Value, class Compare>
+ParentlessAVLTree<Key, Value, Compare>::iterator::iterator(const iterator& other) :
+    tree_(other.tree_), depth_(other.depth_)
+{
+    std::copy(other.path_, other.path_ + depth_, path_);
+}
+
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator&
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator=(const iterator& other)
+{
+    tree_ = other.tree_;
+    depth_ = other.depth_;
+    std::copy(other.path_, other.path_ + depth_, path_);
+    return *this;
+}
+
+/**
+* Returns the node the iterator is on, or NULL at end().
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::TreeNode*
+ParentlessAVLTree<Key, Value, Compare>::iterator::current() const
+{
+    return depth_ == 0 ? NULL : path_[depth_ - 1];
+}
+
+template<class Key, class Value, class Compare>
+void ParentlessAVLTree<Key, Value, Compare>::iterator::pushLeftSpine(TreeNode* node)
+{
+    for (; node != NULL; node = node->left) {
+        path_[depth_++] = node;
+    }
+}
+
+template<class Key, class Value, class Compare>
+void ParentlessAVLTree<Key, Value, Compare>::iterator::pushRightSpine(TreeNode* node)
+{
+    for (; node != NULL; node = node->right) {
+        path_[depth_++] = node;
+    }
+}
+
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> &
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return current()->item;
+}
+
+template<class Key, class Value, class Compare>
+std::pair<const Key,Value> *
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(current()->item);
+}
+
+template<class Key, class Value, class Compare>
+bool ParentlessAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value, class Compare>
+bool ParentlessAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* Advances the iterator to the next item in key order: down to the smallest
+* item of the right subtree, or else back up past every ancestor we are the
+* right child of.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator&
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    TreeNode* node = path_[depth_ - 1];
+    if (node->right != NULL) {
+        pushLeftSpine(node->right);
+        return *this;
+    }
+    --depth_;
+    while (depth_ > 0 && path_[depth_ - 1]->right == node) {
+        node = path_[--depth_];
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++*this;
+    return old;
+}
+
+/**
+* Moves the iterator to the previous item; end() moves to the largest.
+*/
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator&
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator--()
+{
+    if (depth_ == 0) {
+        pushRightSpine(tree_->root_);
+        return *this;
+    }
+    TreeNode* node = path_[depth_ - 1];
+    if (node->left != NULL) {
+        pushRightSpine(node->left);
+        return *this;
+    }
+    --depth_;
+    while (depth_ > 0 && path_[depth_ - 1]->left == node) {
+        node = path_[--depth_];
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename ParentlessAVLTree<Key, Value, Compare>::iterator
+ParentlessAVLTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ParentlessAVLTree::iterator class.
+  -----------------------------------------------
+*/
+
+#endif
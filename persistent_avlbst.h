@@ -0,0 +1,999 @@
+#ifndef PERSISTENT_AVLBST_H
+#define PERSISTENT_AVLBST_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+/**
+* An AVL tree whose old versions stay readable, for readers that need a
+* consistent point-in-time view while a writer keeps going.
+*
+* Nodes never point to their parent, so a subtree can be shared by many
+* versions. Each node counts the links to it: from a parent node, from the
+* tree or from a snapshot_view. insert and remove copy only the nodes on the
+* path they change, together with the nodes their rotations touch, and link
+* the copies to the untouched subtrees. That is O(log n) new nodes per
+* update. A node whose count is 1 is reachable only through the writer's
+* path, so it is updated in place instead of being copied. While no
+* snapshot is alive, writes allocate nothing beyond the new leaf.
+*
+* snapshot() takes one more reference to the root, in O(1). The view it
+* returns never changes and can be iterated for as long as it lives.
+*
+* Only one thread may use the tree itself at a time (including calls to
+* snapshot()). Views can be read, copied and destroyed on any thread,
+* concurrently with writes. The counts are atomic and nodes are allocated
+* with new rather than a NodePool, because whichever thread drops the last
+* link to a node frees it. Items in the tree are read-only, as they may be
+* shared with a view. Change a value with insert().
+*/
+template <typename Key, typename Value, typename Compare = std::less<Key> >
+class PersistentAVLTree
+{
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    // As for ParentlessAVLTree, no AVL tree that fits in memory is taller
+    static const int MAX_HEIGHT = 64;
+
+    struct TreeNode
+    {
+        Item item;
+        TreeNode* left;
+        TreeNode* right;
+        std::atomic<std::uint32_t> refs;
+        int8_t height;
+
+        template<typename K, typename V>
+        TreeNode(K&& key, V&& value) :
+            item(std::forward<K>(key), std::forward<V>(value)), left(NULL), right(NULL), refs(1), height(1) { }
+    };
+
+public:
+    class snapshot_view;
+
+    PersistentAVLTree();
+    explicit PersistentAVLTree(const Compare& comp);
+    ~PersistentAVLTree();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool isBalanced() const;
+    bool empty() const;
+    std::size_t size() const;
+
+    /**
+    * A bidirectional iterator over the items of one version in key order.
+    * Items are read-only. It holds the path from the root to its item and
+    * stays valid while that version is alive: until the next insert or
+    * remove for an iterator from the tree, for as long as the view for an
+    * iterator from a snapshot_view.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        iterator();
+        iterator(const iterator& other);
+        iterator& operator=(const iterator& other);
+
+        const std::pair<const Key,Value>& operator*() const;
+        const std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class PersistentAVLTree<Key, Value, Compare>;
+        friend class snapshot_view;
+        explicit iterator(const TreeNode* root);
+        const TreeNode* current() const;
+        void pushLeftSpine(const TreeNode* node);
+        void pushRightSpine(const TreeNode* node);
+
+        // the root of the version being walked, for -- from end()
+        const TreeNode* root_;
+        // path_[0] is the root and path_[depth_ - 1] the item; end() is empty
+        int depth_;
+        const TreeNode* path_[MAX_HEIGHT];
+    };
+
+    /**
+    * A read-only handle on the tree as it was when snapshot() was called.
+    * Copying one is O(1) and shares the same version.
+    */
+    class snapshot_view
+    {
+    public:
+        snapshot_view();
+        snapshot_view(const snapshot_view& other);
+        snapshot_view& operator=(const snapshot_view& other);
+        ~snapshot_view();
+
+        bool empty() const;
+        std::size_t size() const;
+        iterator begin() const;
+        iterator end() const;
+        iterator find(const Key& key) const;
+        iterator lower_bound(const Key& key) const;
+        iterator upper_bound(const Key& key) const;
+        Compare key_comp() const;
+        Value const & operator[](const Key& key) const;
+
+    protected:
+        friend class PersistentAVLTree<Key, Value, Compare>;
+        snapshot_view(TreeNode* root, std::size_t size, const Compare& comp);
+
+        TreeNode* root_;
+        std::size_t size_;
+        Compare comp_;
+    };
+
+    snapshot_view snapshot() const;
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    Compare key_comp() const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    template<typename K, typename V>
+    TreeNode* insertAt(TreeNode* node, K&& key, V&& value, bool& inserted);
+    TreeNode* removeAt(TreeNode* node, const Key& key);
+    TreeNode* removeMin(TreeNode* node, TreeNode*& min);
+    static TreeNode* own(TreeNode* node);
+    static TreeNode* retain(TreeNode* node);
+    static void release(TreeNode* node);
+    static TreeNode* rebalance(TreeNode* node);
+    static TreeNode* rotateRight(TreeNode* node);
+    static TreeNode* rotateLeft(TreeNode* node);
+    static int height(const TreeNode* node);
+    static void updateHeight(TreeNode* node);
+    static const TreeNode* findNodeIn(const TreeNode* root, const Key& key, const Compare& comp);
+    static iterator beginIn(const TreeNode* root);
+    static iterator findIn(const TreeNode* root, const Key& key, const Compare& comp);
+    static iterator boundIn(const TreeNode* root, const Key& key, const Compare& comp, bool upper);
+    int balanceHelper(const TreeNode* node) const;
+
+private:
+    PersistentAVLTree(const PersistentAVLTree&);
+    PersistentAVLTree& operator=(const PersistentAVLTree&);
+
+protected:
+    TreeNode* root_;
+    std::size_t size_;
+    Compare comp_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the PersistentAVLTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty PersistentAVLTree.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree() : root_(NULL), size_(0), comp_()
+{
+
+}
+
+/**
+* Constructor for an empty PersistentAVLTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::PersistentAVLTree(const Compare& comp) :
+    root_(NULL), size_(0), comp_(comp)
+{
+
+}
+
+/**
+* Drops the tree's link to the current version. Nodes that a live view
+* still reaches are left to it.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::~PersistentAVLTree()
+{
+    clear();
+}
+
+/**
+* Empties the tree in O(1) if a view shares the root, or by freeing the
+* nodes otherwise.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::clear()
+{
+    release(root_);
+    root_ = NULL;
+    size_ = 0;
+}
+
+/**
+* Returns true if tree is empty
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+* Returns the number of items in the tree
+*/
+template<class Key, class Value, class Compare>
+std::size_t PersistentAVLTree<Key, Value, Compare>::size() const
+{
+    return size_;
+}
+
+/**
+* Return true iff the tree is height-balanced.
+*/
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::isBalanced() const
+{
+    return balanceHelper(root_) != -1;
+}
+
+/**
+* Returns the height of the subtree at node, or -1 if it is not balanced or
+* its stored height is wrong.
+*/
+template<class Key, class Value, class Compare>
+int PersistentAVLTree<Key, Value, Compare>::balanceHelper(const TreeNode* node) const
+{
+    if (node == NULL) {
+        return 0;
+    }
+    int left = balanceHelper(node->left);
+    int right = balanceHelper(node->right);
+    if (left == -1 || right == -1 || left - right > 1 || right - left > 1 || node->height != 1 + std::max(left, right)) {
+        return -1;
+    }
+    return 1 + std::max(left, right);
+}
+
+/**
+* Returns a view of the tree as it is now, in O(1). Later inserts and
+* removes copy the nodes they change instead of touching the view's.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::snapshot_view
+PersistentAVLTree<Key, Value, Compare>::snapshot() const
+{
+    return snapshot_view(root_, size_, comp_);
+}
+
+/**
+* An insert method to insert into the tree. If key is already in the tree,
+* its value is overwritten.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool inserted = false;
+    root_ = insertAt(root_, keyValuePair.first, keyValuePair.second, inserted);
+    if (inserted) {
+        ++size_;
+    }
+}
+
+/**
+* Inserts key into the subtree at node, which the caller's link owns, and
+* returns the subtree's new root. Each node on the way down is made the
+* writer's own before it is changed.
+*/
+template<class Key, class Value, class Compare>
+template<typename K, typename V>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::insertAt(TreeNode* node, K&& key, V&& value, bool& inserted)
+{
+    if (node == NULL) {
+        inserted = true;
+        return new TreeNode(std::forward<K>(key), std::forward<V>(value));
+    }
+    //a subtree that kept its height leaves nothing above it to fix, which
+    //saves looking at the other child
+    if (comp_(key, node->item.first)) {
+        node = own(node);
+        int before = height(node->left);
+        node->left = insertAt(node->left, std::forward<K>(key), std::forward<V>(value), inserted);
+        return height(node->left) == before ? node : rebalance(node);
+    }
+    if (comp_(node->item.first, key)) {
+        node = own(node);
+        int before = height(node->right);
+        node->right = insertAt(node->right, std::forward<K>(key), std::forward<V>(value), inserted);
+        return height(node->right) == before ? node : rebalance(node);
+    }
+
+    //the key is here already, so only the value changes
+    inserted = false;
+    if (node->refs.load(std::memory_order_acquire) == 1) {
+        node->item.second = std::forward<V>(value);
+        return node;
+    }
+    TreeNode* copy = new TreeNode(node->item.first, std::forward<V>(value));
+    copy->left = retain(node->left);
+    copy->right = retain(node->right);
+    copy->height = node->height;
+    release(node);
+    return copy;
+}
+
+/**
+* Removes the item with the specified key, if it is in the tree.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::remove(const Key& key)
+{
+    //check first, so a missing key does not copy the path for nothing
+    if (findNodeIn(root_, key, comp_) == NULL) {
+        return;
+    }
+    root_ = removeAt(root_, key);
+    --size_;
+}
+
+/**
+* Removes key, which is in the subtree at node, and returns the subtree's
+* new root. A node with two children is replaced by the smallest node of
+* its right subtree.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::removeAt(TreeNode* node, const Key& key)
+{
+    if (comp_(key, node->item.first)) {
+        node = own(node);
+        int before = height(node->left);
+        node->left = removeAt(node->left, key);
+        return height(node->left) == before ? node : rebalance(node);
+    }
+    if (comp_(node->item.first, key)) {
+        node = own(node);
+        int before = height(node->right);
+        node->right = removeAt(node->right, key);
+        return height(node->right) == before ? node : rebalance(node);
+    }
+    if (node->left == NULL || node->right == NULL) {
+        TreeNode* child = node->left != NULL ? node->left : node->right;
+        //the caller's link moves to the child
+        retain(child);
+        release(node);
+        return child;
+    }
+    //the children are relinked under the smallest node on the right
+    TreeNode* left = retain(node->left);
+    TreeNode* right = retain(node->right);
+    release(node);
+    TreeNode* min = NULL;
+    right = removeMin(right, min);
+    min->left = left;
+    min->right = right;
+    return rebalance(min);
+}
+
+/**
+* Takes the smallest node out of the subtree at node, returning what is left
+* of the subtree. min is set to a node with that item, no children and one
+* reference, held by the caller: the node itself if only this path reached
+* it, or else a copy.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::removeMin(TreeNode* node, TreeNode*& min)
+{
+    if (node->left != NULL) {
+        node = own(node);
+        int before = height(node->left);
+        node->left = removeMin(node->left, min);
+        return height(node->left) == before ? node : rebalance(node);
+    }
+    TreeNode* right = node->right;
+    if (node->refs.load(std::memory_order_acquire) == 1) {
+        node->right = NULL;
+        node->height = 1;
+        min = node;
+        return right;
+    }
+    min = new TreeNode(node->item.first, node->item.second);
+    retain(right);
+    release(node);
+    return right;
+}
+
+/**
+* Returns node if the caller's link is the only one to it, so it can be
+* changed in place, or else a copy linked to the same children that
+* replaces the caller's link. Callers only change a node after owning its
+* parent. So a count of 1 means no view can reach the node, since a shared
+* parent would have been copied and its copy would count as a second link.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::own(TreeNode* node)
+{
+    if (node->refs.load(std::memory_order_acquire) == 1) {
+        return node;
+    }
+    TreeNode* copy = new TreeNode(node->item.first, node->item.second);
+    copy->left = retain(node->left);
+    copy->right = retain(node->right);
+    copy->height = node->height;
+    release(node);
+    return copy;
+}
+
+/**
+* Counts one more link to node, which may be NULL, and returns it.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::retain(TreeNode* node)
+{
+    if (node != NULL) {
+        node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+/**
+* Drops one link to node, which may be NULL. The last link frees the node
+* and drops its links to its children. Only nodes whose last link is gone
+* are descended into, so the recursion is no deeper than the tree.
+*/
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::release(TreeNode* node)
+{
+    if (node == NULL || node->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    release(node->left);
+    release(node->right);
+    delete node;
+}
+
+template<class Key, class Value, class Compare>
+int PersistentAVLTree<Key, Value, Compare>::height(const TreeNode* node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::updateHeight(TreeNode* node)
+{
+    node->height = (int8_t)(1 + std::max(height(node->left), height(node->right)));
+}
+
+/**
+* Recomputes the height of node, which the writer owns, and rotates it if
+* its subtrees now differ in height by two. Returns the node that took its
+* place. The children that move are made the writer's own first.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::rebalance(TreeNode* node)
+{
+    updateHeight(node);
+    int balance = height(node->right) - height(node->left);
+    if (balance > 1) {
+        node->right = own(node->right);
+        if (height(node->right->left) > height(node->right->right)) {
+            node->right->left = own(node->right->left);
+            node->right = rotateRight(node->right);
+        }
+        return rotateLeft(node);
+    }
+    if (balance < -1) {
+        node->left = own(node->left);
+        if (height(node->left->right) > height(node->left->left)) {
+            node->left->right = own(node->left->right);
+            node->left = rotateLeft(node->left);
+        }
+        return rotateRight(node);
+    }
+    return node;
+}
+
+/**
+* Makes the left child of node the root of the subtree and returns it. Both
+* must be the writer's own. Links only move, so no counts change.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::rotateRight(TreeNode* node)
+{
+    TreeNode* child = node->left;
+    node->left = child->right;
+    child->right = node;
+    updateHeight(node);
+    updateHeight(child);
+    return child;
+}
+
+/**
+* Makes the right child of node the root of the subtree and returns it.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::rotateLeft(TreeNode* node)
+{
+    TreeNode* child = node->right;
+    node->right = child->left;
+    child->left = node;
+    updateHeight(node);
+    updateHeight(child);
+    return child;
+}
+
+/**
+* Returns the node holding key in the version rooted at root, or NULL.
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::findNodeIn(const TreeNode* root, const Key& key, const Compare& comp)
+{
+    const TreeNode* current = root;
+    while (current != NULL) {
+        if (comp(key, current->item.first)) {
+            current = current->left;
+        }
+        else if (comp(current->item.first, key)) {
+            current = current->right;
+        }
+        else {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+/**
+* Returns an iterator to the first item of the version rooted at root.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::beginIn(const TreeNode* root)
+{
+    iterator it(root);
+    it.pushLeftSpine(root);
+    return it;
+}
+
+/**
+* Returns an iterator to the item with key in the version rooted at root,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::findIn(const TreeNode* root, const Key& key, const Compare& comp)
+{
+    iterator it(root);
+    const TreeNode* current = root;
+    while (current != NULL) {
+        it.path_[it.depth_++] = current;
+        if (comp(key, current->item.first)) {
+            current = current->left;
+        }
+        else if (comp(current->item.first, key)) {
+            current = current->right;
+        }
+        else {
+            return it;
+        }
+    }
+    return iterator(root);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key if
+* upper is set, or not less than key otherwise, in the version rooted at
+* root. The path is cut at the last node it went left from.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::boundIn(const TreeNode* root, const Key& key, const Compare& comp, bool upper)
+{
+    iterator it(root);
+    int bestDepth = 0;
+    const TreeNode* current = root;
+    while (current != NULL) {
+        it.path_[it.depth_++] = current;
+        bool goLeft = upper ? comp(key, current->item.first) : !comp(current->item.first, key);
+        if (goLeft) {
+            bestDepth = it.depth_;
+            current = current->left;
+        }
+        else {
+            current = current->right;
+        }
+    }
+    it.depth_ = bestDepth;
+    return it;
+}
+
+/**
+* Returns an iterator to the first item in the tree.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::begin() const
+{
+    return beginIn(root_);
+}
+
+/**
+* Returns an iterator whose value means INVALID
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::end() const
+{
+    return iterator(root_);
+}
+
+/**
+* Returns an iterator to the item with the given key, k
+* or the end iterator if k does not exist in the tree
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::find(const Key& key) const
+{
+    return findIn(root_, key, comp_);
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::lower_bound(const Key& key) const
+{
+    return boundIn(root_, key, comp_, false);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than key,
+* or end() if there is none.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::upper_bound(const Key& key) const
+{
+    return boundIn(root_, key, comp_, true);
+}
+
+/**
+* Returns the comparator the tree is ordered by.
+*/
+template<class Key, class Value, class Compare>
+Compare PersistentAVLTree<Key, Value, Compare>::key_comp() const
+{
+    return comp_;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, class Compare>
+Value const & PersistentAVLTree<Key, Value, Compare>::operator[](const Key& key) const
+{
+    const TreeNode* node = findNodeIn(root_, key, comp_);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PersistentAVLTree class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the PersistentAVLTree::snapshot_view class.
+  -----------------------------------------------
+*/
+
+/**
+* An empty view.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::snapshot_view() : root_(NULL), size_(0), comp_()
+{
+
+}
+
+/**
+* Takes a link to root, keeping that version alive.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::snapshot_view(TreeNode* root, std::size_t size, const Compare& comp) :
+    root_(retain(root)), size_(size), comp_(comp)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::snapshot_view(const snapshot_view& other) :
+    root_(retain(other.root_)), size_(other.size_), comp_(other.comp_)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::snapshot_view&
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::operator=(const snapshot_view& other)
+{
+    //retain first, in case both views hold the same version
+    TreeNode* root = retain(other.root_);
+    release(root_);
+    root_ = root;
+    size_ = other.size_;
+    comp_ = other.comp_;
+    return *this;
+}
+
+/**
+* Drops the view's link to its version, freeing whatever nodes no newer
+* version or other view still reaches.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::~snapshot_view()
+{
+    release(root_);
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::snapshot_view::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value, class Compare>
+std::size_t PersistentAVLTree<Key, Value, Compare>::snapshot_view::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::begin() const
+{
+    return beginIn(root_);
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::end() const
+{
+    return iterator(root_);
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::find(const Key& key) const
+{
+    return findIn(root_, key, comp_);
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::lower_bound(const Key& key) const
+{
+    return boundIn(root_, key, comp_, false);
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::snapshot_view::upper_bound(const Key& key) const
+{
+    return boundIn(root_, key, comp_, true);
+}
+
+template<class Key, class Value, class Compare>
+Compare PersistentAVLTree<Key, Value, Compare>::snapshot_view::key_comp() const
+{
+    return comp_;
+}
+
+template<class Key, class Value, class Compare>
+Value const & PersistentAVLTree<Key, Value, Compare>::snapshot_view::operator[](const Key& key) const
+{
+    const TreeNode* node = findNodeIn(root_, key, comp_);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    return node->item.second;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PersistentAVLTree::snapshot_view class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the PersistentAVLTree::iterator class.
+  -----------------------------------------------
+*/
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::iterator::iterator() : root_(NULL), depth_(0)
+{
+
+}
+
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::iterator::iterator(const TreeNode* root) :
+    root_(root), depth_(0)
+{
+
+}
+
+/**
+* Copies only the used part of the path.
+*/
+template<class Key, class Value, class Compare>
+PersistentAVLTree<Key, Value, Compare>::iterator::iterator(const iterator& other) :
+    root_(other.root_), depth_(other.depth_)
+{
+    std::copy(other.path_, other.path_ + depth_, path_);
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator&
+PersistentAVLTree<Key, Value, Compare>::iterator::operator=(const iterator& other)
+{
+    root_ = other.root_;
+    depth_ = other.depth_;
+    std::copy(other.path_, other.path_ + depth_, path_);
+    return *this;
+}
+
+/**
+* Returns the node the iterator is on, or NULL at end().
+*/
+template<class Key, class Value, class Compare>
+const typename PersistentAVLTree<Key, Value, Compare>::TreeNode*
+PersistentAVLTree<Key, Value, Compare>::iterator::current() const
+{
+    return depth_ == 0 ? NULL : path_[depth_ - 1];
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::iterator::pushLeftSpine(const TreeNode* node)
+{
+    for (; node != NULL; node = node->left) {
+        path_[depth_++] = node;
+    }
+}
+
+template<class Key, class Value, class Compare>
+void PersistentAVLTree<Key, Value, Compare>::iterator::pushRightSpine(const TreeNode* node)
+{
+    for (; node != NULL; node = node->right) {
+        path_[depth_++] = node;
+    }
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> &
+PersistentAVLTree<Key, Value, Compare>::iterator::operator*() const
+{
+    return current()->item;
+}
+
+template<class Key, class Value, class Compare>
+const std::pair<const Key,Value> *
+PersistentAVLTree<Key, Value, Compare>::iterator::operator->() const
+{
+    return &(current()->item);
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator::operator==(const iterator& rhs) const
+{
+    return current() == rhs.current();
+}
+
+template<class Key, class Value, class Compare>
+bool PersistentAVLTree<Key, Value, Compare>::iterator::operator!=(const iterator& rhs) const
+{
+    return current() != rhs.current();
+}
+
+/**
+* Advances the iterator to the next item in key order, as
+* ParentlessAVLTree::iterator does.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator&
+PersistentAVLTree<Key, Value, Compare>::iterator::operator++()
+{
+    const TreeNode* node = path_[depth_ - 1];
+    if (node->right != NULL) {
+        pushLeftSpine(node->right);
+        return *this;
+    }
+    --depth_;
+    while (depth_ > 0 && path_[depth_ - 1]->right == node) {
+        node = path_[--depth_];
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++*this;
+    return old;
+}
+
+/**
+* Moves the iterator to the previous item; end() moves to the largest.
+*/
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator&
+PersistentAVLTree<Key, Value, Compare>::iterator::operator--()
+{
+    if (depth_ == 0) {
+        pushRightSpine(root_);
+        return *this;
+    }
+    const TreeNode* node = path_[depth_ - 1];
+    if (node->left != NULL) {
+        pushRightSpine(node->left);
+        return *this;
+    }
+    --depth_;
+    while (depth_ > 0 && path_[depth_ - 1]->left == node) {
+        node = path_[--depth_];
+    }
+    return *this;
+}
+
+template<class Key, class Value, class Compare>
+typename PersistentAVLTree<Key, Value, Compare>::iterator
+PersistentAVLTree<Key, Value, Compare>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --*this;
+    return old;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the PersistentAVLTree::iterator class.
+  -----------------------------------------------
+*/
+
+#endif
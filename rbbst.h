@@ -0,0 +1,490 @@
+#ifndef RBBST_H
+#define RBBST_H
+
+#include <iostream>
+#include <cstdlib>
+#include "bst.h"
+
+/**
+* A node for a red-black tree, which adds the node's color to the base Node.
+*/
+template <typename Key, typename Value>
+class RBNode : public Node<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    RBNode(const Key& key, const Value& value, RBNode<Key, Value>* parent);
+    RBNode(Key&& key, Value&& value, RBNode<Key, Value>* parent);
+    ~RBNode();
+
+    // Getter/setter for the node's color.
+    bool isRed() const;
+    void setRed(bool red);
+
+    // Getters for parent, left, and right, redefined to return RBNodes.
+    // See AVLNode in avlbst.h for why they hide rather than override.
+    RBNode<Key, Value>* getParent() const;
+    RBNode<Key, Value>* getLeft() const;
+    RBNode<Key, Value>* getRight() const;
+
+protected:
+    bool red_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the RBNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class
+* constructor. New nodes are red.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(const Key& key, const Value& value, RBNode<Key, Value> *parent) :
+    Node<Key, Value>(key, value, parent), red_(true)
+{
+
+}
+
+/**
+* An explicit constructor that moves the key and value into the node
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::RBNode(Key&& key, Value&& value, RBNode<Key, Value> *parent) :
+    Node<Key, Value>(std::move(key), std::move(value), parent), red_(true)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+RBNode<Key, Value>::~RBNode()
+{
+
+}
+
+/**
+* A getter for the color of a RBNode.
+*/
+template<class Key, class Value>
+bool RBNode<Key, Value>::isRed() const
+{
+    return red_;
+}
+
+/**
+* A setter for the color of a RBNode.
+*/
+template<class Key, class Value>
+void RBNode<Key, Value>::setRed(bool red)
+{
+    red_ = red;
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getParent() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->parent_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getLeft() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->left_);
+}
+
+template<class Key, class Value>
+RBNode<Key, Value> *RBNode<Key, Value>::getRight() const
+{
+    return static_cast<RBNode<Key, Value>*>(this->right_);
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the RBNode class.
+  -----------------------------------------------
+*/
+
+/**
+* A red-black tree. It keeps a looser balance than AVLTree (the longest path
+* is at most twice the shortest), and in exchange an insert makes at most two
+* rotations and a remove at most three, however far up the recoloring goes.
+* Workloads with many removes spend less time rebalancing than with
+* AVLTree::removeFix, which can rotate at every level.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class RBTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    RBTree();
+    explicit RBTree(const Compare& comp);
+    template<typename InputIt>
+    RBTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
+    virtual ~RBTree();
+    virtual void remove(const Key& key);
+protected:
+    virtual void nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2);
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* createNode(Key&& key, Value&& value, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual void afterInsert(Node<Key, Value>* node);
+    virtual void afterBuild();
+
+    // Add helper functions here
+    void insertFix(RBNode<Key, Value>* node);
+    void removeFix(RBNode<Key, Value>* node);
+    void rotateRight(RBNode<Key, Value>* node);
+    void rotateLeft(RBNode<Key, Value>* node);
+    void colorBuilt(RBNode<Key, Value>* node, int depth, int redDepth);
+    static bool isRed(RBNode<Key, Value>* node);
+};
+
+/**
+* Default constructor for an empty RBTree.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::RBTree() : BinarySearchTree<Key, Value, Compare>()
+{
+
+}
+
+/**
+* Constructor for an empty RBTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::RBTree(const Compare& comp) : BinarySearchTree<Key, Value, Compare>(comp)
+{
+
+}
+
+/**
+* Constructs a balanced RBTree from the key/value pairs in [first, last) in
+* linear time. See BinarySearchTree::assign().
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+RBTree<Key, Value, Compare>::RBTree(InputIt first, InputIt last, bool sorted, const Compare& comp) : BinarySearchTree<Key, Value, Compare>(comp)
+{
+    this->assign(first, last, sorted);
+}
+
+/**
+* Clears the tree here so that the nodes are destroyed through
+* RBTree::destroyNode.
+*/
+template<class Key, class Value, class Compare>
+RBTree<Key, Value, Compare>::~RBTree()
+{
+    this->clear();
+}
+
+/**
+* Allocates a RBNode from the tree's pool.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* RBTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return this->pool_.template create<RBNode<Key, Value> >(key, value, static_cast<RBNode<Key, Value>*>(parent));
+}
+
+/**
+* Allocates a RBNode from the tree's pool, moving the key and value into it.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* RBTree<Key, Value, Compare>::createNode(Key&& key, Value&& value, Node<Key, Value>* parent)
+{
+    return this->pool_.template create<RBNode<Key, Value> >(std::move(key), std::move(value), static_cast<RBNode<Key, Value>*>(parent));
+}
+
+/**
+* Destroys a RBNode and returns its memory to the pool.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    this->pool_.destroy(static_cast<RBNode<Key, Value>*>(node));
+}
+
+/**
+* Null children count as black.
+*/
+template<class Key, class Value, class Compare>
+bool RBTree<Key, Value, Compare>::isRed(RBNode<Key, Value>* node)
+{
+    return node != nullptr && node->isRed();
+}
+
+/**
+* Colors a bulk-loaded tree. A tree built by halves has every empty child
+* slot at depth D or D + 1, where D is the depth of its deepest nodes. Making
+* the deepest level red (unless it is the root) and everything else black
+* puts D black nodes on every path, with no red node under another.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::afterBuild()
+{
+    int deepest = -1;
+    for (Node<Key, Value>* node = this->root_; node != nullptr; node = node->getLeft()) {
+        ++deepest;
+    }
+    colorBuilt(static_cast<RBNode<Key, Value>*>(this->root_), 0, deepest > 0 ? deepest : -1);
+}
+
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::colorBuilt(RBNode<Key, Value>* node, int depth, int redDepth)
+{
+    if (node == nullptr) {
+        return;
+    }
+    node->setRed(depth == redDepth);
+    colorBuilt(node->getLeft(), depth + 1, redDepth);
+    colorBuilt(node->getRight(), depth + 1, redDepth);
+}
+
+/*
+ * Restores the red-black rules after BinarySearchTree has linked a new red
+ * leaf into the tree. A red uncle is handled by recoloring and moving up two
+ * levels; a black uncle by at most two rotations, after which we are done.
+ */
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+    RBNode<Key, Value>* newNode = static_cast<RBNode<Key, Value>*>(node);
+    newNode->setRed(true);
+    insertFix(newNode);
+}
+
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::insertFix(RBNode<Key, Value>* node)
+{
+    RBNode<Key, Value>* parent = node->getParent();
+    while (isRed(parent)) {
+        //a red parent is never the root, so the grandparent exists
+        RBNode<Key, Value>* grandparent = parent->getParent();
+        bool parentIsLeft = grandparent->getLeft() == parent;
+        RBNode<Key, Value>* uncle = parentIsLeft ? grandparent->getRight() : grandparent->getLeft();
+
+        //red uncle: push the grandparent's black down and continue from it
+        if (isRed(uncle)) {
+            parent->setRed(false);
+            uncle->setRed(false);
+            grandparent->setRed(true);
+            node = grandparent;
+            parent = node->getParent();
+            continue;
+        }
+
+        //black uncle, zig-zag: rotate the node above its parent first
+        if (parentIsLeft && node == parent->getRight()) {
+            rotateLeft(parent);
+            node = parent;
+            parent = node->getParent();
+        }
+        else if (!parentIsLeft && node == parent->getLeft()) {
+            rotateRight(parent);
+            node = parent;
+            parent = node->getParent();
+        }
+
+        //black uncle, zig-zig: the parent takes the grandparent's place
+        parent->setRed(false);
+        grandparent->setRed(true);
+        if (parentIsLeft) {
+            rotateRight(grandparent);
+        }
+        else {
+            rotateLeft(grandparent);
+        }
+        break;
+    }
+    static_cast<RBNode<Key, Value>*>(this->root_)->setRed(false);
+}
+
+/*
+ * Recall: The writeup specifies that if a node has 2 children you
+ * should swap with the predecessor and then remove.
+ */
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::remove(const Key& key)
+{
+    RBNode<Key, Value>* current = static_cast<RBNode<Key, Value>*>(this->internalFind(key));
+    if (current == nullptr) {
+        return;
+    }
+    this->beforeRemove(current);
+
+    //2 child case: swap with the predecessor, which has at most one child
+    if (current->getLeft() != nullptr && current->getRight() != nullptr) {
+        RBNode<Key, Value>* pred = static_cast<RBNode<Key, Value>*>(
+            BinarySearchTree<Key, Value, Compare>::predecessor(current));
+        nodeSwap(current, pred);
+    }
+
+    RBNode<Key, Value>* child = current->getLeft() != nullptr ? current->getLeft() : current->getRight();
+    //removing a black leaf shortens its paths, so fix that while it is still in place
+    if (!current->isRed() && child == nullptr) {
+        removeFix(current);
+    }
+    //a black node with one child always has a red leaf there, which takes its color
+    else if (child != nullptr) {
+        child->setRed(false);
+    }
+
+    //unlink current, promoting its child if it has one
+    RBNode<Key, Value>* parent = current->getParent();
+    if (child != nullptr) {
+        child->setParent(parent);
+    }
+    if (parent == nullptr) {
+        this->root_ = child;
+    }
+    else if (parent->getLeft() == current) {
+        parent->setLeft(child);
+    }
+    else {
+        parent->setRight(child);
+    }
+    destroyNode(current);
+    --this->size_;
+}
+
+/**
+* Called on a black leaf that is about to be removed, which would leave its
+* paths one black node short. The shortage moves up through black siblings
+* by recoloring; a red sibling is rotated out of the way first, and a sibling
+* with a red child ends it with one or two rotations.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::removeFix(RBNode<Key, Value>* node)
+{
+    while (node != this->root_ && !node->isRed()) {
+        RBNode<Key, Value>* parent = node->getParent();
+        bool nodeIsLeft = parent->getLeft() == node;
+        //node is short a black, so its sibling has at least one
+        RBNode<Key, Value>* sibling = nodeIsLeft ? parent->getRight() : parent->getLeft();
+
+        if (sibling->isRed()) {
+            sibling->setRed(false);
+            parent->setRed(true);
+            if (nodeIsLeft) {
+                rotateLeft(parent);
+            }
+            else {
+                rotateRight(parent);
+            }
+            sibling = nodeIsLeft ? parent->getRight() : parent->getLeft();
+        }
+
+        RBNode<Key, Value>* nearNephew = nodeIsLeft ? sibling->getLeft() : sibling->getRight();
+        RBNode<Key, Value>* farNephew = nodeIsLeft ? sibling->getRight() : sibling->getLeft();
+        if (!isRed(nearNephew) && !isRed(farNephew)) {
+            sibling->setRed(true);
+            node = parent;
+            continue;
+        }
+
+        if (!isRed(farNephew)) {
+            nearNephew->setRed(false);
+            sibling->setRed(true);
+            if (nodeIsLeft) {
+                rotateRight(sibling);
+            }
+            else {
+                rotateLeft(sibling);
+            }
+            sibling = nodeIsLeft ? parent->getRight() : parent->getLeft();
+            farNephew = nodeIsLeft ? sibling->getRight() : sibling->getLeft();
+        }
+
+        sibling->setRed(parent->isRed());
+        parent->setRed(false);
+        farNephew->setRed(false);
+        if (nodeIsLeft) {
+            rotateLeft(parent);
+        }
+        else {
+            rotateRight(parent);
+        }
+        return;
+    }
+    node->setRed(false);
+}
+
+/**
+* Makes the left child of node its parent.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::rotateRight(RBNode<Key, Value>* node)
+{
+    RBNode<Key, Value>* child = node->getLeft();
+    RBNode<Key, Value>* parent = node->getParent();
+
+    //child's right subtree moves across to node
+    node->setLeft(child->getRight());
+    if (child->getRight() != nullptr) {
+        child->getRight()->setParent(node);
+    }
+
+    //child takes node's place under parent
+    child->setParent(parent);
+    if (parent == nullptr) {
+        this->root_ = child;
+    }
+    else if (parent->getLeft() == node) {
+        parent->setLeft(child);
+    }
+    else {
+        parent->setRight(child);
+    }
+
+    child->setRight(node);
+    node->setParent(child);
+}
+
+/**
+* Makes the right child of node its parent.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::rotateLeft(RBNode<Key, Value>* node)
+{
+    RBNode<Key, Value>* child = node->getRight();
+    RBNode<Key, Value>* parent = node->getParent();
+
+    node->setRight(child->getLeft());
+    if (child->getLeft() != nullptr) {
+        child->getLeft()->setParent(node);
+    }
+
+    child->setParent(parent);
+    if (parent == nullptr) {
+        this->root_ = child;
+    }
+    else if (parent->getLeft() == node) {
+        parent->setLeft(child);
+    }
+    else {
+        parent->setRight(child);
+    }
+
+    child->setLeft(node);
+    node->setParent(child);
+}
+
+/**
+* Swaps the positions of two nodes. Colors belong to positions in the tree,
+* so they are swapped back.
+*/
+template<class Key, class Value, class Compare>
+void RBTree<Key, Value, Compare>::nodeSwap( RBNode<Key,Value>* n1, RBNode<Key,Value>* n2)
+{
+    BinarySearchTree<Key, Value, Compare>::nodeSwap(n1, n2);
+    bool tempRed = n1->isRed();
+    n1->setRed(n2->isRed());
+    n2->setRed(tempRed);
+}
+
+#endif
@@ -0,0 +1,311 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+* Buffered, sequential binary output to a file, used by
+* BinarySearchTree::save(). Small writes are gathered into a large buffer so
+* the file is written in big sequential chunks.
+*/
+class SnapshotWriter
+{
+public:
+    explicit SnapshotWriter(const std::string& path);
+    ~SnapshotWriter();
+
+    void write(const void* data, std::size_t bytes);
+    void close();
+
+private:
+    SnapshotWriter(const SnapshotWriter&);
+    SnapshotWriter& operator=(const SnapshotWriter&);
+    void flush();
+
+    static const std::size_t BUFFER_BYTES = 1 << 20;
+
+    std::FILE* file_;
+    std::vector<char> buffer_;
+    std::size_t used_;
+};
+
+/**
+* Buffered, sequential binary input from a file, used by
+* BinarySearchTree::load(). Reading past the end of the file throws.
+*/
+class SnapshotReader
+{
+public:
+    explicit SnapshotReader(const std::string& path);
+    ~SnapshotReader();
+
+    void read(void* data, std::size_t bytes);
+    std::uint64_t fileSize() const;
+
+private:
+    SnapshotReader(const SnapshotReader&);
+    SnapshotReader& operator=(const SnapshotReader&);
+
+    static const std::size_t BUFFER_BYTES = 1 << 20;
+
+    std::FILE* file_;
+    std::vector<char> buffer_;
+    std::size_t pos_;
+    std::size_t end_;
+    std::uint64_t fileSize_;
+};
+
+/**
+* Writes and reads one key or value in a snapshot. Types that are trivially
+* copyable are stored as their raw bytes; std::string is stored as a 64-bit
+* length followed by its characters. Other types can be saved by
+* specializing SnapshotSerializer with the same static members. FIXED_BYTES
+* is the size of every encoded value, or 0 if it varies.
+*/
+template<typename T, typename = void>
+struct SnapshotSerializer
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+        "specialize SnapshotSerializer to save keys or values of this type");
+};
+
+template<typename T>
+struct SnapshotSerializer<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type>
+{
+    static const std::size_t FIXED_BYTES = sizeof(T);
+
+    static void write(SnapshotWriter& out, const T& value)
+    {
+        out.write(&value, sizeof(T));
+    }
+
+    static T read(SnapshotReader& in)
+    {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type raw;
+        in.read(&raw, sizeof(T));
+        return *reinterpret_cast<T*>(&raw);
+    }
+};
+
+template<>
+struct SnapshotSerializer<std::string>
+{
+    static const std::size_t FIXED_BYTES = 0;
+
+    static void write(SnapshotWriter& out, const std::string& value)
+    {
+        std::uint64_t length = value.size();
+        out.write(&length, sizeof(length));
+        out.write(value.data(), value.size());
+    }
+
+    static std::string read(SnapshotReader& in)
+    {
+        std::uint64_t length = 0;
+        in.read(&length, sizeof(length));
+        //a corrupt length would otherwise be allocated before the read fails
+        if (length > in.fileSize()) {
+            throw std::runtime_error("Snapshot is corrupt");
+        }
+        std::string value((std::size_t)length, '\0');
+        if (length > 0) {
+            in.read(&value[0], (std::size_t)length);
+        }
+        return value;
+    }
+};
+
+/**
+* The fixed-size start of a snapshot file. It is followed by count items in
+* key order, each a key and then a value as written by SnapshotSerializer.
+* Everything is in the byte order of the machine that saved it.
+*/
+struct SnapshotHeader
+{
+    char magic[8];
+    // sizeof(Key) and sizeof(Value) of the saved tree, to catch loading
+    // into a tree of a different type
+    std::uint32_t keyBytes;
+    std::uint32_t valueBytes;
+    std::uint64_t count;
+};
+
+static const char SNAPSHOT_MAGIC[8] = { 'B', 'S', 'T', 'S', 'N', 'A', 'P', '1' };
+
+/**
+* Decodes the items of a snapshot one at a time, as the forward iterator that
+* BinarySearchTree::assignSorted() builds a tree from. It only supports what
+* that needs: -> to look at the current item and ++ to decode the next.
+*/
+template<typename Key, typename Value>
+class SnapshotItemReader
+{
+public:
+    SnapshotItemReader(SnapshotReader& in, std::uint64_t count) : in_(&in), remaining_(count), item_()
+    {
+        next();
+    }
+
+    const std::pair<Key, Value>* operator->() const
+    {
+        return &item_;
+    }
+
+    SnapshotItemReader& operator++()
+    {
+        next();
+        return *this;
+    }
+
+private:
+    void next()
+    {
+        if (remaining_ == 0) {
+            return;
+        }
+        --remaining_;
+        //the key has to be read before the value
+        Key key = SnapshotSerializer<Key>::read(*in_);
+        item_ = std::pair<Key, Value>(std::move(key), SnapshotSerializer<Value>::read(*in_));
+    }
+
+    SnapshotReader* in_;
+    std::uint64_t remaining_;
+    std::pair<Key, Value> item_;
+};
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SnapshotWriter class.
+  -----------------------------------------------
+*/
+
+inline SnapshotWriter::SnapshotWriter(const std::string& path) :
+    file_(std::fopen(path.c_str(), "wb")), buffer_(BUFFER_BYTES), used_(0)
+{
+    if (file_ == NULL) {
+        throw std::runtime_error("Cannot open " + path + " for writing");
+    }
+}
+
+/**
+* Closes the file if close() was not called. Errors are ignored here, so
+* callers that care should call close().
+*/
+inline SnapshotWriter::~SnapshotWriter()
+{
+    if (file_ != NULL) {
+        std::fclose(file_);
+    }
+}
+
+inline void SnapshotWriter::write(const void* data, std::size_t bytes)
+{
+    if (bytes > buffer_.size() - used_) {
+        flush();
+        //too big to be worth buffering
+        if (bytes >= buffer_.size()) {
+            if (std::fwrite(data, 1, bytes, file_) != bytes) {
+                throw std::runtime_error("Snapshot write failed");
+            }
+            return;
+        }
+    }
+    std::memcpy(&buffer_[used_], data, bytes);
+    used_ += bytes;
+}
+
+inline void SnapshotWriter::flush()
+{
+    if (used_ > 0 && std::fwrite(&buffer_[0], 1, used_, file_) != used_) {
+        throw std::runtime_error("Snapshot write failed");
+    }
+    used_ = 0;
+}
+
+/**
+* Writes out the buffer and closes the file, throwing if any of it failed.
+*/
+inline void SnapshotWriter::close()
+{
+    flush();
+    std::FILE* file = file_;
+    file_ = NULL;
+    if (std::fclose(file) != 0) {
+        throw std::runtime_error("Snapshot write failed");
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the SnapshotWriter class.
+  -----------------------------------------------
+*/
+
+/*
+  -----------------------------------------------
+  Begin implementations for the SnapshotReader class.
+  -----------------------------------------------
+*/
+
+inline SnapshotReader::SnapshotReader(const std::string& path) :
+    file_(std::fopen(path.c_str(), "rb")), buffer_(BUFFER_BYTES), pos_(0), end_(0), fileSize_(0)
+{
+    if (file_ == NULL) {
+        throw std::runtime_error("Cannot open " + path + " for reading");
+    }
+    if (std::fseek(file_, 0, SEEK_END) == 0) {
+        long size = std::ftell(file_);
+        fileSize_ = size < 0 ? 0 : (std::uint64_t)size;
+    }
+    std::rewind(file_);
+}
+
+inline SnapshotReader::~SnapshotReader()
+{
+    std::fclose(file_);
+}
+
+/**
+* Returns the size of the whole file in bytes.
+*/
+inline std::uint64_t SnapshotReader::fileSize() const
+{
+    return fileSize_;
+}
+
+inline void SnapshotReader::read(void* data, std::size_t bytes)
+{
+    char* out = static_cast<char*>(data);
+    while (bytes > 0) {
+        if (pos_ == end_) {
+            pos_ = 0;
+            end_ = std::fread(&buffer_[0], 1, buffer_.size(), file_);
+            if (end_ == 0) {
+                throw std::runtime_error("Snapshot is truncated");
+            }
+        }
+        std::size_t chunk = std::min(bytes, end_ - pos_);
+        std::memcpy(out, &buffer_[pos_], chunk);
+        pos_ += chunk;
+        out += chunk;
+        bytes -= chunk;
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the SnapshotReader class.
+  -----------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include "bst.h"
+
+/**
+* A self-adjusting search tree. Every node that is looked up or inserted is
+* splayed: rotated up towards the root in pairs of steps that also roughly
+* halve the depth of the nodes along its path. Keys that are accessed often
+* stay near the top, so a skewed workload pays for the depth of its hot keys
+* rather than for the height of the whole tree. Operations cost O(log n)
+* amortized, though one access on its own can take O(n).
+*
+* Only the non-const lookups (find() and operator[]) restructure the tree;
+* the const overloads and the range queries leave it alone. Two settings
+* trade some of the adaptivity for fewer rotations on read-mostly paths:
+*   - semi-splaying moves a node about halfway to the root per access, with
+*     one rotation instead of two in each zig-zig step, and
+*   - a splay period of N splays only every N-th lookup of an existing key.
+* New keys are always splayed.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class SplayTree : public BinarySearchTree<Key, Value, Compare>
+{
+public:
+    SplayTree();
+    explicit SplayTree(const Compare& comp);
+    template<typename InputIt>
+    SplayTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
+
+    using BinarySearchTree<Key, Value, Compare>::find;
+    using BinarySearchTree<Key, Value, Compare>::operator[];
+    typename BinarySearchTree<Key, Value, Compare>::iterator find(const Key& key);
+    Value& operator[](const Key& key);
+
+    // Splaying options, which can be changed at any time
+    void setSemiSplay(bool semi);
+    bool semiSplay() const;
+    void setSplayPeriod(unsigned int period);
+    unsigned int splayPeriod() const;
+
+protected:
+    virtual void afterInsert(Node<Key, Value>* node);
+    virtual void afterAccess(Node<Key, Value>* node);
+
+    // Add helper functions here
+    void splay(Node<Key, Value>* node);
+    void rotateUp(Node<Key, Value>* node);
+
+protected:
+    bool semi_;
+    unsigned int period_;
+    // lookups of existing keys since the last splay
+    unsigned int accesses_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the SplayTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty SplayTree that fully splays every access.
+*/
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree() :
+    BinarySearchTree<Key, Value, Compare>(), semi_(false), period_(1), accesses_(0)
+{
+
+}
+
+/**
+* Constructor for an empty SplayTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+SplayTree<Key, Value, Compare>::SplayTree(const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(comp), semi_(false), period_(1), accesses_(0)
+{
+
+}
+
+/**
+* Constructs a balanced SplayTree from the key/value pairs in [first, last)
+* in linear time. See BinarySearchTree::assign().
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+SplayTree<Key, Value, Compare>::SplayTree(InputIt first, InputIt last, bool sorted, const Compare& comp) :
+    BinarySearchTree<Key, Value, Compare>(comp), semi_(false), period_(1), accesses_(0)
+{
+    this->assign(first, last, sorted);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end() if there is
+* none. A key that is found counts as an access and may be splayed.
+*/
+template<class Key, class Value, class Compare>
+typename BinarySearchTree<Key, Value, Compare>::iterator
+SplayTree<Key, Value, Compare>::find(const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if (node != nullptr) {
+        afterAccess(node);
+    }
+    return this->makeIterator(node);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, splaying it like find()
+ */
+template<class Key, class Value, class Compare>
+Value& SplayTree<Key, Value, Compare>::operator[](const Key& key)
+{
+    Node<Key, Value>* node = this->internalFind(key);
+    if(node == NULL) throw std::out_of_range("Invalid key");
+    afterAccess(node);
+    return node->getValue();
+}
+
+/**
+* Chooses between semi-splaying and full splaying.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::setSemiSplay(bool semi)
+{
+    semi_ = semi;
+}
+
+template<class Key, class Value, class Compare>
+bool SplayTree<Key, Value, Compare>::semiSplay() const
+{
+    return semi_;
+}
+
+/**
+* Splays only every period-th lookup of an existing key. A period of 0 is
+* treated as 1.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::setSplayPeriod(unsigned int period)
+{
+    period_ = period == 0 ? 1 : period;
+    accesses_ = 0;
+}
+
+template<class Key, class Value, class Compare>
+unsigned int SplayTree<Key, Value, Compare>::splayPeriod() const
+{
+    return period_;
+}
+
+/**
+* Splays a newly linked node.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+    splay(node);
+}
+
+/**
+* Splays a node that was looked up, if this access is due for one.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::afterAccess(Node<Key, Value>* node)
+{
+    if (++accesses_ < period_) {
+        return;
+    }
+    accesses_ = 0;
+    splay(node);
+}
+
+/**
+* Moves node up the tree. A node whose parent is the root takes one
+* rotation (zig). A node on the same side of its parent as the parent is of
+* the grandparent rotates the parent first and then itself (zig-zig); a node
+* on the other side rotates itself twice (zig-zag). Full splaying repeats
+* this until node is the root. Semi-splaying only rotates the parent in a
+* zig-zig and carries on from the parent, which leaves node partway up.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::splay(Node<Key, Value>* node)
+{
+    while (node->getParent() != nullptr) {
+        Node<Key, Value>* parent = node->getParent();
+        Node<Key, Value>* grandparent = parent->getParent();
+        if (grandparent == nullptr) {
+            rotateUp(node);
+        }
+        else if ((grandparent->getLeft() == parent) == (parent->getLeft() == node)) {
+            rotateUp(parent);
+            if (semi_) {
+                node = parent;
+            }
+            else {
+                rotateUp(node);
+            }
+        }
+        else {
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+}
+
+/**
+* Rotates node above its parent, moving the subtree between them across.
+*/
+template<class Key, class Value, class Compare>
+void SplayTree<Key, Value, Compare>::rotateUp(Node<Key, Value>* node)
+{
+    Node<Key, Value>* parent = node->getParent();
+    Node<Key, Value>* grandparent = parent->getParent();
+
+    if (parent->getLeft() == node) {
+        parent->setLeft(node->getRight());
+        if (node->getRight() != nullptr) {
+            node->getRight()->setParent(parent);
+        }
+        node->setRight(parent);
+    }
+    else {
+        parent->setRight(node->getLeft());
+        if (node->getLeft() != nullptr) {
+            node->getLeft()->setParent(parent);
+        }
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+
+    //node takes parent's place under grandparent
+    node->setParent(grandparent);
+    if (grandparent == nullptr) {
+        this->root_ = node;
+    }
+    else if (grandparent->getLeft() == parent) {
+        grandparent->setLeft(node);
+    }
+    else {
+        grandparent->setRight(node);
+    }
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the SplayTree class.
+  -----------------------------------------------
+*/
+
+#endif
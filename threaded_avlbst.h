@@ -0,0 +1,330 @@
+#ifndef THREADED_AVLBST_H
+#define THREADED_AVLBST_H
+
+#include "avlbst.h"
+
+/**
+* An AVLNode that also links to the nodes just before and after it in key
+* order. The links belong to the node rather than to its position, so
+* rotations and nodeSwap() leave them alone: neither changes the order of
+* the keys.
+*/
+template <typename Key, typename Value>
+class ThreadedAVLNode : public AVLNode<Key, Value>
+{
+public:
+    // Constructor/destructor.
+    ThreadedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
+    ThreadedAVLNode(Key&& key, Value&& value, AVLNode<Key, Value>* parent);
+    ~ThreadedAVLNode();
+
+    // Getters/setters for the in-order neighbours (NULL at either end).
+    ThreadedAVLNode<Key, Value>* getPrev() const;
+    void setPrev(ThreadedAVLNode<Key, Value>* prev);
+    ThreadedAVLNode<Key, Value>* getNext() const;
+    void setNext(ThreadedAVLNode<Key, Value>* next);
+
+protected:
+    ThreadedAVLNode<Key, Value>* prev_;
+    ThreadedAVLNode<Key, Value>* next_;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the ThreadedAVLNode class.
+  -------------------------------------------------
+*/
+
+/**
+* An explicit constructor to initialize the elements by calling the base class constructor
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::ThreadedAVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
+    AVLNode<Key, Value>(key, value, parent), prev_(NULL), next_(NULL)
+{
+
+}
+
+/**
+* An explicit constructor that moves the key and value into the node
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::ThreadedAVLNode(Key&& key, Value&& value, AVLNode<Key, Value> *parent) :
+    AVLNode<Key, Value>(std::move(key), std::move(value), parent), prev_(NULL), next_(NULL)
+{
+
+}
+
+/**
+* A destructor which does nothing.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>::~ThreadedAVLNode()
+{
+
+}
+
+/**
+* A getter for the node before this one in key order.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>* ThreadedAVLNode<Key, Value>::getPrev() const
+{
+    return prev_;
+}
+
+/**
+* A setter for the node before this one in key order.
+*/
+template<class Key, class Value>
+void ThreadedAVLNode<Key, Value>::setPrev(ThreadedAVLNode<Key, Value>* prev)
+{
+    prev_ = prev;
+}
+
+/**
+* A getter for the node after this one in key order.
+*/
+template<class Key, class Value>
+ThreadedAVLNode<Key, Value>* ThreadedAVLNode<Key, Value>::getNext() const
+{
+    return next_;
+}
+
+/**
+* A setter for the node after this one in key order.
+*/
+template<class Key, class Value>
+void ThreadedAVLNode<Key, Value>::setNext(ThreadedAVLNode<Key, Value>* next)
+{
+    next_ = next;
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ThreadedAVLNode class.
+  -----------------------------------------------
+*/
+
+/**
+* An AVLTree whose nodes are threaded into a doubly linked list in key order.
+* Iterators follow the links, so every ++ and -- is O(1) in the worst case
+* and a full scan never climbs back up through parents. The links cost two
+* pointers per node and O(1) work per insert and remove.
+*/
+template <class Key, class Value, class Compare = std::less<Key> >
+class ThreadedAVLTree : public AVLTree<Key, Value, Compare>
+{
+public:
+    ThreadedAVLTree();
+    explicit ThreadedAVLTree(const Compare& comp);
+    ThreadedAVLTree(share_pool_t, ThreadedAVLTree<Key, Value, Compare>& sibling);
+    template<typename InputIt>
+    ThreadedAVLTree(InputIt first, InputIt last, bool sorted = true, const Compare& comp = Compare());
+    virtual ~ThreadedAVLTree();
+
+protected:
+    virtual Node<Key, Value>* createNode(const Key& key, const Value& value, Node<Key, Value>* parent);
+    virtual Node<Key, Value>* createNode(Key&& key, Value&& value, Node<Key, Value>* parent);
+    virtual void destroyNode(Node<Key, Value>* node);
+    virtual void afterInsert(Node<Key, Value>* node);
+    virtual void beforeRemove(Node<Key, Value>* node);
+    virtual void initBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight);
+    virtual void linkNeighbours(Node<Key, Value>* before, Node<Key, Value>* after);
+    virtual Node<Key, Value>* nextNode(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* prevNode(Node<Key, Value>* node) const;
+};
+
+/*
+  -------------------------------------------------
+  Begin implementations for the ThreadedAVLTree class.
+  -------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty ThreadedAVLTree.
+*/
+template<class Key, class Value, class Compare>
+ThreadedAVLTree<Key, Value, Compare>::ThreadedAVLTree() : AVLTree<Key, Value, Compare>()
+{
+
+}
+
+/**
+* Constructor for an empty ThreadedAVLTree ordered by the given comparator.
+*/
+template<class Key, class Value, class Compare>
+ThreadedAVLTree<Key, Value, Compare>::ThreadedAVLTree(const Compare& comp) : AVLTree<Key, Value, Compare>(comp)
+{
+
+}
+
+/**
+* Constructor for an empty ThreadedAVLTree that shares sibling's node pool.
+* See AVLTree(share_pool_t, AVLTree&).
+*/
+template<class Key, class Value, class Compare>
+ThreadedAVLTree<Key, Value, Compare>::ThreadedAVLTree(share_pool_t, ThreadedAVLTree<Key, Value, Compare>& sibling) :
+    AVLTree<Key, Value, Compare>(share_pool, sibling)
+{
+
+}
+
+/**
+* Constructs a balanced ThreadedAVLTree from the key/value pairs in
+* [first, last) in linear time. See BinarySearchTree::assign().
+*/
+template<class Key, class Value, class Compare>
+template<typename InputIt>
+ThreadedAVLTree<Key, Value, Compare>::ThreadedAVLTree(InputIt first, InputIt last, bool sorted, const Compare& comp) : AVLTree<Key, Value, Compare>(comp)
+{
+    this->assign(first, last, sorted);
+}
+
+/**
+* Clears the tree here so that the nodes are destroyed through
+* ThreadedAVLTree::destroyNode.
+*/
+template<class Key, class Value, class Compare>
+ThreadedAVLTree<Key, Value, Compare>::~ThreadedAVLTree()
+{
+    this->clear();
+}
+
+/**
+* Allocates a ThreadedAVLNode from the tree's pool.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* ThreadedAVLTree<Key, Value, Compare>::createNode(const Key& key, const Value& value, Node<Key, Value>* parent)
+{
+    return this->pool_.template create<ThreadedAVLNode<Key, Value> >(key, value, static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Allocates a ThreadedAVLNode from the tree's pool, moving the key and value into it.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* ThreadedAVLTree<Key, Value, Compare>::createNode(Key&& key, Value&& value, Node<Key, Value>* parent)
+{
+    return this->pool_.template create<ThreadedAVLNode<Key, Value> >(std::move(key), std::move(value), static_cast<AVLNode<Key, Value>*>(parent));
+}
+
+/**
+* Destroys a ThreadedAVLNode and returns its memory to the pool.
+*/
+template<class Key, class Value, class Compare>
+void ThreadedAVLTree<Key, Value, Compare>::destroyNode(Node<Key, Value>* node)
+{
+    this->pool_.destroy(static_cast<ThreadedAVLNode<Key, Value>*>(node));
+}
+
+/**
+* Splices a new leaf into the list next to its parent, then rebalances. A
+* left child comes just before its parent and a right child just after it.
+*/
+template<class Key, class Value, class Compare>
+void ThreadedAVLTree<Key, Value, Compare>::afterInsert(Node<Key, Value>* node)
+{
+    ThreadedAVLNode<Key, Value>* newNode = static_cast<ThreadedAVLNode<Key, Value>*>(node);
+    ThreadedAVLNode<Key, Value>* parent = static_cast<ThreadedAVLNode<Key, Value>*>(node->getParent());
+    if (parent != nullptr) {
+        ThreadedAVLNode<Key, Value>* before = parent->getLeft() == node ? parent->getPrev() : parent;
+        ThreadedAVLNode<Key, Value>* after = parent->getLeft() == node ? parent : parent->getNext();
+        newNode->setPrev(before);
+        newNode->setNext(after);
+        if (before != nullptr) {
+            before->setNext(newNode);
+        }
+        if (after != nullptr) {
+            after->setPrev(newNode);
+        }
+    }
+    AVLTree<Key, Value, Compare>::afterInsert(node);
+}
+
+/**
+* Updates the cached ends and then unlinks the node from the list. The node
+* may still be swapped with its predecessor before it leaves the tree, but
+* that only moves it, so its neighbours are already right.
+*/
+template<class Key, class Value, class Compare>
+void ThreadedAVLTree<Key, Value, Compare>::beforeRemove(Node<Key, Value>* node)
+{
+    AVLTree<Key, Value, Compare>::beforeRemove(node);
+    ThreadedAVLNode<Key, Value>* oldNode = static_cast<ThreadedAVLNode<Key, Value>*>(node);
+    if (oldNode->getPrev() != nullptr) {
+        oldNode->getPrev()->setNext(oldNode->getNext());
+    }
+    if (oldNode->getNext() != nullptr) {
+        oldNode->getNext()->setPrev(oldNode->getPrev());
+    }
+}
+
+/**
+* Links a node made by a bulk load to the largest node of its left subtree
+* and the smallest of its right subtree. Both subtrees are complete by now,
+* and the spines walked add up to O(n) over the whole build.
+*/
+template<class Key, class Value, class Compare>
+void ThreadedAVLTree<Key, Value, Compare>::initBuiltNode(Node<Key, Value>* node, int leftHeight, int rightHeight)
+{
+    AVLTree<Key, Value, Compare>::initBuiltNode(node, leftHeight, rightHeight);
+    ThreadedAVLNode<Key, Value>* builtNode = static_cast<ThreadedAVLNode<Key, Value>*>(node);
+    if (node->getLeft() != nullptr) {
+        Node<Key, Value>* before = node->getLeft();
+        while (before->getRight() != nullptr) {
+            before = before->getRight();
+        }
+        builtNode->setPrev(static_cast<ThreadedAVLNode<Key, Value>*>(before));
+        builtNode->getPrev()->setNext(builtNode);
+    }
+    if (node->getRight() != nullptr) {
+        Node<Key, Value>* after = node->getRight();
+        while (after->getLeft() != nullptr) {
+            after = after->getLeft();
+        }
+        builtNode->setNext(static_cast<ThreadedAVLNode<Key, Value>*>(after));
+        builtNode->getNext()->setPrev(builtNode);
+    }
+}
+
+/**
+* Links two nodes that split() or join() have made neighbours. A NULL end
+* leaves the other node first or last in the list.
+*/
+template<class Key, class Value, class Compare>
+void ThreadedAVLTree<Key, Value, Compare>::linkNeighbours(Node<Key, Value>* before, Node<Key, Value>* after)
+{
+    if (before != nullptr) {
+        static_cast<ThreadedAVLNode<Key, Value>*>(before)->setNext(static_cast<ThreadedAVLNode<Key, Value>*>(after));
+    }
+    if (after != nullptr) {
+        static_cast<ThreadedAVLNode<Key, Value>*>(after)->setPrev(static_cast<ThreadedAVLNode<Key, Value>*>(before));
+    }
+}
+
+/**
+* Follows the link to the next node.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* ThreadedAVLTree<Key, Value, Compare>::nextNode(Node<Key, Value>* node) const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(node)->getNext();
+}
+
+/**
+* Follows the link to the previous node.
+*/
+template<class Key, class Value, class Compare>
+Node<Key, Value>* ThreadedAVLTree<Key, Value, Compare>::prevNode(Node<Key, Value>* node) const
+{
+    return static_cast<ThreadedAVLNode<Key, Value>*>(node)->getPrev();
+}
+
+/*
+  -----------------------------------------------
+  End implementations for the ThreadedAVLTree class.
+  -----------------------------------------------
+*/
+
+#endif